@@ -0,0 +1,302 @@
+// Asynchronous, buffered result logger with text, JSON lines and binary formats
+#ifndef ASYNC_LOGGER_H
+#define ASYNC_LOGGER_H
+
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include "BoundedQueue.h"
+#include "FileUtils.h"
+
+using namespace std;
+
+// Record formats:
+//   LOG_TEXT    the classic log.txt block per file
+//   LOG_JSONL   one JSON object per line:
+//               {"path","extension","signature","verdict","detected":[...],"lookup_ns","read_ns","match_ns"}
+//               plus "content" for files the content classifier looked at
+//   LOG_BINARY  the file starts with the 8 byte magic "FCLOG1\n\0"; each record is
+//               u32 recordLength (excluding itself), u8 verdict, u8 signatureLength,
+//               u16 pathLength, u16 extensionLength, u16 detectedCount,
+//               u32 lookupNs, u32 readNs, u32 matchNs,
+//               then path, extension and signature bytes, then per detected type a u8
+//               length and the name, then a u8 ContentClass (0 if not classified).
+//               Integers are little endian.
+enum LogFormat { LOG_TEXT, LOG_JSONL, LOG_BINARY };
+
+const char BINARY_LOG_MAGIC[8] = { 'F', 'C', 'L', 'O', 'G', '1', '\n', '\0' };
+
+// Settings for AsyncLogger
+struct LoggerOptions {
+    string path = "log.txt";
+    LogFormat format = LOG_TEXT;
+    bool decorative = true;     // ASCII art on mismatches (text format only)
+    bool enabled = true;        // false opens no file and logs nothing
+    bool mismatchesOnly = false; // Log only MISMATCH results
+    size_t maxBytes = 0;        // Rotate when the file would grow past this; 0 never rotates
+    size_t keepFiles = 5;       // Rotated files kept as path.1 ... path.N
+    size_t queueCapacity = 8192; // Records buffered between producers and the writer
+    size_t writeBuffer = 1 << 20; // Bytes gathered before each write
+};
+
+// Append s as a JSON string literal
+inline void appendJsonString(string& out, const string& s) {
+    static const char digits[] = "0123456789abcdef";
+    out += '"';
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else if (c < 0x20) {
+            out += "\\u00";
+            out += digits[c >> 4];
+            out += digits[c & 0x0F];
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+    out += '"';
+}
+
+// Format one result as a JSON line
+inline void formatJsonRecord(string& out, const CheckResult& result) {
+    out += "{\"path\":";
+    appendJsonString(out, result.path);
+    out += ",\"extension\":";
+    appendJsonString(out, result.extension);
+    out += ",\"signature\":\"";
+    if (result.verdict != UNKNOWN_EXTENSION)
+        out += result.signatureHex();
+    out += "\",\"verdict\":\"";
+    out += verdictName(result.verdict);
+    out += "\",\"detected\":[";
+    for (size_t i = 0; i < result.detectedTypes.size(); i++) {
+        if (i > 0)
+            out += ',';
+        appendJsonString(out, result.detectedTypes[i]);
+    }
+    out += "],\"lookup_ns\":" + to_string(result.timings.lookupNs);
+    out += ",\"read_ns\":" + to_string(result.timings.readNs);
+    out += ",\"match_ns\":" + to_string(result.timings.matchNs);
+    if (result.content != CONTENT_NONE) {
+        out += ",\"content\":\"";
+        out += contentName(result.content);
+        out += '"';
+    }
+    out += "}\n";
+}
+
+// Little endian integer writers for the binary format
+inline void appendLe(string& out, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++)
+        out += static_cast<char>((value >> (8 * i)) & 0xFF);
+}
+
+// Format one result as a binary record
+inline void formatBinaryRecord(string& out, const CheckResult& result) {
+    size_t start = out.size();
+    size_t signatureLength = result.verdict == UNKNOWN_EXTENSION ? 0 : min(result.expected.maxLength, result.header.size);
+    size_t pathLength = min<size_t>(result.path.size(), 0xFFFF);
+    size_t extensionLength = min<size_t>(result.extension.size(), 0xFFFF);
+    size_t detectedCount = min<size_t>(result.detectedTypes.size(), 0xFFFF);
+
+    appendLe(out, 0, 4); // Patched below
+    appendLe(out, result.verdict, 1);
+    appendLe(out, signatureLength, 1);
+    appendLe(out, pathLength, 2);
+    appendLe(out, extensionLength, 2);
+    appendLe(out, detectedCount, 2);
+    appendLe(out, result.timings.lookupNs, 4);
+    appendLe(out, result.timings.readNs, 4);
+    appendLe(out, result.timings.matchNs, 4);
+    out.append(result.path, 0, pathLength);
+    out.append(result.extension, 0, extensionLength);
+    out.append(reinterpret_cast<const char*>(result.header.bytes), signatureLength);
+    for (size_t i = 0; i < detectedCount; i++) {
+        size_t length = min<size_t>(result.detectedTypes[i].size(), 0xFF);
+        appendLe(out, length, 1);
+        out.append(result.detectedTypes[i], 0, length);
+    }
+    appendLe(out, result.content, 1);
+
+    uint32_t recordLength = static_cast<uint32_t>(out.size() - start - 4);
+    for (size_t i = 0; i < 4; i++)
+        out[start + i] = static_cast<char>((recordLength >> (8 * i)) & 0xFF);
+}
+
+// Producers (checker threads) format their record and push it onto a lock-free queue;
+// one background thread drains the queue into a large buffer and writes it out with a
+// single write() per batch, rotating the file by size. Nothing is flushed per line.
+class AsyncLogger {
+private:
+    LoggerOptions options;
+    BoundedQueue<string> queue;
+    thread writer;
+    atomic<bool> stopping;
+    atomic<size_t> producerWaits; // Times a producer found the queue full and had to wait
+    int fd;
+    size_t fileBytes;             // Size of the current file
+    atomic<bool> failed;
+    bool started;                 // Writer thread running; set once in the constructor
+
+    // Utility function: Open the current log file for appending
+    bool openFile()
+    {
+        fd = ::open(options.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0)
+            return false;
+        off_t size = lseek(fd, 0, SEEK_END);
+        fileBytes = size < 0 ? 0 : static_cast<size_t>(size);
+        if (options.format == LOG_BINARY && fileBytes == 0)
+            writeAll(BINARY_LOG_MAGIC, sizeof(BINARY_LOG_MAGIC));
+        return true;
+    }
+
+    // Utility function: Write a whole buffer, retrying short writes
+    void writeAll(const char* data, size_t size)
+    {
+        while (size > 0 && fd >= 0) {
+            ssize_t n = ::write(fd, data, size);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                failed = true;
+                return;
+            }
+            data += n;
+            size -= static_cast<size_t>(n);
+            fileBytes += static_cast<size_t>(n);
+        }
+    }
+
+    // Utility function: Shift path.N-1 -> path.N ... path -> path.1 and start a new file
+    void rotate()
+    {
+        ::close(fd);
+        fd = -1;
+        for (size_t i = options.keepFiles; i > 1; i--) {
+            string from = options.path + "." + to_string(i - 1);
+            string to = options.path + "." + to_string(i);
+            ::rename(from.c_str(), to.c_str());
+        }
+        if (options.keepFiles > 0)
+            ::rename(options.path.c_str(), (options.path + ".1").c_str());
+        else
+            ::unlink(options.path.c_str());
+        if (!openFile())
+            failed = true;
+    }
+
+    // Utility function: Write out the gathered buffer, rotating first if it would overflow
+    void flushBuffer(string& buffer)
+    {
+        if (buffer.empty())
+            return;
+        size_t header = options.format == LOG_BINARY ? sizeof(BINARY_LOG_MAGIC) : 0;
+        if (options.maxBytes > 0 && fileBytes > header && fileBytes + buffer.size() > options.maxBytes)
+            rotate();
+        writeAll(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+
+    // Utility function: Background writer loop
+    void run()
+    {
+        string buffer;
+        buffer.reserve(options.writeBuffer);
+        string record;
+        auto finished = [this]() { return stopping.load(memory_order_acquire); };
+        while (true) {
+            while (queue.tryPop(record)) {
+                // Keep record boundaries inside one file when rotating
+                if (options.maxBytes > 0 && !buffer.empty() && buffer.size() + record.size() > options.maxBytes)
+                    flushBuffer(buffer);
+                buffer += record;
+                if (buffer.size() >= options.writeBuffer)
+                    flushBuffer(buffer);
+            }
+            // Queue drained: write what we have, then sleep until a producer queues more (or close)
+            flushBuffer(buffer);
+            if (!queue.pop(record, finished))
+                break;
+            buffer += record;
+        }
+    }
+
+public:
+    explicit AsyncLogger(const LoggerOptions& loggerOptions)
+        : options(loggerOptions), queue(loggerOptions.queueCapacity), stopping(false), producerWaits(0),
+          fd(-1), fileBytes(0), failed(false), started(false)
+    {
+        if (!options.enabled)
+            return;
+        if (!openFile()) {
+            failed = true;
+            return;
+        }
+        writer = thread(&AsyncLogger::run, this);
+        started = true;
+    }
+
+    AsyncLogger(const AsyncLogger&) = delete;
+    AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+    ~AsyncLogger() { close(); }
+
+    // Public function: Was the log file opened successfully (and written without error so far)?
+    bool ok() const { return !failed; }
+
+    // Public function: Format and queue one result. Safe to call from any number of threads.
+    void log(const CheckResult& result)
+    {
+        if (!started || (options.mismatchesOnly && result.verdict != MISMATCH))
+            return;
+        string record;
+        if (options.format == LOG_JSONL) {
+            formatJsonRecord(record, result);
+        } else if (options.format == LOG_BINARY) {
+            formatBinaryRecord(record, result);
+        } else {
+            ostringstream text;
+            writeLogEntry(text, result, options.decorative);
+            record = text.str();
+        }
+        logRaw(record);
+    }
+
+    // Public function: Queue an already formatted record
+    void logRaw(string& record)
+    {
+        if (queue.tryPush(record))
+            return;
+        producerWaits.fetch_add(1, memory_order_relaxed);
+        queue.push(record);
+    }
+
+    // Public function: Write everything queued so far and stop the writer
+    void close()
+    {
+        if (writer.joinable()) {
+            stopping.store(true, memory_order_release);
+            queue.wakeConsumers();
+            writer.join();
+        }
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    // Public function: How often producers had to wait for room in the queue
+    size_t waits() const { return producerWaits.load(memory_order_relaxed); }
+};
+
+#endif
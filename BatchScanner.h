@@ -0,0 +1,527 @@
+// Batch mode: check many files with a pool of worker threads sharing one signature index
+#ifndef BATCH_SCANNER_H
+#define BATCH_SCANNER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include "AsyncLogger.h"
+#include "BoundedQueue.h"
+#include "DeepScanner.h"
+#include "DirectoryWalk.h"
+#include "FileUtils.h"
+#include "ResultCache.h"
+#include "ScanReport.h"
+#include "ShardResults.h"
+
+using namespace std;
+
+// Totals collected over one batch run
+struct BatchStats {
+    size_t files = 0;
+    size_t matches = 0;
+    size_t mismatches = 0;
+    size_t unknown = 0;
+    size_t errors = 0;
+    double seconds = 0.0;
+    HeaderReader::Backend backend = HeaderReader::PREAD; // How headers were actually read
+    bool cached = false;  // Was a result cache in use?
+    CacheStats cache;
+    size_t slow = 0;      // Files that missed the I/O deadline and were checked by the slow lane
+
+    double filesPerSecond() const { return seconds > 0.0 ? files / seconds : 0.0; }
+};
+
+// Expand the command line arguments into a list of files, walking directories recursively.
+// Only regular files are listed from a walk: symlinks are not followed (nor their targets
+// stat'ed), and FIFOs, devices and sockets are left out.
+inline void collectPaths(const vector<string>& inputs, vector<string>& paths) {
+    namespace fs = std::filesystem;
+    for (const string& input : inputs) {
+        error_code ec;
+        if (fs::is_directory(input, ec)) {
+            walkTree(input, [&](const fs::directory_entry& entry) {
+                error_code statusError;
+                if (fs::is_regular_file(entry.symlink_status(statusError)))
+                    paths.push_back(entry.path().string());
+            });
+        } else {
+            paths.push_back(input);
+        }
+    }
+}
+
+// Index is any signature index with a lookupSignatures overload (tree or mapped database)
+template <typename Index>
+class BatchScanner {
+private:
+    // Buffers one worker reuses for every batch it checks
+    struct Worker {
+        HeaderReader reader;
+        vector<CheckResult> results;
+        vector<HeaderRequest> requests;
+        vector<size_t> owners;   // Which result each request reads for
+        vector<CacheKey> keys;
+        vector<char> cached;     // 1 answered from the cache, 2 missed (key valid)
+        vector<char> late;       // A follow-up read missed the deadline
+        vector<uint64_t> sizes;  // Length of each file, as its header read found it
+        vector<FileHeader> probes; // Signatures at other offsets of mismatched files
+        vector<ZipInspection> zips;
+        vector<RangeRequest> ranges;
+        vector<size_t> zipOwners;  // Which result each inspection is for
+        vector<DeepHit> deepHits;
+        vector<unsigned char> deepBuffer;
+        vector<unsigned char> contentBuffer;
+        string console;
+        size_t pending = 0;      // Lines in console
+        string records;          // Encoded results for the result file, handed over per batch
+        unique_ptr<ReportTally> tally; // This worker's share of the report, merged when it is done
+
+        Worker(HeaderReader::Backend backend, size_t batchSize, const ScanReport* report, unsigned deadlineMs)
+            : reader(backend, static_cast<unsigned>(batchSize), deadlineMs), results(batchSize), requests(batchSize),
+              owners(batchSize), keys(batchSize), cached(batchSize), late(batchSize), sizes(batchSize),
+              probes(batchSize), zips(batchSize), ranges(batchSize), zipOwners(batchSize)
+        {
+            if (report != nullptr)
+                tally = make_unique<ReportTally>(report->makeTally());
+        }
+    };
+
+    const Index& index;               // Shared, read-only signature index
+    const SignatureTrie* reverse;     // Optional reverse index used to name mismatched files
+    size_t threadCount;               // Number of worker threads
+    HeaderReader::Backend ioBackend;  // Preferred way of reading headers
+    size_t batchSize;                 // Files whose headers are read together
+    ResultCache* cache;               // Optional results of earlier runs, consulted before reading
+    const DeepScanner* deep;          // Optional whole-file scan for embedded signatures
+    size_t contentBytes;              // Sample classified for unexplained files, 0 for none
+    ResultFileWriter* resultFile;     // Optional sorted result file every result is added to
+    ScanReport* report;               // Optional aggregate report; replaces the per-file lines
+    unsigned ioDeadline;              // Milliseconds an io_uring read may take before the slow lane gets it, 0 for no limit
+    size_t slowThreads;               // Threads in the slow lane
+    mutex outputMutex;                // Serialises flushes to the console
+    atomic<size_t> counts[4];         // Verdicts of the current run
+    atomic<int> usedBackend;
+    // Slow lane: files that missed the deadline, checked again with blocking reads so the
+    // workers never wait for them
+    mutex slowMutex;
+    condition_variable slowReady;
+    deque<string> slowPaths;
+    bool slowClosing = false;
+    size_t slowTaken = 0;
+
+    // Console lines are formatted per worker and flushed in chunks to keep lock traffic low
+    static const size_t flushEvery = 64;
+    // Files the slow lane holds at most; past this a file that misses the deadline is reported as such
+    static const size_t slowLaneLimit = 4096;
+
+    void flush(string& console, ostream& out, bool streaming = false)
+    {
+        lock_guard<mutex> lock(outputMutex);
+        out << console;
+        if (streaming)
+            out.flush();
+        console.clear();
+    }
+
+    // Utility function: Check up to batchSize paths. Resolves extensions, answers what it can
+    // from the cache, reads the remaining headers in one go through the worker's HeaderReader,
+    // then matches, formats and logs the results.
+    void checkBatch(Worker& worker, const string* paths, size_t count, AsyncLogger& logger)
+    {
+        vector<CheckResult>& results = worker.results;
+        vector<HeaderRequest>& requests = worker.requests;
+        vector<char>& cached = worker.cached;
+        size_t toRead = 0;
+        for (size_t i = 0; i < count; i++) {
+            uint64_t lookupStart = monotonicNanos();
+            prepareCheck(index, paths[i], reverse, results[i]);
+            cached[i] = 0;
+            if (cache != nullptr && results[i].header.segmentCount > 0) {
+                bool keyOk = false;
+                cached[i] = checkFromCache(*cache, results[i], reverse, worker.keys[i], keyOk) ? 1 : keyOk ? 2 : 0;
+            }
+            if (cached[i] != 1 && results[i].header.segmentCount > 0) {
+                requests[toRead].path = paths[i].c_str();
+                requests[toRead].header = &results[i].header;
+                worker.owners[toRead++] = i;
+            }
+            results[i].timings.lookupNs = static_cast<uint32_t>(monotonicNanos() - lookupStart);
+        }
+        worker.reader.readBatch(requests.data(), toRead);
+        for (size_t r = 0; r < toRead; r++) {
+            results[worker.owners[r]].error = requests[r].error;
+            worker.sizes[worker.owners[r]] = requests[r].size;
+            results[worker.owners[r]].timings.readNs = timingNs(requests[r].readNs);
+        }
+
+        finishBatch(worker, count);
+
+        for (size_t i = 0; i < count; i++) {
+            CheckResult& result = results[i];
+            if ((result.error == SKIP_TIMED_OUT || worker.late[i]) && toSlowLane(result.path))
+                continue;
+            if (cached[i] != 1) {
+                classifyUnmatched(result, worker.contentBuffer, contentBytes);
+                if (cached[i] == 2 && !worker.late[i])
+                    cache->store(worker.keys[i], result.header, result.verdict, result.container, result.content);
+            } else if (contentBytes == 0) {
+                result.content = CONTENT_NONE;
+            } else if (result.content == CONTENT_NONE) {
+                classifyUnmatched(result, worker.contentBuffer, contentBytes);
+            }
+            counts[result.verdict].fetch_add(1, memory_order_relaxed);
+            recordCheck(result, cached[i] == 1);
+
+            if (report != nullptr)
+                report->add(*worker.tally, result);
+            else
+                appendResultLine(worker.console, result);
+            if (resultFile != nullptr)
+                encodeResultRecord(worker.records, result);
+            if (deep != nullptr && result.verdict != READ_ERROR
+                && deep->scanFile(result.path.c_str(), worker.deepHits, worker.deepBuffer) == 0) {
+                appendDeepScanLines(worker.console, result.path, *deep, worker.deepHits);
+            }
+            {
+                StageTimer logTimer(STAGE_LOG);
+                logger.log(result);
+            }
+            worker.pending++;
+        }
+        if (!worker.records.empty()) {
+            resultFile->append(worker.records);
+            worker.records.clear();
+        }
+    }
+
+    // Utility function: Finish the checks of a batch whose headers have been read. Compares each
+    // header, then reads what mismatches and ZIP files need besides (signatures at other
+    // offsets, the central directory) a pass at a time through the worker's reader, so these
+    // reads have the deadline too. A file whose follow-up read misses it is marked late; if the
+    // slow lane is full it keeps the answer it had got to.
+    void finishBatch(Worker& worker, size_t count)
+    {
+        vector<CheckResult>& results = worker.results;
+        vector<HeaderRequest>& requests = worker.requests;
+        size_t probing = 0;
+        for (size_t i = 0; i < count; i++) {
+            worker.late[i] = 0;
+            if (worker.cached[i] == 1)
+                continue;
+            CheckResult& result = results[i];
+            uint64_t matchStart = monotonicNanos();
+            if (judgeHeader(result, result.error == 0) && planProbe(result, reverse, worker.probes[probing])) {
+                requests[probing].path = result.path.c_str();
+                requests[probing].header = &worker.probes[probing];
+                worker.owners[probing++] = i;
+            }
+            result.timings.matchNs = static_cast<uint32_t>(monotonicNanos() - matchStart);
+        }
+
+        // Keep the first read if a probe fails
+        worker.reader.readBatch(requests.data(), probing);
+        for (size_t r = 0; r < probing; r++) {
+            CheckTimings& timings = results[worker.owners[r]].timings;
+            timings.readNs = timingNs(uint64_t(timings.readNs) + requests[r].readNs);
+            if (requests[r].error == 0) {
+                results[worker.owners[r]].header = worker.probes[r];
+                worker.sizes[worker.owners[r]] = requests[r].size;
+            } else if (requests[r].error == SKIP_TIMED_OUT)
+                worker.late[worker.owners[r]] = 1;
+        }
+
+        size_t zipping = 0;
+        for (size_t i = 0; i < count; i++) {
+            CheckResult& result = results[i];
+            if (worker.cached[i] == 1 || result.error != 0)
+                continue;
+            uint64_t matchStart = monotonicNanos();
+            nameMismatch(result, reverse);
+            result.timings.matchNs += static_cast<uint32_t>(monotonicNanos() - matchStart);
+            if (!worker.late[i] && wantsZipInspection(result)) {
+                worker.zips[zipping].start(worker.sizes[i]);
+                worker.zipOwners[zipping++] = i;
+            }
+        }
+
+        // Each pass reads the next range every unfinished inspection wants
+        vector<RangeRequest>& ranges = worker.ranges;
+        while (zipping > 0) {
+            size_t reading = 0;
+            for (size_t z = 0; z < zipping; z++) {
+                CheckResult& result = results[worker.zipOwners[z]];
+                if (!worker.zips[z].next(ranges[z].offset, ranges[z].length)) {
+                    result.container = worker.zips[z].container();
+                    applyContainerType(result);
+                    continue;
+                }
+                ranges[z].path = result.path.c_str();
+                swap(ranges[reading], ranges[z]);
+                swap(worker.zips[reading], worker.zips[z]);
+                worker.zipOwners[reading++] = worker.zipOwners[z];
+            }
+            worker.reader.readRanges(ranges.data(), reading);
+            zipping = 0;
+            for (size_t z = 0; z < reading; z++) {
+                CheckTimings& timings = results[worker.zipOwners[z]].timings;
+                timings.readNs = timingNs(uint64_t(timings.readNs) + ranges[z].readNs);
+                if (ranges[z].error == SKIP_TIMED_OUT) {
+                    worker.late[worker.zipOwners[z]] = 1;
+                    continue;
+                }
+                worker.zips[z].supply(ranges[z].error == 0 ? ranges[z].bytes.data() : nullptr, ranges[z].bytes.size());
+                swap(ranges[zipping], ranges[z]);
+                swap(worker.zips[zipping], worker.zips[z]);
+                worker.zipOwners[zipping++] = worker.zipOwners[z];
+            }
+        }
+    }
+
+    // Utility function: Hand over what a worker gathered once it has checked its last batch
+    void finishWorker(Worker& worker)
+    {
+        if (report != nullptr)
+            report->merge(*worker.tally);
+        usedBackend.store(worker.reader.activeBackend(), memory_order_relaxed);
+    }
+
+    // Utility function: Queue a file that missed the I/O deadline for the slow lane. Returns
+    // false if there is no slow lane or it is full; the file is then reported as timed out.
+    bool toSlowLane(const string& path)
+    {
+        if (slowThreads == 0)
+            return false;
+        lock_guard<mutex> lock(slowMutex);
+        if (slowPaths.size() >= slowLaneLimit)
+            return false;
+        slowPaths.push_back(path);
+        slowTaken++;
+        slowReady.notify_one();
+        return true;
+    }
+
+    // Utility function: One slow-lane thread: check queued files one at a time with blocking
+    // reads, until the workers are done and the queue is empty. A file that never answers
+    // holds up this thread and the end of the run, but no worker.
+    void slowLane(ostream& out, AsyncLogger& logger)
+    {
+        Worker worker(HeaderReader::PREAD, 1, report, 0);
+        string path;
+        while (true) {
+            {
+                unique_lock<mutex> lock(slowMutex);
+                slowReady.wait(lock, [&]() { return slowClosing || !slowPaths.empty(); });
+                if (slowPaths.empty())
+                    break;
+                path = move(slowPaths.front());
+                slowPaths.pop_front();
+            }
+            checkBatch(worker, &path, 1, logger);
+            flush(worker.console, out, true);
+            worker.pending = 0;
+        }
+        if (report != nullptr)
+            report->merge(*worker.tally);
+    }
+
+    // Utility function: Run body on threadCount threads (the caller's included), with the slow
+    // lane beside them when reads have a deadline, and gather the totals
+    template <typename Body>
+    BatchStats runWorkers(size_t workers, Body body, ostream& out, AsyncLogger& logger)
+    {
+        for (atomic<size_t>& count : counts)
+            count.store(0, memory_order_relaxed);
+        usedBackend.store(HeaderReader::PREAD, memory_order_relaxed);
+        slowClosing = false;
+        slowTaken = 0;
+        auto start = chrono::steady_clock::now();
+
+        vector<thread> slow;
+        for (size_t i = 0; i < slowThreads; i++) {
+            slow.emplace_back([&]() { slowLane(out, logger); });
+        }
+        vector<thread> pool;
+        for (size_t i = 1; i < workers; i++) {
+            pool.emplace_back(body);
+        }
+        body(); // The calling thread works too
+        for (thread& t : pool) {
+            t.join();
+        }
+        {
+            lock_guard<mutex> lock(slowMutex);
+            slowClosing = true;
+        }
+        slowReady.notify_all();
+        for (thread& t : slow) {
+            t.join();
+        }
+
+        BatchStats stats;
+        stats.matches = counts[MATCH];
+        stats.mismatches = counts[MISMATCH];
+        stats.unknown = counts[UNKNOWN_EXTENSION];
+        stats.errors = counts[READ_ERROR];
+        stats.files = stats.matches + stats.mismatches + stats.unknown + stats.errors;
+        stats.backend = static_cast<HeaderReader::Backend>(usedBackend.load());
+        stats.slow = slowTaken;
+        if (cache != nullptr) {
+            stats.cached = true;
+            stats.cache = cache->stats();
+        }
+        stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return stats;
+    }
+
+public:
+    BatchScanner(const Index& signatureIndex, const SignatureTrie* reverseIndex, size_t threads,
+                 HeaderReader::Backend backend = HeaderReader::IO_URING, size_t headersPerBatch = 256,
+                 ResultCache* resultCache = nullptr, const DeepScanner* deepScanner = nullptr, size_t contentSample = 0,
+                 ResultFileWriter* results = nullptr, ScanReport* scanReport = nullptr, unsigned ioDeadlineMs = 0,
+                 size_t slowLaneThreads = 2)
+        : index(signatureIndex), reverse(reverseIndex), threadCount(threads == 0 ? 1 : threads),
+          ioBackend(backend), batchSize(headersPerBatch == 0 ? 1 : headersPerBatch), cache(resultCache),
+          deep(deepScanner), contentBytes(contentSample), resultFile(results), report(scanReport), ioDeadline(ioDeadlineMs),
+          slowThreads(ioDeadlineMs > 0 && backend == HeaderReader::IO_URING ? slowLaneThreads : 0), usedBackend(HeaderReader::PREAD)
+    {
+    }
+
+    // Check every path, writing one line per file to out and one record per file to logger
+    BatchStats run(const vector<string>& paths, ostream& out, AsyncLogger& logger)
+    {
+        atomic<size_t> next(0);
+
+        // Each worker claims the next batch of paths until none are left
+        auto body = [&]() {
+            Worker worker(ioBackend, batchSize, report, ioDeadline);
+            for (size_t begin = next.fetch_add(batchSize); begin < paths.size(); begin = next.fetch_add(batchSize)) {
+                checkBatch(worker, paths.data() + begin, min(batchSize, paths.size() - begin), logger);
+                if (worker.pending >= flushEvery) {
+                    flush(worker.console, out);
+                    worker.pending = 0;
+                }
+            }
+            if (worker.pending > 0) {
+                flush(worker.console, out);
+            }
+            finishWorker(worker);
+        };
+        return runWorkers(min(threadCount, max<size_t>(paths.size(), 1)), body, out, logger);
+    }
+
+    // Check paths as they arrive on a descriptor, separated by delimiter ('\0' for find -print0,
+    // or '\n', where a trailing '\r' is dropped). A reader thread splits the input into batches
+    // and hands them to the workers through a bounded queue, so checking starts with the first
+    // paths and a fast producer is held back rather than buffered without limit. A batch is
+    // handed over when it is full or when the input pauses, and every batch's lines are
+    // flushed to out as soon as they are formatted. Paths outside shard are dropped as they are read.
+    BatchStats runStream(int fd, char delimiter, ostream& out, AsyncLogger& logger, const ShardSpec& shard = ShardSpec())
+    {
+        BoundedQueue<vector<string>> batches(threadCount * 2);
+        atomic<bool> inputDone(false);
+
+        // Wait for room in the queue, then hand a batch over
+        auto handOver = [&](vector<string>& batch) {
+            batches.push(batch);
+            batch.clear();
+            batch.reserve(batchSize);
+        };
+
+        thread reader([&]() {
+            vector<string> batch;
+            batch.reserve(batchSize);
+            string partial; // Path cut off at the end of the last read
+            char buffer[64 * 1024];
+            while (true) {
+                ssize_t n = read(fd, buffer, sizeof(buffer));
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n < 0)
+                    cerr << "Error reading paths: " << strerror(errno) << endl;
+                if (n <= 0)
+                    break;
+                const char* begin = buffer;
+                const char* end = buffer + n;
+                while (begin < end) {
+                    const char* stop = static_cast<const char*>(memchr(begin, delimiter, static_cast<size_t>(end - begin)));
+                    if (stop == nullptr) {
+                        partial.append(begin, end);
+                        break;
+                    }
+                    partial.append(begin, stop);
+                    begin = stop + 1;
+                    if (delimiter == '\n' && !partial.empty() && partial.back() == '\r')
+                        partial.pop_back();
+                    if (!partial.empty() && shard.contains(partial)) {
+                        batch.push_back(move(partial));
+                        if (batch.size() == batchSize)
+                            handOver(batch);
+                    }
+                    partial.clear();
+                }
+                // The producer has nothing more for now: let the workers start on what we have
+                if (!batch.empty() && static_cast<size_t>(n) < sizeof(buffer))
+                    handOver(batch);
+            }
+            if (delimiter == '\n' && !partial.empty() && partial.back() == '\r')
+                partial.pop_back();
+            if (!partial.empty() && shard.contains(partial))
+                batch.push_back(move(partial));
+            if (!batch.empty())
+                handOver(batch);
+            inputDone.store(true, memory_order_release);
+            batches.wakeConsumers();
+        });
+
+        BatchStats stats = runBatches(batches, inputDone, out, logger);
+        reader.join();
+        return stats;
+    }
+
+    // Check batches of paths another thread pushes onto batches until it sets inputDone (and
+    // calls wakeConsumers) and the queue is empty, flushing each batch's lines as soon as they
+    // are formatted. Idle workers sleep in the queue until a batch arrives.
+    BatchStats runBatches(BoundedQueue<vector<string>>& batches, const atomic<bool>& inputDone, ostream& out,
+                          AsyncLogger& logger)
+    {
+        auto body = [&]() {
+            Worker worker(ioBackend, batchSize, report, ioDeadline);
+            vector<string> batch;
+            while (batches.pop(batch, [&]() { return inputDone.load(memory_order_acquire); })) {
+                checkBatch(worker, batch.data(), batch.size(), logger);
+                flush(worker.console, out, true);
+                worker.pending = 0;
+            }
+            finishWorker(worker);
+        };
+        return runWorkers(threadCount, body, out, logger);
+    }
+};
+
+// Print the closing summary of a batch run
+inline void printBatchStats(ostream& out, const BatchStats& stats, size_t threads) {
+    out << "Checked " << stats.files << " files with " << threads << " threads (" << backendName(stats.backend) << ") in "
+        << fixed << setprecision(3) << stats.seconds << " s ("
+        << setprecision(1) << stats.filesPerSecond() << " files/sec)" << endl;
+    out << "  matches: " << stats.matches << ", mismatches: " << stats.mismatches
+        << ", unknown extensions: " << stats.unknown << ", read errors: " << stats.errors << endl;
+    if (stats.cached) {
+        out << "  cache: " << stats.cache.hits << " hits, " << stats.cache.misses << " misses ("
+            << setprecision(1) << stats.cache.hitRate() << "% hit rate), " << stats.cache.stores << " stored, "
+            << stats.cache.skipped << " not cacheable" << endl;
+    }
+    if (stats.slow > 0) {
+        out << "  slow lane: " << stats.slow << " files missed the I/O deadline and were checked again with blocking reads" << endl;
+    }
+}
+
+#endif
@@ -0,0 +1,585 @@
+/*Microbenchmarks for the checker: index build and lookup, header extraction, database load and per-file check latency.
+Results are written as JSON lines so runs from different releases can be compared.*/
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "FileBase.h"
+#include "CheckClient.h"
+#include "CheckServer.h"
+#include "ContentClassifier.h"
+#include "DeepScanner.h"
+#include "EmbeddedSignatures.h"
+#include "FileUtils.h"
+#include "FlatIndex.h"
+#include "HeaderReader.h"
+#include "SignatureDatabase.h"
+#include "SignatureStore.h"
+#include "SyntheticData.h"
+
+using namespace std;
+
+// One measurement. Percentiles are only filled in for latency benchmarks.
+struct BenchResult {
+    string benchmark;
+    string variant;
+    size_t n = 0;        // Problem size (extensions or files)
+    size_t ops = 0;      // Operations timed
+    double nsPerOp = 0;
+    double p50 = -1;
+    double p99 = -1;
+    double max = -1;
+};
+
+volatile size_t benchSink; // Keeps results alive so the compiler cannot drop the work
+
+double nowNs() {
+    return chrono::duration<double, nano>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void writeResult(ostream& out, const BenchResult& r) {
+    out << "{\"benchmark\":\"" << r.benchmark << "\",\"variant\":\"" << r.variant << "\",\"n\":" << r.n
+        << ",\"ops\":" << r.ops << ",\"ns_per_op\":" << r.nsPerOp;
+    if (r.p50 >= 0)
+        out << ",\"p50_ns\":" << r.p50 << ",\"p99_ns\":" << r.p99 << ",\"max_ns\":" << r.max;
+    out << "}" << endl;
+}
+
+// Fill in percentiles from per-operation samples
+void summarize(BenchResult& r, vector<double>& samples) {
+    if (samples.empty())
+        return;
+    sort(samples.begin(), samples.end());
+    double total = 0;
+    for (double s : samples)
+        total += s;
+    r.ops = samples.size();
+    r.nsPerOp = total / samples.size();
+    r.p50 = samples[samples.size() / 2];
+    r.p99 = samples[min(samples.size() - 1, samples.size() * 99 / 100)];
+    r.max = samples.back();
+}
+
+// Run body(iterations) a few times and keep the fastest ns/op
+template <typename Body>
+double timePerOp(size_t iterations, Body body) {
+    double best = 0;
+    for (int round = 0; round < 3; round++) {
+        double start = nowNs();
+        body(iterations);
+        double perOp = (nowNs() - start) / iterations;
+        if (round == 0 || perOp < best)
+            best = perOp;
+    }
+    return best;
+}
+
+// Ask the kernel to drop a file from the page cache so the next read goes to disk
+void evictFromPageCache(const string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+#ifdef POSIX_FADV_DONTNEED
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+        close(fd);
+    }
+}
+
+// Insert and lookup cost as the number of extensions grows
+void benchIndexes(ostream& out, const vector<size_t>& sizes, size_t lookups) {
+    for (size_t extensions : sizes) {
+        vector<SyntheticRow> rows = generateSignatureRows(extensions, 2, 8, 42);
+        vector<pair<string, ByteSignature>> decoded;
+        for (const SyntheticRow& row : rows) {
+            ByteSignature sig;
+            parseSignature(row.hex, sig);
+            decoded.emplace_back(row.extension, sig);
+        }
+
+        BenchResult insert{ "index_build", "tree_insert", extensions };
+        insert.ops = decoded.size();
+        insert.nsPerOp = timePerOp(1, [&](size_t) {
+            RedBlackTree<ByteSignature> tree;
+            for (const auto& row : decoded)
+                tree.insert(row.second, row.first, row.second.length);
+            benchSink = benchSink + 1;
+        }) / decoded.size();
+        writeResult(out, insert);
+
+        BenchResult flatBuild{ "index_build", "flat_build", extensions };
+        flatBuild.ops = decoded.size();
+        flatBuild.nsPerOp = timePerOp(1, [&](size_t) {
+            FlatSignatureIndex flat;
+            flat.build(decoded);
+            benchSink = benchSink + flat.extensionCount();
+        }) / decoded.size();
+        writeResult(out, flatBuild);
+
+        RedBlackTree<ByteSignature> tree;
+        FlatSignatureIndex flat;
+        for (const auto& row : decoded)
+            tree.insert(row.second, row.first, row.second.length);
+        flat.build(decoded);
+
+        string csvPath = "bench_db.csv";
+        string dbPath = "bench_db.bin";
+        writeSignatureCsv(rows, csvPath);
+        string error;
+        SignatureDatabase mapped;
+        if (!compileSignatureDatabase(csvPath, dbPath, error) || !mapped.open(dbPath, error))
+            cerr << error << endl;
+
+        // Lookup keys: every extension in random order, plus the same number of misses
+        mt19937 rng(7);
+        vector<string> hits;
+        for (size_t i = 0; i < rows.size(); i += 2)
+            hits.push_back(rows[i].extension);
+        vector<string> keys;
+        for (size_t i = 0; i < lookups; i++) {
+            keys.push_back(hits[rng() % hits.size()]);
+        }
+        vector<string> misses;
+        for (size_t i = 0; i < lookups; i++)
+            misses.push_back("zz" + to_string(i) + "q");
+
+        auto lookupBench = [&](const char* variant, auto& index, const vector<string>& queries, const char* name) {
+            BenchResult r{ name, variant, extensions, queries.size() };
+            r.nsPerOp = timePerOp(queries.size(), [&](size_t) {
+                SignatureSpan span;
+                size_t found = 0;
+                for (const string& key : queries)
+                    found += lookupSignatures(index, key, span) ? span.size : 0;
+                benchSink = benchSink + found;
+            });
+            writeResult(out, r);
+        };
+        lookupBench("tree", tree, keys, "index_search_hit");
+        lookupBench("flat", flat, keys, "index_search_hit");
+        lookupBench("mapped", mapped, keys, "index_search_hit");
+        lookupBench("tree", tree, misses, "index_search_miss");
+        lookupBench("flat", flat, misses, "index_search_miss");
+        lookupBench("mapped", mapped, misses, "index_search_miss");
+
+        // Database load: CSV into each index, and opening the compiled file
+        BenchResult loadTree{ "db_load", "csv_tree", extensions, 1 };
+        loadTree.nsPerOp = timePerOp(1, [&](size_t) {
+            RedBlackTree<ByteSignature> t;
+            LoadFileSignatures(t, csvPath);
+        });
+        writeResult(out, loadTree);
+
+        BenchResult loadFlat{ "db_load", "csv_flat", extensions, 1 };
+        loadFlat.nsPerOp = timePerOp(1, [&](size_t) {
+            FlatSignatureIndex f;
+            LoadFileSignatures(f, nullptr, csvPath);
+            benchSink = benchSink + f.extensionCount();
+        });
+        writeResult(out, loadFlat);
+
+        BenchResult loadMapped{ "db_load", "compiled_mmap", extensions, 1 };
+        loadMapped.nsPerOp = timePerOp(1, [&](size_t) {
+            SignatureDatabase d;
+            d.open(dbPath, error);
+            benchSink = benchSink + d.extensionCount();
+        });
+        writeResult(out, loadMapped);
+
+        remove(csvPath.c_str());
+        remove(dbPath.c_str());
+    }
+}
+
+// The compiled-in table against the runtime indexes holding the same rows: lookups, and
+// what startup costs with no file to read
+void benchEmbedded(ostream& out, size_t lookups) {
+    EmbeddedSignatureIndex<EMBEDDED_SIGNATURES> embedded;
+    vector<pair<string, ByteSignature>> decoded;
+    for (uint32_t i = 0; i < EMBEDDED_SIGNATURES.signatureCount; i++) {
+        uint32_t s = EMBEDDED_SIGNATURES.order[i];
+        const EmbeddedExtension& ext = EMBEDDED_SIGNATURES.extensions[EMBEDDED_SIGNATURES.owners[s]];
+        decoded.emplace_back(string(ext.name, ext.nameLength), EMBEDDED_SIGNATURES.signatures[s]);
+    }
+    if (decoded.empty())
+        return;
+    RedBlackTree<ByteSignature> tree;
+    for (const auto& row : decoded)
+        tree.insert(row.second, row.first, row.second.length);
+    FlatSignatureIndex flat;
+    flat.build(decoded);
+
+    mt19937 rng(11);
+    vector<string> keys;
+    for (size_t i = 0; i < lookups; i++)
+        keys.push_back(decoded[rng() % decoded.size()].first);
+    size_t extensions = embedded.extensionCount();
+
+    auto lookupBench = [&](const char* variant, auto& index) {
+        BenchResult r{ "embedded_search_hit", variant, extensions, keys.size() };
+        r.nsPerOp = timePerOp(keys.size(), [&](size_t) {
+            SignatureSpan span;
+            size_t found = 0;
+            for (const string& key : keys)
+                found += lookupSignatures(index, key, span) ? span.size : 0;
+            benchSink = benchSink + found;
+        });
+        writeResult(out, r);
+    };
+    lookupBench("tree", tree);
+    lookupBench("flat", flat);
+    lookupBench("embedded", embedded);
+
+    BenchResult startup{ "db_load", "embedded_reverse", extensions, 1 };
+    startup.nsPerOp = timePerOp(1, [&](size_t) {
+        SignatureTrie reverse;
+        embedded.buildReverseIndex(reverse);
+        benchSink = benchSink + reverse.size();
+    });
+    writeResult(out, startup);
+}
+
+// Extension resolution per path: the old split at the last dot (two copies and a trim) against
+// the suffix trie, which also finds compound extensions like tar.gz
+void benchExtensionResolve(ostream& out, size_t lookups) {
+    EmbeddedSignatureIndex<EMBEDDED_SIGNATURES> embedded;
+    auto resolver = embedded.extensionResolver();
+    vector<string> paths;
+    mt19937 rng(13);
+    for (size_t i = 0; i < lookups; i++) {
+        const EmbeddedExtension& ext = EMBEDDED_SIGNATURES.extensions[rng() % EMBEDDED_SIGNATURES.extensionCount];
+        paths.push_back("/srv/uploads/2024.10/user" + to_string(rng() % 1000) + "/file" + to_string(i) + "."
+                        + string(ext.name, ext.nameLength));
+    }
+    if (paths.empty())
+        return;
+
+    BenchResult lastDot{ "extension_resolve", "last_dot", resolver.extensionCount(), paths.size() };
+    lastDot.nsPerOp = timePerOp(paths.size(), [&](size_t) {
+        size_t total = 0;
+        for (const string& path : paths) {
+            size_t dot = path.find_last_of('.');
+            total += dot == string::npos ? 0 : trim(path.substr(dot + 1)).size();
+        }
+        benchSink = benchSink + total;
+    });
+    writeResult(out, lastDot);
+
+    BenchResult trie{ "extension_resolve", "suffix_trie", resolver.extensionCount(), paths.size() };
+    trie.nsPerOp = timePerOp(paths.size(), [&](size_t) {
+        size_t total = 0;
+        string extension;
+        for (const string& path : paths) {
+            resolver.resolve(path, extension);
+            total += extension.size();
+        }
+        benchSink = benchSink + total;
+    });
+    writeResult(out, trie);
+}
+
+// Cost of the content classifier on one sample of each kind, the bytes already in memory
+void benchContentClassifier(ostream& out, size_t iterations) {
+    mt19937 rng(5);
+    vector<unsigned char> random(CONTENT_SAMPLE), text(CONTENT_SAMPLE), binary(CONTENT_SAMPLE);
+    const char words[] = "the quick brown fox jumps over the lazy dog, grüße\n";
+    for (size_t i = 0; i < CONTENT_SAMPLE; i++) {
+        random[i] = static_cast<unsigned char>(rng());
+        text[i] = static_cast<unsigned char>(words[i % (sizeof(words) - 1)]);
+        binary[i] = static_cast<unsigned char>(rng() % 4 == 0 ? rng() : 0);
+    }
+    auto bench = [&](const char* variant, const vector<unsigned char>& sample) {
+        BenchResult r{ "content_classify", variant, sample.size(), iterations };
+        r.nsPerOp = timePerOp(iterations, [&](size_t n) {
+            size_t total = 0;
+            for (size_t i = 0; i < n; i++)
+                total += classifyContent(sample.data(), sample.size(), true);
+            benchSink = benchSink + total;
+        });
+        writeResult(out, r);
+    };
+    bench("text", text);
+    bench("binary", binary);
+    bench("random", random);
+}
+
+// Header extraction on a hot and a cold page cache, per file and batched
+void benchHeaderReads(ostream& out, const vector<string>& paths) {
+    if (paths.empty())
+        return;
+    vector<FileHeader> headers(paths.size());
+    for (FileHeader& header : headers)
+        header.planRead(0, MAX_SIGNATURE_BYTES);
+
+    auto perFile = [&]() {
+        size_t total = 0;
+        for (size_t i = 0; i < paths.size(); i++) {
+            readHeaderPread(paths[i].c_str(), headers[i]);
+            total += headers[i].size;
+        }
+        benchSink = benchSink + total;
+    };
+    auto batched = [&](HeaderReader& reader) {
+        vector<HeaderRequest> requests(paths.size());
+        for (size_t i = 0; i < paths.size(); i++) {
+            requests[i].path = paths[i].c_str();
+            requests[i].header = &headers[i];
+        }
+        reader.readBatch(requests.data(), requests.size());
+    };
+    auto evictAll = [&]() {
+        for (const string& path : paths)
+            evictFromPageCache(path);
+    };
+
+    HeaderReader uring(HeaderReader::IO_URING);
+    string batchVariant = string("batch_") + backendName(uring.activeBackend());
+
+    for (bool cold : { false, true }) {
+        const char* name = cold ? "header_read_cold" : "header_read_hot";
+
+        if (cold)
+            evictAll();
+        else
+            perFile();
+        BenchResult single{ name, "pread", paths.size(), paths.size() };
+        double start = nowNs();
+        perFile();
+        single.nsPerOp = (nowNs() - start) / paths.size();
+        writeResult(out, single);
+
+        if (cold)
+            evictAll();
+        BenchResult batch{ name, batchVariant, paths.size(), paths.size() };
+        start = nowNs();
+        batched(uring);
+        batch.nsPerOp = (nowNs() - start) / paths.size();
+        writeResult(out, batch);
+    }
+}
+
+// Full per-file check latency (extension, lookup, read, match), one sample per file
+void benchCheckLatency(ostream& out, const vector<SyntheticRow>& rows, const vector<string>& paths) {
+    RedBlackTree<ByteSignature> tree;
+    SignatureTrie reverse;
+    for (const SyntheticRow& row : rows) {
+        ByteSignature sig;
+        if (parseSignature(row.hex, sig)) {
+            tree.insert(sig, row.extension, sig.length);
+            reverse.insert(sig.bytes, sig.length, row.extension);
+        }
+    }
+
+    for (bool withReverse : { false, true }) {
+        vector<double> samples;
+        samples.reserve(paths.size());
+        size_t matches = 0;
+        for (const string& path : paths) {
+            double start = nowNs();
+            CheckResult result = checkFile(tree, path, withReverse ? &reverse : nullptr);
+            samples.push_back(nowNs() - start);
+            matches += result.verdict == MATCH;
+        }
+        benchSink = benchSink + matches;
+        BenchResult r{ "check_latency", withReverse ? "tree_reverse" : "tree", paths.size() };
+        summarize(r, samples);
+        writeResult(out, r);
+    }
+}
+
+// Round trip through the daemon: one request at a time over its Unix socket, as a caller
+// that shells out per file would see it, minus the process start and database load
+void benchServerLatency(ostream& out, const vector<SyntheticRow>& rows, const vector<string>& paths, const string& workDir) {
+    string csvPath = workDir + "/server_signatures.txt";
+    string error;
+    SignatureStore<RedBlackTree<ByteSignature>> store;
+    if (!writeSignatureCsv(rows, csvPath) || !store.reload(csvPath, error)) {
+        cerr << "Error preparing the server database: " << error << endl;
+        return;
+    }
+
+    string socketPath = workDir + "/bench.sock";
+    CheckServer<RedBlackTree<ByteSignature>> server(store, nullptr, 2);
+    if (!server.listen(socketPath, error)) {
+        cerr << error << endl;
+        return;
+    }
+    thread serving(&CheckServer<RedBlackTree<ByteSignature>>::run, &server);
+
+    CheckClient client;
+    if (client.connect(socketPath, error)) {
+        vector<double> samples;
+        samples.reserve(paths.size());
+        string line;
+        for (const string& path : paths) {
+            double start = nowNs();
+            if (!client.check(path, line))
+                break;
+            samples.push_back(nowNs() - start);
+        }
+        BenchResult r{ "check_latency", "server_roundtrip", paths.size() };
+        summarize(r, samples);
+        writeResult(out, r);
+
+        // Pipelined: the whole list in flight through one connection
+        double start = nowNs();
+        size_t answered = 0;
+        client.checkAll(paths, [&](const string&) { answered++; });
+        BenchResult p{ "check_throughput", "server_pipelined", paths.size(), answered };
+        p.nsPerOp = answered > 0 ? (nowNs() - start) / answered : 0;
+        writeResult(out, p);
+    } else {
+        cerr << error << endl;
+    }
+    client.disconnect();
+    server.stop();
+    serving.join();
+    unlink(socketPath.c_str());
+}
+
+// Deep scan throughput over random data with a few signatures planted in it, for each vector
+// width the machine supports. ns_per_op is per byte scanned (1 / ns_per_op is GB/s).
+void benchDeepScan(ostream& out, const vector<SyntheticRow>& rows, size_t bytes) {
+    SignatureTrie reverse;
+    for (const SyntheticRow& row : rows) {
+        ByteSignature sig;
+        if (parseSignature(row.hex, sig))
+            reverse.insert(sig.bytes, sig.length, row.extension);
+    }
+
+    mt19937_64 rng(7);
+    vector<unsigned char> data(bytes + DEEP_SCAN_PADDING);
+    for (size_t i = 0; i + 8 <= bytes; i += 8) {
+        uint64_t word = rng();
+        memcpy(data.data() + i, &word, 8);
+    }
+    for (size_t i = 0; i < rows.size(); i++) {
+        ByteSignature sig;
+        if (parseSignature(rows[i].hex, sig))
+            memcpy(data.data() + rng() % (bytes - sig.length), sig.bytes, sig.length);
+    }
+
+    for (int width : { 32, 16, 0 }) {
+        DeepScanner scanner;
+        scanner.build(reverse, 4);
+        scanner.setVectorWidth(width);
+        if (scanner.activeVectorWidth() != width)
+            continue;
+        vector<DeepHit> hits;
+        double perByte = timePerOp(bytes, [&](size_t) {
+            hits.clear();
+            scanner.scanBuffer(data.data(), bytes, bytes, 0, hits);
+        });
+        benchSink = benchSink + hits.size();
+        const char* variant = width == 32 ? "avx2" : width == 16 ? "ssse3" : "scalar";
+        BenchResult r{ "deep_scan", variant, scanner.patternCount(), bytes };
+        r.nsPerOp = perByte;
+        writeResult(out, r);
+    }
+}
+
+void printUsage(const char* program) {
+    cerr << "Usage: " << program << " [--quick] [--out FILE] [--work DIR]   (run every benchmark, JSON lines)\n"
+         << "       " << program << " --generate-db EXTENSIONS FILE         (write a synthetic FileSignature.txt)\n"
+         << "       " << program << " --generate-corpus CSV DIR FILES [MISMATCH_RATE]" << endl;
+}
+
+// Utility function: Report an option value that is not a number, with the usage text
+int badValue(const char* program, const string& option, const string& text) {
+    cerr << "Bad value for " << option << ": " << text << endl;
+    printUsage(program);
+    return 1;
+}
+
+// Utility function: Parse a mismatch rate, a fraction from 0 to 1. False for anything else.
+bool parseRate(const string& text, double& rate) {
+    char* end = nullptr;
+    errno = 0;
+    double parsed = strtod(text.c_str(), &end);
+    if (text.empty() || *end != '\0' || errno != 0 || !(parsed >= 0.0 && parsed <= 1.0))
+        return false;
+    rate = parsed;
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    bool quick = false;
+    string outPath;
+    string workDir = "bench_work";
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--generate-db" && i + 2 < argc) {
+            size_t extensions = 0;
+            if (!parseOptionNumber(argv[i + 1], extensions))
+                return badValue(argv[0], arg, argv[i + 1]);
+            vector<SyntheticRow> rows = generateSignatureRows(extensions, 2, 8, 42);
+            return writeSignatureCsv(rows, argv[i + 2]) ? 0 : 1;
+        } else if (arg == "--generate-corpus" && i + 3 < argc) {
+            size_t files = 0;
+            double rate = 0.1;
+            if (!parseOptionNumber(argv[i + 3], files))
+                return badValue(argv[0], arg, argv[i + 3]);
+            if (i + 4 < argc && !parseRate(argv[i + 4], rate))
+                return badValue(argv[0], arg, argv[i + 4]);
+            vector<SyntheticRow> rows;
+            ifstream csv(argv[i + 1]);
+            string line;
+            string extension;
+            ByteSignature sig;
+            while (getline(csv, line)) {
+                if (parseSignatureLine(line, extension, sig))
+                    rows.push_back({ extension, sig.toHex() });
+            }
+            vector<string> paths = generateCorpus(rows, argv[i + 2], files, rate, 4096, 1);
+            cout << "Generated " << paths.size() << " files in " << argv[i + 2] << endl;
+            return 0;
+        } else if (arg == "--quick") {
+            quick = true;
+        } else if (arg == "--out" && i + 1 < argc) {
+            outPath = argv[++i];
+        } else if (arg == "--work" && i + 1 < argc) {
+            workDir = argv[++i];
+        } else {
+            printUsage(argv[0]);
+            return arg == "-h" || arg == "--help" ? 0 : 1;
+        }
+    }
+
+    ofstream outFile;
+    if (!outPath.empty()) {
+        outFile.open(outPath, ios::trunc);
+        if (!outFile) {
+            cerr << "Error opening output file: " << outPath << endl;
+            return 1;
+        }
+    }
+    ostream& out = outPath.empty() ? cout : outFile;
+
+    vector<size_t> sizes = quick ? vector<size_t>{ 16, 256, 4096 } : vector<size_t>{ 16, 256, 4096, 65536 };
+    size_t lookups = quick ? 20000 : 200000;
+    size_t files = quick ? 2000 : 20000;
+
+    benchIndexes(out, sizes, lookups);
+    benchEmbedded(out, lookups);
+    benchExtensionResolve(out, lookups);
+    benchContentClassifier(out, quick ? 2000 : 20000);
+
+    vector<SyntheticRow> rows = generateSignatureRows(256, 2, 8, 42);
+    vector<string> paths = generateCorpus(rows, workDir, files, 0.1, 4096, 1);
+    benchHeaderReads(out, paths);
+    benchCheckLatency(out, rows, paths);
+    benchServerLatency(out, rows, paths, workDir);
+    benchDeepScan(out, generateSignatureRows(64, 1, 8, 7), quick ? (16u << 20) : (256u << 20));
+
+    std::filesystem::remove_all(workDir);
+    return 0;
+}
@@ -0,0 +1,216 @@
+// Bounded lock-free queue for handing work between threads
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Lets threads sleep until another thread changes what they are waiting on, instead of
+// polling (an "event count"). A waiter takes a ticket, looks at its condition once more and
+// sleeps only if nobody has notified since the ticket; a notifier pays a fence and a load
+// while nobody sleeps, and a mutex and a wakeup only when someone does.
+class EventCount {
+private:
+    mutex lock;
+    condition_variable changed;
+    atomic<uint64_t> epoch;
+    atomic<uint32_t> sleepers;
+
+public:
+    EventCount()
+        : epoch(0), sleepers(0)
+    {
+    }
+
+    // Public function: Announce a wait; check the condition again before calling wait()
+    uint64_t prepareWait()
+    {
+        sleepers.fetch_add(1);
+        atomic_thread_fence(memory_order_seq_cst); // Pairs with the fence in notifyAll
+        return epoch.load();
+    }
+
+    // Public function: The condition came true after all
+    void cancelWait() { sleepers.fetch_sub(1); }
+
+    // Public function: Sleep until notifyAll() is called after the ticket was taken
+    void wait(uint64_t ticket)
+    {
+        {
+            unique_lock<mutex> hold(lock);
+            changed.wait(hold, [&]() { return epoch.load() != ticket; });
+        }
+        sleepers.fetch_sub(1);
+    }
+
+    // Public function: Wake every waiter. Call after making the change they wait for.
+    void notifyAll()
+    {
+        atomic_thread_fence(memory_order_seq_cst);
+        if (sleepers.load() == 0)
+            return;
+        {
+            lock_guard<mutex> hold(lock);
+            epoch.fetch_add(1);
+        }
+        changed.notify_all();
+    }
+};
+
+// Multi-producer, multi-consumer ring buffer (Vyukov's design). Each cell carries a
+// sequence number that tells producers and consumers whose turn it is, so pushes and
+// pops are a single compare-and-swap on the position counter with no locks.
+// The capacity is rounded up to a power of two. push() and pop() wrap the two in a short
+// spin and then a sleep on an EventCount, for threads that would otherwise poll.
+template <typename T> class BoundedQueue {
+private:
+    // Structure for one slot of the ring
+    struct Cell {
+        atomic<size_t> sequence;
+        T data;
+    };
+
+    vector<Cell> cells;
+    size_t mask;
+    alignas(64) atomic<size_t> enqueuePos; // Kept on separate cache lines so
+    alignas(64) atomic<size_t> dequeuePos; // producers and consumers do not false-share
+    EventCount pushed; // For consumers sleeping in pop() on an empty queue
+    EventCount popped; // For producers sleeping in push() on a full one
+
+    // Yields before a blocking push or pop goes to sleep, so a busy queue rarely needs a wakeup
+    static const int spinsBeforeSleep = 64;
+
+public:
+    explicit BoundedQueue(size_t capacity)
+        : cells(roundUp(capacity)), mask(cells.size() - 1), enqueuePos(0), dequeuePos(0)
+    {
+        for (size_t i = 0; i < cells.size(); i++)
+            cells[i].sequence.store(i, memory_order_relaxed);
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // Public function: Smallest power of two that is at least capacity (and at least 2)
+    static size_t roundUp(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size *= 2;
+        return size;
+    }
+
+    // Public function: Add a value. Returns false (leaving value untouched) if the queue is full.
+    bool tryPush(T& value)
+    {
+        size_t pos = enqueuePos.load(memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                    cell.data = move(value);
+                    cell.sequence.store(pos + 1, memory_order_release);
+                    pushed.notifyAll();
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // Full
+            } else {
+                pos = enqueuePos.load(memory_order_relaxed);
+            }
+        }
+    }
+
+    // Public function: Take the oldest value. Returns false if the queue is empty.
+    bool tryPop(T& value)
+    {
+        size_t pos = dequeuePos.load(memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                    value = move(cell.data);
+                    cell.sequence.store(pos + mask + 1, memory_order_release);
+                    popped.notifyAll();
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // Empty
+            } else {
+                pos = dequeuePos.load(memory_order_relaxed);
+            }
+        }
+    }
+
+    // Public function: Add a value, yielding and then sleeping while the queue is full
+    void push(T& value)
+    {
+        for (int spins = 0; !tryPush(value); spins++) {
+            if (spins < spinsBeforeSleep) {
+                this_thread::yield();
+                continue;
+            }
+            uint64_t ticket = popped.prepareWait();
+            if (tryPush(value)) {
+                popped.cancelWait();
+                return;
+            }
+            popped.wait(ticket);
+        }
+    }
+
+    // Public function: Take the oldest value, yielding and then sleeping while the queue is
+    // empty. Returns false once finished() is true and the queue is empty. Whoever makes
+    // finished() true must call wakeConsumers() afterwards.
+    template <typename Finished>
+    bool pop(T& value, Finished finished)
+    {
+        for (int spins = 0; !tryPop(value); spins++) {
+            if (spins < spinsBeforeSleep) {
+                if (finished() && sizeApprox() == 0)
+                    return false;
+                this_thread::yield();
+                continue;
+            }
+            uint64_t ticket = pushed.prepareWait();
+            if (tryPop(value)) {
+                pushed.cancelWait();
+                return true;
+            }
+            if (finished() && sizeApprox() == 0) {
+                pushed.cancelWait();
+                return false;
+            }
+            pushed.wait(ticket);
+        }
+        return true;
+    }
+
+    // Public function: Wake every consumer sleeping in pop(), to look at finished() again
+    void wakeConsumers() { pushed.notifyAll(); }
+
+    // Public function: Number of slots
+    size_t capacity() const { return cells.size(); }
+
+    // Public function: Approximate number of queued values (exact when no one is pushing or popping)
+    size_t sizeApprox() const
+    {
+        size_t enq = enqueuePos.load(memory_order_relaxed);
+        size_t deq = dequeuePos.load(memory_order_relaxed);
+        return enq > deq ? enq - deq : 0;
+    }
+};
+
+#endif
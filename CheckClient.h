@@ -0,0 +1,155 @@
+// Client side of the checker daemon (see CheckServer.h for the protocol)
+#ifndef CHECK_CLIENT_H
+#define CHECK_CLIENT_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Blocking connection to a running server. check() is one round trip; checkAll() keeps a
+// window of requests in flight so a long list is answered at the server's pace instead
+// of one round trip per file.
+class CheckClient {
+private:
+    int fd;
+    string received; // Bytes read past the last returned line
+
+    // Utility function: Write a whole buffer, retrying short writes
+    bool sendAll(const string& data)
+    {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+public:
+    CheckClient()
+        : fd(-1)
+    {
+    }
+
+    CheckClient(const CheckClient&) = delete;
+    CheckClient& operator=(const CheckClient&) = delete;
+
+    ~CheckClient() { disconnect(); }
+
+    // Public function: Connect to the server's socket. Returns false with error filled in.
+    bool connect(const string& socketPath, string& error)
+    {
+        disconnect();
+        sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path)) {
+            error = "Socket path is empty or too long: " + socketPath;
+            return false;
+        }
+        memcpy(address.sun_path, socketPath.c_str(), socketPath.size());
+
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            error = "Error connecting to " + socketPath + ": " + strerror(errno);
+            disconnect();
+            return false;
+        }
+        return true;
+    }
+
+    // Public function: Close the connection
+    void disconnect()
+    {
+        if (fd >= 0)
+            close(fd);
+        fd = -1;
+        received.clear();
+    }
+
+    // Public function: Queue requests without waiting for the answers. Paths must be non-empty
+    // and must not contain newlines, or the answers will not line up with the requests.
+    bool send(const string* paths, size_t count)
+    {
+        string request;
+        for (size_t i = 0; i < count; i++) {
+            request += paths[i];
+            request += '\n';
+        }
+        return fd >= 0 && sendAll(request);
+    }
+
+    // Public function: Wait for the next answer line (without its newline)
+    bool receive(string& line)
+    {
+        char buffer[16 * 1024];
+        while (true) {
+            size_t newline = received.find('\n');
+            if (newline != string::npos) {
+                line.assign(received, 0, newline);
+                received.erase(0, newline + 1);
+                return true;
+            }
+            if (fd < 0)
+                return false;
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            received.append(buffer, static_cast<size_t>(n));
+        }
+    }
+
+    // Public function: Check one path and wait for its answer
+    bool check(const string& path, string& line)
+    {
+        return sendable(path) && send(&path, 1) && receive(line);
+    }
+
+    // Public function: Can path be sent? The protocol is one path per line, and the server
+    // ignores empty lines, so an empty path or one with a newline would never be answered.
+    static bool sendable(const string& path) { return !path.empty() && path.find('\n') == string::npos; }
+
+    // Public function: Check many paths, keeping up to window requests in flight.
+    // onLine is called with each answer, in request order. Paths that cannot be sent are
+    // skipped (and get no answer). Returns false if the connection failed.
+    template <typename OnLine>
+    bool checkAll(const vector<string>& paths, OnLine onLine, size_t window = 256)
+    {
+        if (!all_of(paths.begin(), paths.end(), sendable)) {
+            vector<string> kept;
+            copy_if(paths.begin(), paths.end(), back_inserter(kept), sendable);
+            return checkAll(kept, onLine, window);
+        }
+        window = window == 0 ? 1 : window;
+        size_t sent = 0;
+        string line;
+        for (size_t answered = 0; answered < paths.size(); answered++) {
+            if (sent == answered || (sent < paths.size() && sent - answered < window / 2)) {
+                size_t count = min(window - (sent - answered), paths.size() - sent);
+                if (!send(paths.data() + sent, count))
+                    return false;
+                sent += count;
+            }
+            if (!receive(line))
+                return false;
+            onLine(line);
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,342 @@
+// Long-running checker daemon: answers check requests over a Unix domain socket
+#ifndef CHECK_SERVER_H
+#define CHECK_SERVER_H
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "AsyncLogger.h"
+#include "FileUtils.h"
+#include "SignatureStore.h"
+
+using namespace std;
+
+// Protocol: the client writes one path per line ('\n', a trailing '\r' is dropped) and may
+// send any number of requests before reading. The server answers every request with one
+// line, in request order, in the batch mode format:
+//   VERDICT<TAB>path<TAB>extension<TAB>signature or error[<TAB>detected,types]
+// Empty lines are ignored. Paths longer than MAX_REQUEST_LINE are answered with an ERROR
+// line and skipped.
+const size_t MAX_REQUEST_LINE = 4096;
+
+// Create a listening Unix socket at path, replacing a stale socket file left by an earlier run.
+// The socket file gets permissions mode; anyone who can connect can have the daemon read any
+// file it can reach, so the default lets in only its own user. Returns the descriptor or -1
+// with error filled in.
+inline int listenUnixSocket(const string& path, mode_t mode, string& error) {
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        error = "Socket path is empty or too long: " + path;
+        return -1;
+    }
+    memcpy(address.sun_path, path.c_str(), path.size());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        error = string("Error creating socket: ") + strerror(errno);
+        return -1;
+    }
+    struct stat info;
+    if (lstat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+        unlink(path.c_str());
+    }
+    // Linux creates the socket file with the socket's own mode less the umask, so it is never
+    // more open than mode, not even between bind and chmod; chmod then undoes the umask
+    if (fchmod(fd, mode) < 0 || bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0
+        || chmod(path.c_str(), mode) < 0 || listen(fd, SOMAXCONN) < 0) {
+        error = "Error listening on " + path + ": " + strerror(errno);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Serves the snapshots of a SignatureStore, so the database is parsed once for the life of
+// the process and can be reloaded while requests are in flight: each request pins the
+// newest snapshot, and a check in progress finishes on the one it started with. A fixed pool of workers each run their own epoll loop;
+// the accepting thread hands every new connection to the next worker in turn, and that
+// worker reads, checks and answers all of the connection's requests without any handoff
+// between threads, so a request costs one read, the check and one write.
+template <typename Index>
+class CheckServer {
+private:
+    // Structure for one client connection, owned by a single worker
+    struct Connection {
+        string input;         // Bytes received but not yet parsed
+        string output;        // Responses not yet written
+        size_t written = 0;   // Bytes of output already sent
+        bool skipping = false; // Discarding the rest of an over-long line
+        bool peerClosed = false;
+        uint32_t watching = EPOLLIN; // Events currently registered with epoll
+    };
+
+    // Stop reading a connection while this much output is waiting for the client
+    static const size_t maxPendingOutput = 1 << 20;
+
+    const SignatureStore<Index>& store;
+    AsyncLogger* logger;
+    size_t workerCount;
+    int listenFd;
+    int stopPipe[2];        // Written once to stop every thread
+    vector<int> epollFds;   // One per worker
+    atomic<size_t> served;  // Requests answered
+
+    // Utility function: Answer a request whose path is longer than MAX_REQUEST_LINE
+    static void rejectLongLine(Connection& connection, const string& input, size_t start)
+    {
+        connection.output += "ERROR\t";
+        connection.output.append(input, start, 64);
+        connection.output += "...\t\t";
+        connection.output += strerror(ENAMETOOLONG);
+        connection.output += '\n';
+    }
+
+    // Utility function: Parse and answer every complete line in a connection's input
+    void handleInput(Connection& connection, CheckResult& result, SnapshotReader<Index>& reader)
+    {
+        size_t start = 0;
+        string& input = connection.input;
+        while (connection.output.size() - connection.written < maxPendingOutput) {
+            size_t newline = input.find('\n', start);
+            if (newline == string::npos) {
+                break;
+            }
+            size_t end = newline;
+            if (end > start && input[end - 1] == '\r') {
+                end--;
+            }
+            if (connection.skipping) {
+                connection.skipping = false;
+            } else if (end - start > MAX_REQUEST_LINE) {
+                rejectLongLine(connection, input, start);
+            } else if (end > start) {
+                const SignatureSnapshot<Index>& snapshot = reader.pin();
+                result.path.assign(input, start, end - start);
+                checkFile(snapshot.index, result.path, &snapshot.reverse, result);
+                recordCheck(result);
+                appendResultLine(connection.output, result);
+                if (logger != nullptr) {
+                    StageTimer logTimer(STAGE_LOG);
+                    logger->log(result);
+                }
+                served.fetch_add(1, memory_order_relaxed);
+            }
+            start = newline + 1;
+        }
+        input.erase(0, start);
+
+        // A line that can never fit is answered now and the rest of it dropped
+        if (input.size() > MAX_REQUEST_LINE && input.find('\n') == string::npos) {
+            if (!connection.skipping) {
+                rejectLongLine(connection, input, 0);
+                connection.skipping = true;
+            }
+            input.clear();
+        }
+    }
+
+    // Utility function: Send as much pending output as the socket takes. Returns false on error.
+    static bool flushOutput(int fd, Connection& connection)
+    {
+        while (connection.written < connection.output.size()) {
+            ssize_t n = send(fd, connection.output.data() + connection.written,
+                             connection.output.size() - connection.written, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                return errno == EAGAIN || errno == EWOULDBLOCK;
+            }
+            connection.written += static_cast<size_t>(n);
+        }
+        connection.output.clear();
+        connection.written = 0;
+        return true;
+    }
+
+    // Utility function: One worker's event loop
+    void work(int epollFd)
+    {
+        unordered_map<int, Connection> connections;
+        SnapshotReader<Index> reader(store);
+        CheckResult result;
+        char buffer[64 * 1024];
+        epoll_event events[64];
+
+        while (true) {
+            int n = epoll_wait(epollFd, events, 64, -1);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+            for (int e = 0; e < n; e++) {
+                int fd = events[e].data.fd;
+                if (fd == stopPipe[0]) {
+                    for (auto& entry : connections) {
+                        flushOutput(entry.first, entry.second);
+                        close(entry.first);
+                    }
+                    return;
+                }
+
+                Connection& connection = connections[fd];
+                if (!connection.peerClosed && (events[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                    && connection.output.size() - connection.written < maxPendingOutput) {
+                    ssize_t got = recv(fd, buffer, sizeof(buffer), 0);
+                    if (got > 0) {
+                        connection.input.append(buffer, static_cast<size_t>(got));
+                    } else if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                        // A last request without its newline still gets an answer
+                        connection.peerClosed = true;
+                        if (!connection.input.empty() && connection.input.back() != '\n')
+                            connection.input += '\n';
+                    }
+                }
+                // handleInput stops once the backlog is full. If a flush then drains it, go on
+                // with the requests already buffered: no further event may come to prompt them.
+                bool ok = true;
+                do {
+                    handleInput(connection, result, reader);
+                    ok = flushOutput(fd, connection);
+                } while (ok && connection.output.empty() && connection.input.find('\n') != string::npos);
+
+                size_t backlog = connection.output.size() - connection.written;
+                if (!ok || (connection.peerClosed && backlog == 0 && connection.input.empty())) {
+                    close(fd); // Also removes it from the epoll set
+                    connections.erase(fd);
+                    continue;
+                }
+                // Level-triggered: only watch input while there is room for the answers, and
+                // only watch for writability while answers are waiting
+                uint32_t wanted = 0;
+                if (!connection.peerClosed && backlog < maxPendingOutput)
+                    wanted |= EPOLLIN;
+                if (backlog > 0)
+                    wanted |= EPOLLOUT;
+                if (wanted != connection.watching) {
+                    epoll_event event;
+                    memset(&event, 0, sizeof(event));
+                    event.events = wanted;
+                    event.data.fd = fd;
+                    epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event);
+                    connection.watching = wanted;
+                }
+            }
+        }
+    }
+
+public:
+    // The store must be loaded before run() is called
+    CheckServer(const SignatureStore<Index>& signatureStore, AsyncLogger* resultLogger, size_t workers)
+        : store(signatureStore), logger(resultLogger), workerCount(workers == 0 ? 1 : workers),
+          listenFd(-1), served(0)
+    {
+        stopPipe[0] = stopPipe[1] = -1;
+    }
+
+    CheckServer(const CheckServer&) = delete;
+    CheckServer& operator=(const CheckServer&) = delete;
+
+    ~CheckServer()
+    {
+        for (int fd : epollFds)
+            close(fd);
+        for (int fd : stopPipe) {
+            if (fd >= 0)
+                close(fd);
+        }
+        if (listenFd >= 0)
+            close(listenFd);
+    }
+
+    // Public function: Bind the socket (with permissions socketMode) and set up the workers' event loops
+    bool listen(const string& socketPath, string& error, mode_t socketMode = 0600)
+    {
+        listenFd = listenUnixSocket(socketPath, socketMode, error);
+        if (listenFd < 0)
+            return false;
+        if (pipe2(stopPipe, O_CLOEXEC) < 0) {
+            error = string("Error creating pipe: ") + strerror(errno);
+            return false;
+        }
+        for (size_t i = 0; i < workerCount; i++) {
+            int epollFd = epoll_create1(EPOLL_CLOEXEC);
+            if (epollFd < 0) {
+                error = string("Error creating epoll instance: ") + strerror(errno);
+                return false;
+            }
+            epollFds.push_back(epollFd);
+            epoll_event event;
+            memset(&event, 0, sizeof(event));
+            event.events = EPOLLIN;
+            event.data.fd = stopPipe[0];
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, stopPipe[0], &event);
+        }
+        return true;
+    }
+
+    // Public function: Accept connections until stop() is called, then wait for the workers
+    void run()
+    {
+        vector<thread> workers;
+        for (int epollFd : epollFds)
+            workers.emplace_back(&CheckServer::work, this, epollFd);
+
+        size_t nextWorker = 0;
+        pollfd fds[2] = { { listenFd, POLLIN, 0 }, { stopPipe[0], POLLIN, 0 } };
+        while (true) {
+            if (poll(fds, 2, -1) < 0) {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+            if (fds[1].revents != 0)
+                break;
+            while (true) {
+                int client = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+                if (client < 0)
+                    break;
+                epoll_event event;
+                memset(&event, 0, sizeof(event));
+                event.events = EPOLLIN;
+                event.data.fd = client;
+                if (epoll_ctl(epollFds[nextWorker], EPOLL_CTL_ADD, client, &event) < 0)
+                    close(client);
+                nextWorker = (nextWorker + 1) % epollFds.size();
+            }
+        }
+
+        for (thread& worker : workers)
+            worker.join();
+    }
+
+    // Public function: Ask run() to return. Only writes to a pipe, so it is safe in a signal handler.
+    void stop()
+    {
+        char byte = 0;
+        ssize_t ignored = write(stopPipe[1], &byte, 1);
+        (void)ignored;
+    }
+
+    // Public function: Descriptor stop() writes to, for callers that must stop the server from a
+    // signal handler without touching the object
+    int stopDescriptor() const { return stopPipe[1]; }
+
+    // Public function: Number of requests answered so far
+    size_t requestsServed() const { return served.load(memory_order_relaxed); }
+};
+
+#endif
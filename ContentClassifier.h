@@ -0,0 +1,273 @@
+// Second opinion for files no signature explains: text, binary, compressed or encrypted
+#ifndef CONTENT_CLASSIFIER_H
+#define CONTENT_CLASSIFIER_H
+
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "SafeOpen.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// What a file's first bytes look like. Only set for files the signatures could not place.
+enum ContentClass : uint8_t {
+    CONTENT_NONE,       // Not classified
+    CONTENT_EMPTY,
+    CONTENT_TEXT,       // ASCII or valid UTF-8 with few control characters
+    CONTENT_BINARY,
+    CONTENT_COMPRESSED, // High entropy, with a compressor's magic or the byte bias compressors leave
+    CONTENT_ENCRYPTED   // Indistinguishable from uniformly random bytes
+};
+
+inline const char* contentName(ContentClass content) {
+    switch (content) {
+        case CONTENT_EMPTY: return "empty";
+        case CONTENT_TEXT: return "text";
+        case CONTENT_BINARY: return "binary";
+        case CONTENT_COMPRESSED: return "compressed";
+        case CONTENT_ENCRYPTED: return "encrypted";
+        case CONTENT_NONE: break;
+    }
+    return "";
+}
+
+const size_t CONTENT_SAMPLE = 4096;      // Default bytes read from the start of a file
+const size_t CONTENT_MIN_ENTROPY = 512;  // Fewer bytes than this are never called compressed or encrypted
+const double CONTENT_HIGH_ENTROPY = 7.5; // Bits per byte, after bias correction
+
+// Measurements over a sample
+struct ContentStats {
+    uint32_t histogram[256];
+    size_t size = 0;
+    double entropy = 0;   // Shannon entropy in bits per byte, Miller-Madow corrected
+    double chiSquare = 0; // Against a uniform distribution, 255 degrees of freedom
+    bool utf8 = false;    // Valid UTF-8 (ASCII included), allowing a sequence cut off at the end
+};
+
+// Count bytes into eight interleaved 16-bit tables, so runs of one byte value do not wait on
+// each other's increments and the tables stay small, then widen and add them a vector at a
+// time. Blocks of 256 KiB keep every 16-bit count below overflow.
+inline void byteHistogram(const unsigned char* data, size_t size, uint32_t histogram[256]) {
+    memset(histogram, 0, 256 * sizeof(uint32_t));
+    const size_t block = 256 * 1024;
+    for (size_t offset = 0; offset < size; offset += block) {
+        size_t length = min(block, size - offset);
+        const unsigned char* p = data + offset;
+        uint16_t lanes[8][256] = {};
+        size_t i = 0;
+        for (; i + 8 <= length; i += 8) {
+            uint64_t word;
+            memcpy(&word, p + i, sizeof(word));
+            lanes[0][word & 0xFF]++;
+            lanes[1][(word >> 8) & 0xFF]++;
+            lanes[2][(word >> 16) & 0xFF]++;
+            lanes[3][(word >> 24) & 0xFF]++;
+            lanes[4][(word >> 32) & 0xFF]++;
+            lanes[5][(word >> 40) & 0xFF]++;
+            lanes[6][(word >> 48) & 0xFF]++;
+            lanes[7][word >> 56]++;
+        }
+        for (; i < length; i++)
+            lanes[i & 7][p[i]]++;
+#if defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        for (size_t b = 0; b < 256; b += 8) {
+            __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&histogram[b]));
+            __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&histogram[b + 4]));
+            for (size_t l = 0; l < 8; l++) {
+                __m128i counts = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&lanes[l][b]));
+                low = _mm_add_epi32(low, _mm_unpacklo_epi16(counts, zero));
+                high = _mm_add_epi32(high, _mm_unpackhi_epi16(counts, zero));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(&histogram[b]), low);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(&histogram[b + 4]), high);
+        }
+#else
+        for (size_t b = 0; b < 256; b++) {
+            for (size_t l = 0; l < 8; l++)
+                histogram[b] += lanes[l][b];
+        }
+#endif
+    }
+}
+
+// Is the sample valid UTF-8? Runs of ASCII are skipped sixteen bytes at a time. truncated says
+// the sample stops before the end of the file, so a sequence cut off at the end is accepted.
+inline bool validUtf8(const unsigned char* data, size_t size, bool truncated) {
+    size_t i = 0;
+    while (i < size) {
+#if defined(__SSE2__)
+        while (i + 16 <= size && _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i))) == 0)
+            i += 16;
+        if (i >= size)
+            break;
+#endif
+        unsigned char c = data[i];
+        if (c < 0x80) {
+            i++;
+            continue;
+        }
+        size_t length;
+        uint32_t codePoint;
+        if (c >= 0xC2 && c <= 0xDF) {
+            length = 2;
+            codePoint = c & 0x1F;
+        } else if (c >= 0xE0 && c <= 0xEF) {
+            length = 3;
+            codePoint = c & 0x0F;
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            length = 4;
+            codePoint = c & 0x07;
+        } else {
+            return false; // Continuation byte, overlong C0/C1, or beyond U+10FFFF
+        }
+        if (i + length > size) {
+            for (size_t k = i + 1; k < size; k++) {
+                if ((data[k] & 0xC0) != 0x80)
+                    return false;
+            }
+            return truncated;
+        }
+        for (size_t k = 1; k < length; k++) {
+            if ((data[i + k] & 0xC0) != 0x80)
+                return false;
+            codePoint = (codePoint << 6) | (data[i + k] & 0x3F);
+        }
+        // Overlong forms, UTF-16 surrogates, and code points past U+10FFFF
+        if ((length == 3 && codePoint < 0x800) || (length == 4 && (codePoint < 0x10000 || codePoint > 0x10FFFF))
+            || (codePoint >= 0xD800 && codePoint <= 0xDFFF))
+            return false;
+        i += length;
+    }
+    return true;
+}
+
+// c * log2(c), from a table for the counts a default sample can produce
+inline double countLog2(uint32_t count) {
+    static const vector<double> table = []() {
+        vector<double> values(CONTENT_SAMPLE + 1, 0.0);
+        for (size_t c = 1; c <= CONTENT_SAMPLE; c++)
+            values[c] = c * log2(static_cast<double>(c));
+        return values;
+    }();
+    return count <= CONTENT_SAMPLE ? table[count] : count * log2(static_cast<double>(count));
+}
+
+// Histogram, entropy, uniformity and UTF-8 validity of a sample
+inline void measureContent(const unsigned char* data, size_t size, bool truncated, ContentStats& stats) {
+    stats.size = size;
+    byteHistogram(data, size, stats.histogram);
+    stats.entropy = 0;
+    stats.chiSquare = 0;
+    if (size > 0) {
+        // H = log2(N) - sum(c log2 c) / N, and chi-square = 256 sum(c^2) / N - N
+        double total = static_cast<double>(size);
+        double weighted = 0;
+        double squares = 0;
+        size_t used = 0;
+        for (uint32_t count : stats.histogram) {
+            squares += static_cast<double>(count) * count;
+            weighted += countLog2(count);
+            used += count != 0;
+        }
+        stats.chiSquare = 256.0 * squares / total - total;
+        // The plug-in estimate runs low on small samples; Miller-Madow adds most of it back
+        stats.entropy = log2(total) - weighted / total + (used - 1) / (2.0 * total * M_LN2);
+        stats.entropy = max(0.0, min(8.0, stats.entropy));
+    }
+    stats.utf8 = validUtf8(data, size, truncated);
+}
+
+// Does the sample start with the magic of a common compressor or compressed container?
+// Good compressors leave too little bias for the statistics to catch in a few KB.
+inline bool hasCompressorMagic(const unsigned char* data, size_t size) {
+    static const struct {
+        unsigned char bytes[6];
+        size_t length;
+    } magics[] = {
+        { { 0x1F, 0x8B }, 2 },                         // gzip
+        { { 0xFD, '7', 'z', 'X', 'Z', 0x00 }, 6 },     // xz
+        { { 0x28, 0xB5, 0x2F, 0xFD }, 4 },             // zstd
+        { { 'B', 'Z', 'h' }, 3 },                      // bzip2
+        { { 0x04, 0x22, 0x4D, 0x18 }, 4 },             // lz4
+        { { '7', 'z', 0xBC, 0xAF, 0x27, 0x1C }, 6 },   // 7-Zip
+        { { 'P', 'K', 0x03, 0x04 }, 4 },               // ZIP
+        { { 'R', 'a', 'r', '!', 0x1A, 0x07 }, 6 },     // RAR
+        { { 0x1F, 0x9D }, 2 },                         // compress
+        { { 0x5D, 0x00, 0x00 }, 3 },                   // lzma
+    };
+    for (const auto& magic : magics) {
+        if (size >= magic.length && memcmp(data, magic.bytes, magic.length) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Label a sample. Text must be valid UTF-8 with no NULs and at most one control character in
+// twenty (tab, newline, form feed, carriage return and escape do not count). High entropy
+// data is compressed if it starts with a compressor's magic; otherwise it is called
+// encrypted when a chi-square test cannot tell it from uniform noise at about the 0.05%
+// level, and compressed when it can (weaker compressors leave a measurable byte bias).
+inline ContentClass classifyContent(const unsigned char* data, const ContentStats& stats) {
+    if (stats.size == 0)
+        return CONTENT_EMPTY;
+
+    const uint32_t* h = stats.histogram;
+    size_t controls = h[0x7F];
+    for (unsigned c = 0; c < 0x20; c++) {
+        if (c != '\t' && c != '\n' && c != '\f' && c != '\r' && c != 0x1B)
+            controls += h[c];
+    }
+    if (h[0] == 0 && controls * 20 <= stats.size && stats.utf8)
+        return CONTENT_TEXT;
+
+    if (stats.size >= CONTENT_MIN_ENTROPY && stats.entropy >= CONTENT_HIGH_ENTROPY) {
+        if (hasCompressorMagic(data, stats.size))
+            return CONTENT_COMPRESSED;
+        double limit = 255.0 + 3.3 * sqrt(2.0 * 255.0);
+        return stats.chiSquare <= limit ? CONTENT_ENCRYPTED : CONTENT_COMPRESSED;
+    }
+    return CONTENT_BINARY;
+}
+
+inline ContentClass classifyContent(const unsigned char* data, size_t size, bool truncated) {
+    ContentStats stats;
+    measureContent(data, size, truncated, stats);
+    return classifyContent(data, stats);
+}
+
+// Read up to limit bytes from the start of a file into buffer and classify them.
+// Returns CONTENT_NONE if the file cannot be read.
+inline ContentClass classifyFile(const char* path, vector<unsigned char>& buffer, size_t limit) {
+    int error = 0;
+    uint64_t fileSize = 0;
+    int fd = openRegularFile(path, error, fileSize);
+    if (fd < 0)
+        return CONTENT_NONE;
+    buffer.resize(limit);
+    size_t want = static_cast<size_t>(min<uint64_t>(limit, fileSize));
+    size_t size = 0;
+    while (size < want) {
+        ssize_t n = pread(fd, buffer.data() + size, want - size, static_cast<off_t>(size));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0) {
+            ::close(fd);
+            return CONTENT_NONE;
+        }
+        if (n == 0)
+            break;
+        size += static_cast<size_t>(n);
+    }
+    ::close(fd);
+    return classifyContent(buffer.data(), size, size < fileSize);
+}
+
+#endif
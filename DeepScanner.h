@@ -0,0 +1,337 @@
+// Deep scan: find every signature anywhere in a file, for payloads hidden behind a valid header
+#ifndef DEEP_SCANNER_H
+#define DEEP_SCANNER_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "SafeOpen.h"
+#include "Signature.h"
+#include "SignatureTrie.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+const size_t DEEP_SCAN_CHUNK = 1 << 20;  // Bytes read at a time
+const size_t DEEP_SCAN_PADDING = 64;     // Readable slack past the data for whole-vector loads
+const size_t DEEP_SCAN_BUCKETS = 8;      // One bit per bucket in the nibble tables
+const size_t DEEP_SCAN_FINGERPRINT = 4;  // Leading bytes the vector filter compares
+
+// One place a signature occurs. offset is where its bytes were found; for a signature that
+// sits further into its own format (tar's "ustar" at 257) the embedded file starts earlier.
+struct DeepHit {
+    uint64_t offset;
+    uint32_t pattern; // Index into DeepScanner::pattern()
+};
+
+// Multi-pattern matcher in the style of Teddy: patterns are split into eight buckets, and
+// for each of the first few pattern bytes two 16-entry tables map the low and the high
+// nibble of an input byte to the buckets that allow it. One shuffle per table per vector
+// filters 32 (AVX2) or 16 (SSSE3) positions at once; only positions left with a bucket
+// bit are compared against that bucket's patterns. The vector width is picked at run time,
+// with a scalar loop over the same tables everywhere else.
+class DeepScanner {
+public:
+    // Structure for one distinct signature
+    struct Pattern {
+        unsigned char bytes[MAX_SIGNATURE_BYTES];
+        uint32_t length = 0;
+        string extensions;     // Every extension that uses it, comma separated
+    };
+
+private:
+    vector<Pattern> patterns;
+    vector<uint32_t> buckets[DEEP_SCAN_BUCKETS]; // Pattern indices per bucket
+    alignas(32) uint8_t lowNibbles[DEEP_SCAN_FINGERPRINT][32];  // Repeated in both 16-byte lanes
+    alignas(32) uint8_t highNibbles[DEEP_SCAN_FINGERPRINT][32];
+    size_t fingerprint;   // Bytes the filter checks (at most the shortest pattern)
+    size_t longest;       // Longest pattern
+    int vectorWidth;      // 32, 16 or 0 for scalar
+
+    // Utility function: Compare the patterns of the buckets in mask at position, appending hits
+    void verify(const unsigned char* data, size_t size, size_t position, uint8_t mask, uint64_t base,
+                vector<DeepHit>& hits) const
+    {
+        while (mask != 0) {
+            unsigned bucket = static_cast<unsigned>(__builtin_ctz(mask));
+            mask &= static_cast<uint8_t>(mask - 1);
+            for (uint32_t index : buckets[bucket]) {
+                const Pattern& pattern = patterns[index];
+                if (position + pattern.length <= size && memcmp(data + position, pattern.bytes, pattern.length) == 0)
+                    hits.push_back(DeepHit{base + position, index});
+            }
+        }
+    }
+
+    // Utility function: Buckets whose fingerprint allows the bytes at data (scalar filter)
+    uint8_t candidates(const unsigned char* data) const
+    {
+        uint8_t mask = 0xFF;
+        for (size_t j = 0; j < fingerprint; j++)
+            mask &= lowNibbles[j][data[j] & 0x0F] & highNibbles[j][data[j] >> 4];
+        return mask;
+    }
+
+    void scanScalar(const unsigned char* data, size_t size, size_t end, uint64_t base, vector<DeepHit>& hits) const
+    {
+        for (size_t i = 0; i < end; i++) {
+            uint8_t mask = candidates(data + i);
+            if (mask != 0)
+                verify(data, size, i, mask, base, hits);
+        }
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    template <size_t Fingerprint>
+    __attribute__((target("ssse3")))
+    void scanSsse3(const unsigned char* data, size_t size, size_t end, uint64_t base, vector<DeepHit>& hits) const
+    {
+        const __m128i nibble = _mm_set1_epi8(0x0F);
+        const __m128i zero = _mm_setzero_si128();
+        __m128i low[DEEP_SCAN_FINGERPRINT], high[DEEP_SCAN_FINGERPRINT];
+        for (size_t j = 0; j < Fingerprint; j++) {
+            low[j] = _mm_load_si128(reinterpret_cast<const __m128i*>(lowNibbles[j]));
+            high[j] = _mm_load_si128(reinterpret_cast<const __m128i*>(highNibbles[j]));
+        }
+        alignas(16) uint8_t masks[16];
+        for (size_t i = 0; i < end; i += 16) {
+            __m128i result = _mm_set1_epi8(-1);
+            for (size_t j = 0; j < Fingerprint; j++) {
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + j));
+                __m128i lo = _mm_shuffle_epi8(low[j], _mm_and_si128(bytes, nibble));
+                __m128i hi = _mm_shuffle_epi8(high[j], _mm_and_si128(_mm_srli_epi16(bytes, 4), nibble));
+                result = _mm_and_si128(result, _mm_and_si128(lo, hi));
+            }
+            unsigned positions = ~static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(result, zero))) & 0xFFFF;
+            if (positions == 0)
+                continue;
+            _mm_store_si128(reinterpret_cast<__m128i*>(masks), result);
+            for (; positions != 0; positions &= positions - 1) {
+                size_t k = static_cast<size_t>(__builtin_ctz(positions));
+                if (i + k < end)
+                    verify(data, size, i + k, masks[k], base, hits);
+            }
+        }
+    }
+
+    template <size_t Fingerprint>
+    __attribute__((target("avx2")))
+    void scanAvx2(const unsigned char* data, size_t size, size_t end, uint64_t base, vector<DeepHit>& hits) const
+    {
+        const __m256i nibble = _mm256_set1_epi8(0x0F);
+        const __m256i zero = _mm256_setzero_si256();
+        __m256i low[DEEP_SCAN_FINGERPRINT], high[DEEP_SCAN_FINGERPRINT];
+        for (size_t j = 0; j < Fingerprint; j++) {
+            low[j] = _mm256_load_si256(reinterpret_cast<const __m256i*>(lowNibbles[j]));
+            high[j] = _mm256_load_si256(reinterpret_cast<const __m256i*>(highNibbles[j]));
+        }
+        alignas(32) uint8_t masks[32];
+        for (size_t i = 0; i < end; i += 32) {
+            __m256i result = _mm256_set1_epi8(-1);
+            for (size_t j = 0; j < Fingerprint; j++) {
+                __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + j));
+                __m256i lo = _mm256_shuffle_epi8(low[j], _mm256_and_si256(bytes, nibble));
+                __m256i hi = _mm256_shuffle_epi8(high[j], _mm256_and_si256(_mm256_srli_epi16(bytes, 4), nibble));
+                result = _mm256_and_si256(result, _mm256_and_si256(lo, hi));
+            }
+            uint32_t positions = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(result, zero)));
+            if (positions == 0)
+                continue;
+            _mm256_store_si256(reinterpret_cast<__m256i*>(masks), result);
+            for (; positions != 0; positions &= positions - 1) {
+                size_t k = static_cast<size_t>(__builtin_ctz(positions));
+                if (i + k < end)
+                    verify(data, size, i + k, masks[k], base, hits);
+            }
+        }
+    }
+#endif
+
+public:
+    DeepScanner()
+        : fingerprint(0), longest(0), vectorWidth(0)
+    {
+        memset(lowNibbles, 0, sizeof(lowNibbles));
+        memset(highNibbles, 0, sizeof(highNibbles));
+#if defined(__x86_64__) || defined(__i386__)
+        if (__builtin_cpu_supports("avx2"))
+            vectorWidth = 32;
+        else if (__builtin_cpu_supports("ssse3"))
+            vectorWidth = 16;
+#endif
+    }
+
+    // Public function: Take the patterns from every signature in the reverse index that is at
+    // least minLength bytes long. Very short signatures (MZ, BM, ID3) occur by chance every
+    // few kilobytes of ordinary data, so they are left out unless asked for. Signatures with
+    // the same bytes at different offsets (ISO's CD001) become one pattern.
+    void build(const SignatureTrie& reverse, size_t minLength)
+    {
+        patterns.clear();
+        for (vector<uint32_t>& bucket : buckets)
+            bucket.clear();
+        minLength = max<size_t>(minLength, 1);
+
+        reverse.forEachSignature([&](const unsigned char* bytes, size_t length, uint32_t,
+                                     const vector<string>& extensions) {
+            if (length < minLength)
+                return;
+            auto same = find_if(patterns.begin(), patterns.end(), [&](const Pattern& pattern) {
+                return pattern.length == length && memcmp(pattern.bytes, bytes, length) == 0;
+            });
+            if (same == patterns.end()) {
+                patterns.emplace_back();
+                same = patterns.end() - 1;
+                memcpy(same->bytes, bytes, length);
+                same->length = static_cast<uint32_t>(length);
+            }
+            for (const string& extension : extensions) {
+                string listed = "," + same->extensions + ",";
+                if (listed.find("," + extension + ",") == string::npos)
+                    same->extensions += (same->extensions.empty() ? "" : ",") + extension;
+            }
+        });
+
+        // Patterns that share leading bytes go in the same bucket, so they set the same table bits
+        // and stay apart from unrelated ones. A bucket's list is checked only when its bit survives.
+        vector<uint32_t> order(patterns.size());
+        for (uint32_t i = 0; i < order.size(); i++)
+            order[i] = i;
+        sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            // Whole byte ranges, a prefix before the longer pattern, so this is a strict weak order
+            return lexicographical_compare(patterns[a].bytes, patterns[a].bytes + patterns[a].length,
+                                           patterns[b].bytes, patterns[b].bytes + patterns[b].length);
+        });
+
+        fingerprint = DEEP_SCAN_FINGERPRINT;
+        longest = 0;
+        for (const Pattern& pattern : patterns) {
+            fingerprint = min<size_t>(fingerprint, pattern.length);
+            longest = max<size_t>(longest, pattern.length);
+        }
+        memset(lowNibbles, 0, sizeof(lowNibbles));
+        memset(highNibbles, 0, sizeof(highNibbles));
+        for (size_t rank = 0; rank < order.size(); rank++) {
+            size_t bucket = rank * DEEP_SCAN_BUCKETS / order.size();
+            const Pattern& pattern = patterns[order[rank]];
+            buckets[bucket].push_back(order[rank]);
+            for (size_t j = 0; j < fingerprint; j++) {
+                uint8_t byte = pattern.bytes[j];
+                lowNibbles[j][byte & 0x0F] |= static_cast<uint8_t>(1u << bucket);
+                highNibbles[j][byte >> 4] |= static_cast<uint8_t>(1u << bucket);
+            }
+        }
+        for (size_t j = 0; j < DEEP_SCAN_FINGERPRINT; j++) {
+            memcpy(lowNibbles[j] + 16, lowNibbles[j], 16);
+            memcpy(highNibbles[j] + 16, highNibbles[j], 16);
+        }
+    }
+
+    // Public function: Force the scalar or a narrower vector loop (benchmarks, testing)
+    void setVectorWidth(int width)
+    {
+        if (width < vectorWidth)
+            vectorWidth = width;
+    }
+
+    int activeVectorWidth() const { return vectorWidth; }
+
+    size_t patternCount() const { return patterns.size(); }
+
+    const Pattern& pattern(size_t index) const { return patterns[index]; }
+
+    // Public function: Find the patterns starting at positions [0, end) of data, which holds
+    // size valid bytes followed by at least DEEP_SCAN_PADDING readable bytes. base is the
+    // file offset of data[0]. Hits are appended in position order.
+    void scanBuffer(const unsigned char* data, size_t size, size_t end, uint64_t base, vector<DeepHit>& hits) const
+    {
+        if (patterns.empty())
+            return;
+#if defined(__x86_64__) || defined(__i386__)
+        // The fingerprint length is a template argument so the filter loop is fully unrolled
+        if (vectorWidth == 32) {
+            switch (fingerprint) {
+                case 1: return scanAvx2<1>(data, size, end, base, hits);
+                case 2: return scanAvx2<2>(data, size, end, base, hits);
+                case 3: return scanAvx2<3>(data, size, end, base, hits);
+                default: return scanAvx2<DEEP_SCAN_FINGERPRINT>(data, size, end, base, hits);
+            }
+        }
+        if (vectorWidth == 16) {
+            switch (fingerprint) {
+                case 1: return scanSsse3<1>(data, size, end, base, hits);
+                case 2: return scanSsse3<2>(data, size, end, base, hits);
+                case 3: return scanSsse3<3>(data, size, end, base, hits);
+                default: return scanSsse3<DEEP_SCAN_FINGERPRINT>(data, size, end, base, hits);
+            }
+        }
+#endif
+        scanScalar(data, size, end, base, hits);
+    }
+
+    // Public function: Read a whole file in DEEP_SCAN_CHUNK pieces and find every pattern in it.
+    // buffer is reused between calls. Returns 0 or the errno of the failed open or read.
+    int scanFile(const char* path, vector<DeepHit>& hits, vector<unsigned char>& buffer) const
+    {
+        hits.clear();
+        int openError = 0;
+        uint64_t size = 0;
+        int fd = openRegularFile(path, openError, size);
+        if (fd < 0)
+            return openError;
+#ifdef POSIX_FADV_SEQUENTIAL
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+        // A pattern that straddles two chunks is found in the second: the last longest - 1
+        // bytes of each chunk are carried over and scanned with it
+        size_t keep = longest > 0 ? longest - 1 : 0;
+        buffer.resize(keep + DEEP_SCAN_CHUNK + DEEP_SCAN_PADDING);
+        size_t carried = 0;
+        uint64_t base = 0;
+        int error = 0;
+        while (true) {
+            ssize_t n = read(fd, buffer.data() + carried, DEEP_SCAN_CHUNK);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0) {
+                error = errno;
+                break;
+            }
+            size_t size = carried + static_cast<size_t>(n);
+            bool last = n == 0;
+            memset(buffer.data() + size, 0, DEEP_SCAN_PADDING);
+            size_t end = last ? size : (size > keep ? size - keep : 0);
+            scanBuffer(buffer.data(), size, end, base, hits);
+            if (last)
+                break;
+            memmove(buffer.data(), buffer.data() + end, size - end);
+            carried = size - end;
+            base += end;
+        }
+        ::close(fd);
+        return error;
+    }
+};
+
+// Append one line per hit: FOUND<TAB>path<TAB>offset<TAB>extensions
+inline void appendDeepScanLines(string& out, const string& path, const DeepScanner& scanner, const vector<DeepHit>& hits) {
+    for (const DeepHit& hit : hits) {
+        out += "FOUND\t";
+        out += path;
+        out += '\t';
+        out += to_string(hit.offset);
+        out += '\t';
+        out += scanner.pattern(hit.pattern).extensions;
+        out += '\n';
+    }
+}
+
+#endif
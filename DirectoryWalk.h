@@ -0,0 +1,64 @@
+// Recursive directory walk that carries on past directories it cannot read
+#ifndef DIRECTORY_WALK_H
+#define DIRECTORY_WALK_H
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+using namespace std;
+
+// Call visit(entry) for every entry below root, depth first, each directory before what it
+// holds. Symlinks are reported but not followed, and directories that deny access are skipped
+// quietly. Any other error (a directory removed mid-walk, ELOOP, EIO) is reported and costs
+// only the rest of that directory: the walk goes on with the next entry above it.
+// std::filesystem::recursive_directory_iterator cannot do this, since an error ends it.
+template <typename Visit>
+void walkTree(const string& root, Visit visit) {
+    namespace fs = std::filesystem;
+    auto options = fs::directory_options::skip_permission_denied;
+    auto report = [](const fs::path& dir, const error_code& ec) {
+        cerr << "Error walking directory: " << dir.string() << " (" << ec.message() << ")" << endl;
+    };
+
+    error_code ec;
+    vector<fs::directory_iterator> open;
+    vector<fs::path> dirs; // Path of each iterator in open
+    open.emplace_back(root, options, ec);
+    dirs.emplace_back(root);
+    if (ec) {
+        report(root, ec);
+        return;
+    }
+    while (!open.empty()) {
+        if (open.back() == fs::directory_iterator()) {
+            open.pop_back();
+            dirs.pop_back();
+            continue;
+        }
+        const fs::directory_entry& entry = *open.back();
+        visit(entry);
+        error_code statusError;
+        bool descend = entry.is_directory(statusError) && !entry.is_symlink(statusError);
+        fs::path path = entry.path();
+
+        open.back().increment(ec);
+        if (ec) {
+            report(dirs.back(), ec);
+            open.back() = fs::directory_iterator();
+        }
+        if (descend) {
+            fs::directory_iterator below(path, options, ec);
+            if (ec) {
+                report(path, ec);
+            } else {
+                open.push_back(move(below));
+                dirs.push_back(move(path));
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,371 @@
+// Watch mode: hear about files as their writers close them, and hand them to the checkers in batches
+#ifndef DIRECTORY_WATCHER_H
+#define DIRECTORY_WATCHER_H
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/fanotify.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include "BoundedQueue.h"
+#include "DirectoryWalk.h"
+
+using namespace std;
+
+// Where events come from. fanotify marks whole mounts, so it needs no per-directory watches
+// however many files there are, but it needs CAP_SYS_ADMIN. inotify works for anyone and
+// watches every directory of the trees (see /proc/sys/fs/inotify/max_user_watches).
+enum WatchBackend { WATCH_AUTO, WATCH_FANOTIFY, WATCH_INOTIFY };
+
+inline const char* watchBackendName(WatchBackend backend) {
+    return backend == WATCH_FANOTIFY ? "fanotify" : backend == WATCH_INOTIFY ? "inotify" : "auto";
+}
+
+// Settings for a watch
+struct WatchOptions {
+    WatchBackend backend = WATCH_AUTO;
+    unsigned debounceMs = 20; // A file is checked once it has been quiet this long
+    size_t backlog = 65536;   // Most files waiting to be checked; events past it are dropped
+};
+
+// What a watch saw
+struct WatchStats {
+    size_t events = 0;      // Close-after-write (and moved-in) events for files in the trees
+    size_t handedOver = 0;  // Files passed on to be checked
+    size_t coalesced = 0;   // Events for a file that was already waiting
+    size_t dropped = 0;     // Events lost to a full backlog
+    size_t overflows = 0;   // Times the kernel's own queue overflowed and events were lost
+    size_t directories = 0; // Directories watched (inotify)
+};
+
+// Turns close-after-write events under a set of directory trees into batches of paths.
+// Events are debounced: a path is held until no event has come for it for debounceMs, so
+// a file written and closed many times in a row is checked once. Waiting paths are kept
+// in arrival order, up to the backlog; when the checkers fall behind, batches stay here
+// (nothing blocks the event loop, so the kernel queue keeps draining) and new paths
+// beyond the backlog are counted as dropped.
+class DirectoryWatcher {
+private:
+    struct Waiting {
+        string path;
+        uint64_t due; // When it was due as of being queued
+    };
+
+    WatchOptions settings;
+    WatchBackend active = WATCH_AUTO;
+    int notifyFd = -1;
+    int stopPipe[2] = { -1, -1 };
+    vector<string> roots;                     // As given, without a trailing slash
+    vector<string> realRoots;                 // Resolved, for matching fanotify's absolute paths
+    unordered_map<int, string> directories;   // inotify watch descriptor -> directory
+    unordered_map<string, uint64_t> dueTimes; // Waiting path -> when it may be checked
+    deque<Waiting> order;                     // Waiting paths, oldest first
+    vector<string> ready;                     // A batch the queue had no room for yet
+    WatchStats counters;
+    bool watchLimitWarned = false;
+
+    static uint64_t nowMs()
+    {
+        return static_cast<uint64_t>(
+            chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // Utility function: Remember an event for path
+    void note(const string& path)
+    {
+        counters.events++;
+        uint64_t due = nowMs() + settings.debounceMs;
+        auto it = dueTimes.find(path);
+        if (it != dueTimes.end()) {
+            it->second = due;
+            counters.coalesced++;
+            return;
+        }
+        if (dueTimes.size() + ready.size() >= settings.backlog) {
+            counters.dropped++;
+            return;
+        }
+        dueTimes.emplace(path, due);
+        order.push_back({ path, due });
+    }
+
+    // Utility function: Watch dir and every directory below it. With existing set, the files
+    // already there are noted too: they may have been written before the watch was in place.
+    void addTree(const string& dir, bool existing)
+    {
+        namespace fs = std::filesystem;
+        addDirectory(dir);
+        walkTree(dir, [&](const fs::directory_entry& entry) {
+            error_code ec;
+            if (entry.is_directory(ec) && !entry.is_symlink(ec))
+                addDirectory(entry.path().string());
+            else if (existing && fs::is_regular_file(entry.symlink_status(ec)))
+                note(entry.path().string());
+        });
+    }
+
+    // Utility function: Watch one directory (inotify)
+    void addDirectory(const string& dir)
+    {
+        uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+        int wd = inotify_add_watch(notifyFd, dir.c_str(), mask);
+        if (wd < 0) {
+            if (errno == ENOSPC && !watchLimitWarned) {
+                cerr << "Warning: out of inotify watches at " << dir
+                     << " (raise /proc/sys/fs/inotify/max_user_watches, or run with CAP_SYS_ADMIN for fanotify)" << endl;
+                watchLimitWarned = true;
+            }
+            return;
+        }
+        // A directory moved within the trees keeps its descriptor; only its path changes
+        if (directories.insert_or_assign(wd, dir).second)
+            counters.directories++;
+    }
+
+    // Utility function: Drain the inotify queue
+    void readInotify()
+    {
+        alignas(inotify_event) char buffer[64 * 1024];
+        while (true) {
+            ssize_t n = read(notifyFd, buffer, sizeof(buffer));
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return;
+            for (char* p = buffer; p < buffer + n;) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+                p += sizeof(inotify_event) + event->len;
+                if (event->mask & IN_Q_OVERFLOW) {
+                    counters.overflows++;
+                    continue;
+                }
+                if (event->mask & IN_IGNORED) {
+                    if (directories.erase(event->wd) > 0)
+                        counters.directories--;
+                    continue;
+                }
+                auto dir = directories.find(event->wd);
+                if (dir == directories.end() || event->len == 0)
+                    continue;
+                string path = dir->second + "/" + event->name;
+                if (event->mask & IN_ISDIR) {
+                    if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                        addTree(path, true);
+                } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                    note(path);
+                }
+            }
+        }
+    }
+
+    // Utility function: Map an absolute path from fanotify back under the root it was given as.
+    // Returns false for paths outside every tree (fanotify reports the whole mount).
+    bool underRoot(const string& absolute, string& path) const
+    {
+        for (size_t r = 0; r < realRoots.size(); r++) {
+            const string& real = realRoots[r];
+            if (absolute.compare(0, real.size(), real) == 0
+                && (real == "/" || absolute.size() == real.size() || absolute[real.size()] == '/')) {
+                path = (roots[r] == "/" ? string() : roots[r]) + absolute.substr(real == "/" ? 0 : real.size());
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Utility function: Drain the fanotify queue
+    void readFanotify()
+    {
+        alignas(fanotify_event_metadata) char buffer[64 * 1024];
+        char link[64];
+        char target[PATH_MAX];
+        string path;
+        while (true) {
+            ssize_t n = read(notifyFd, buffer, sizeof(buffer));
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return;
+            const fanotify_event_metadata* event = reinterpret_cast<const fanotify_event_metadata*>(buffer);
+            for (; FAN_EVENT_OK(event, n); event = FAN_EVENT_NEXT(event, n)) {
+                if (event->vers != FANOTIFY_METADATA_VERSION)
+                    continue;
+                if (event->mask & FAN_Q_OVERFLOW) {
+                    counters.overflows++;
+                    continue;
+                }
+                if (event->fd < 0)
+                    continue;
+                snprintf(link, sizeof(link), "/proc/self/fd/%d", event->fd);
+                ssize_t length = readlink(link, target, sizeof(target) - 1);
+                close(event->fd);
+                if (length <= 0)
+                    continue;
+                if (underRoot(string(target, static_cast<size_t>(length)), path))
+                    note(path);
+            }
+        }
+    }
+
+    // Utility function: Move the paths that are due into batches and offer them to the queue.
+    // Returns how long until the next one is due, or -1 if nothing is waiting.
+    int handOver(BoundedQueue<vector<string>>& batches, size_t batchSize, bool flushAll)
+    {
+        uint64_t now = nowMs();
+        while (true) {
+            if (!ready.empty()) {
+                size_t count = ready.size();
+                if (!batches.tryPush(ready))
+                    return 1; // Checkers are busy; try again shortly
+                counters.handedOver += count;
+                ready.clear();
+            }
+            size_t requeued = 0;
+            while (!order.empty() && ready.size() < batchSize) {
+                Waiting& front = order.front();
+                uint64_t due = dueTimes[front.path];
+                if (due != front.due && requeued++ < order.size()) {
+                    // Written again since it was queued: wait out the new quiet period at the back
+                    order.push_back({ move(front.path), due });
+                    order.pop_front();
+                    continue;
+                }
+                if (due > now && !flushAll)
+                    break;
+                dueTimes.erase(front.path);
+                ready.push_back(move(front.path));
+                order.pop_front();
+            }
+            if (ready.empty())
+                break;
+        }
+        if (order.empty())
+            return -1;
+        uint64_t next = order.front().due;
+        return next > now ? static_cast<int>(next - now) : 0;
+    }
+
+public:
+    DirectoryWatcher() = default;
+    DirectoryWatcher(const DirectoryWatcher&) = delete;
+    DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+    ~DirectoryWatcher()
+    {
+        if (notifyFd >= 0)
+            close(notifyFd);
+        for (int fd : stopPipe) {
+            if (fd >= 0)
+                close(fd);
+        }
+    }
+
+    // Public function: Start watching the trees. Returns false with error set if they cannot be watched.
+    bool start(const vector<string>& trees, const WatchOptions& options, string& error)
+    {
+        settings = options;
+        if (settings.backlog == 0)
+            settings.backlog = 1;
+        if (pipe2(stopPipe, O_CLOEXEC | O_NONBLOCK) < 0) {
+            error = string("Error creating pipe: ") + strerror(errno);
+            return false;
+        }
+        for (const string& tree : trees) {
+            string root = tree;
+            while (root.size() > 1 && root.back() == '/')
+                root.pop_back();
+            char resolved[PATH_MAX];
+            if (realpath(root.c_str(), resolved) == nullptr || !std::filesystem::is_directory(resolved)) {
+                error = "Not a directory: " + tree;
+                return false;
+            }
+            roots.push_back(root);
+            realRoots.push_back(resolved);
+        }
+
+        if (settings.backend != WATCH_INOTIFY) {
+            notifyFd = fanotify_init(FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK, O_RDONLY | O_LARGEFILE | O_CLOEXEC);
+            bool marked = notifyFd >= 0;
+            for (size_t r = 0; marked && r < realRoots.size(); r++) {
+                marked = fanotify_mark(notifyFd, FAN_MARK_ADD | FAN_MARK_MOUNT, FAN_CLOSE_WRITE, AT_FDCWD,
+                                       realRoots[r].c_str()) == 0;
+            }
+            if (marked) {
+                active = WATCH_FANOTIFY;
+                return true;
+            }
+            int reason = errno;
+            if (notifyFd >= 0) {
+                close(notifyFd);
+                notifyFd = -1;
+            }
+            if (settings.backend == WATCH_FANOTIFY) {
+                error = string("Error setting up fanotify: ") + strerror(reason);
+                return false;
+            }
+        }
+
+        notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (notifyFd < 0) {
+            error = string("Error setting up inotify: ") + strerror(errno);
+            return false;
+        }
+        active = WATCH_INOTIFY;
+        for (const string& root : roots)
+            addTree(root, false);
+        return true;
+    }
+
+    // Public function: Run the event loop, pushing batches of at most batchSize paths onto
+    // batches until stop() (or a write to stopDescriptor()). Paths still waiting are then
+    // handed over, done is set and the consumers are woken to see it.
+    void run(BoundedQueue<vector<string>>& batches, size_t batchSize, atomic<bool>& done)
+    {
+        int timeout = -1;
+        while (true) {
+            pollfd fds[2] = { { notifyFd, POLLIN, 0 }, { stopPipe[0], POLLIN, 0 } };
+            int n = poll(fds, 2, timeout);
+            if (n < 0 && errno != EINTR)
+                break;
+            if (n > 0 && (fds[1].revents & POLLIN))
+                break;
+            if (n > 0 && (fds[0].revents & POLLIN)) {
+                if (active == WATCH_FANOTIFY)
+                    readFanotify();
+                else
+                    readInotify();
+            }
+            timeout = handOver(batches, batchSize, false);
+        }
+        while (handOver(batches, batchSize, true) != -1 || !ready.empty())
+            this_thread::sleep_for(chrono::milliseconds(1));
+        done.store(true, memory_order_release);
+        batches.wakeConsumers();
+    }
+
+    // Public function: Ask run() to finish. Safe from a signal handler through stopDescriptor().
+    void stop()
+    {
+        char byte = 0;
+        ssize_t ignored = write(stopPipe[1], &byte, 1);
+        (void)ignored;
+    }
+
+    int stopDescriptor() const { return stopPipe[1]; }
+    WatchBackend backend() const { return active; }
+    const WatchStats& stats() const { return counters; }
+};
+
+#endif
@@ -0,0 +1,371 @@
+// Signature index compiled into the program: constexpr tables with a minimal perfect hash
+#ifndef EMBEDDED_INDEX_H
+#define EMBEDDED_INDEX_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "ExtensionResolver.h"
+#include "FileUtils.h"
+
+using namespace std;
+
+// One extension of an embedded table
+struct EmbeddedExtension {
+    const char* name;
+    uint32_t nameLength;
+    uint32_t first;     // Index of its first signature
+    uint32_t count;     // Number of signatures
+    uint32_t maxLength; // Longest offset 0 signature, in bytes
+};
+
+// Everything an embedded index needs, all of it constexpr data written by generateEmbeddedTable.
+// extensions[i] is the extension the perfect hash sends to slot i. order lists the signatures
+// as they appeared in the CSV, so the reverse index reports shared signatures the same way
+// as one loaded from the file. The resolver arrays are the extension suffix trie, laid out
+// by ExtensionResolver::flatten with extension slots as name numbers.
+struct EmbeddedSignatureTable {
+    const uint32_t* displacements; // Per bucket: seed of the second hash
+    uint32_t bucketCount;
+    const EmbeddedExtension* extensions;
+    uint32_t extensionCount;
+    const ByteSignature* signatures; // Grouped by extension
+    const uint32_t* owners;          // Extension slot of each signature
+    const uint32_t* order;           // Signature indices in CSV order
+    uint32_t signatureCount;
+    const uint32_t* resolverRoot;    // 256 children of the trie's root
+    const ResolverNode* resolverNodes;
+    const ResolverEdge* resolverEdges;
+    uint32_t resolverNodeCount;
+};
+
+// Seeded FNV-1a followed by a murmur-style finalizer, usable at compile time
+constexpr uint32_t embeddedHash(const char* key, size_t length, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ (seed * 0x9E3779B9u);
+    for (size_t i = 0; i < length; i++) {
+        hash ^= static_cast<unsigned char>(key[i]);
+        hash *= 16777619u;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x7FEB352Du;
+    hash ^= hash >> 15;
+    hash *= 0x846CA68Bu;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+// Fill in head and mask the way parseSignature does, from length and bytes, at compile time
+constexpr ByteSignature embeddedSignature(ByteSignature signature) {
+    signature.head = 0;
+    signature.mask = 0;
+    for (uint32_t i = 0; i < sizeof(signature.head); i++) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        uint32_t shift = 8 * (sizeof(signature.head) - 1 - i);
+#else
+        uint32_t shift = 8 * i;
+#endif
+        if (i < signature.length) {
+            signature.head |= static_cast<uint64_t>(signature.bytes[i]) << shift;
+            signature.mask |= uint64_t(0xFF) << shift;
+        }
+    }
+    return signature;
+}
+
+// Names for the embedded resolver: a name number is an extension slot
+template <const EmbeddedSignatureTable& Table>
+struct EmbeddedExtensionNames {
+    string_view operator()(uint32_t name) const { return string_view(Table.extensions[name].name, Table.extensions[name].nameLength); }
+};
+
+// Index over an embedded table, selected by template argument so it holds no state at all:
+// there is nothing to load, nothing on the heap, and a lookup is two hashes, one table read
+// and one key comparison, with no probing. Paths are resolved on the generated trie arrays.
+template <const EmbeddedSignatureTable& Table>
+class EmbeddedSignatureIndex {
+public:
+    // Public function: The extension for a name, or nullptr
+    static constexpr const EmbeddedExtension* find(const char* name, size_t length)
+    {
+        if (Table.extensionCount == 0)
+            return nullptr;
+        uint32_t bucket = embeddedHash(name, length, 0) % Table.bucketCount;
+        uint32_t slot = embeddedHash(name, length, Table.displacements[bucket]) % Table.extensionCount;
+        const EmbeddedExtension& candidate = Table.extensions[slot];
+        if (candidate.nameLength != length)
+            return nullptr;
+        for (size_t i = 0; i < length; i++) {
+            if (candidate.name[i] != name[i])
+                return nullptr;
+        }
+        return &candidate;
+    }
+
+    // Public function: Find the signatures for an extension as a view into the table
+    bool lookup(const string& extension, SignatureSpan& span) const
+    {
+        const EmbeddedExtension* found = find(extension.data(), extension.size());
+        if (found == nullptr) {
+            span = SignatureSpan();
+            return false;
+        }
+        span.data = Table.signatures + found->first;
+        span.size = found->count;
+        span.maxLength = found->maxLength;
+        return true;
+    }
+
+    // Public function: Fill the reverse index with every embedded signature
+    void buildReverseIndex(SignatureTrie& reverse) const
+    {
+        for (uint32_t i = 0; i < Table.signatureCount; i++) {
+            const ByteSignature& sig = Table.signatures[Table.order[i]];
+            const EmbeddedExtension& extension = Table.extensions[Table.owners[Table.order[i]]];
+            reverse.insert(sig.bytes, sig.length, sig.offset, string(extension.name, extension.nameLength));
+        }
+    }
+
+    // Public function: FNV-1a over the table contents, standing in for a database file's
+    // fingerprint (e.g. for the result cache)
+    uint64_t fingerprint() const
+    {
+        uint64_t hash = 14695981039346656037ull;
+        auto mix = [&hash](const void* data, size_t size) {
+            const unsigned char* bytes = static_cast<const unsigned char*>(data);
+            for (size_t i = 0; i < size; i++) {
+                hash ^= bytes[i];
+                hash *= 1099511628211ull;
+            }
+        };
+        for (uint32_t i = 0; i < Table.signatureCount; i++) {
+            const ByteSignature& sig = Table.signatures[Table.order[i]];
+            const EmbeddedExtension& extension = Table.extensions[Table.owners[Table.order[i]]];
+            mix(extension.name, extension.nameLength);
+            mix(&sig.offset, sizeof(sig.offset));
+            mix(sig.bytes, sig.length);
+        }
+        return hash;
+    }
+
+    // Public function: Resolves a path to the longest table extension it ends with
+    FlatExtensionResolver<EmbeddedExtensionNames<Table>> extensionResolver() const
+    {
+        return FlatExtensionResolver<EmbeddedExtensionNames<Table>>(Table.resolverRoot, Table.resolverNodes, Table.resolverEdges,
+                                                                    Table.resolverNodeCount, EmbeddedExtensionNames<Table>());
+    }
+
+    // Public function: Number of extensions and signatures
+    size_t extensionCount() const { return Table.extensionCount; }
+    size_t signatureCount() const { return Table.signatureCount; }
+};
+
+// Index lookup for an embedded table, see lookupSignatures for the tree
+template <const EmbeddedSignatureTable& Table>
+bool lookupSignatures(const EmbeddedSignatureIndex<Table>& index, const string& extension, SignatureSpan& span) {
+    return index.lookup(extension, span);
+}
+
+// Build the perfect hash: extensions go into about n/4 buckets by a first hash; buckets are
+// placed largest first, each trying seeds for a second hash until all its extensions land in
+// free slots. slots receives, for each slot, the index of the extension placed there.
+// Returns false only if no seed works, which for distinct names does not happen in practice.
+inline bool buildPerfectHash(const vector<string>& names, vector<uint32_t>& displacements, vector<uint32_t>& slots) {
+    size_t n = names.size();
+    size_t bucketCount = max<size_t>(1, (n + 3) / 4);
+    vector<vector<uint32_t>> buckets(bucketCount);
+    for (uint32_t i = 0; i < n; i++)
+        buckets[embeddedHash(names[i].data(), names[i].size(), 0) % bucketCount].push_back(i);
+
+    vector<uint32_t> order(bucketCount);
+    for (uint32_t b = 0; b < bucketCount; b++)
+        order[b] = b;
+    stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return buckets[a].size() > buckets[b].size(); });
+
+    displacements.assign(bucketCount, 0);
+    slots.assign(n, UINT32_MAX);
+    vector<uint32_t> tried;
+    for (uint32_t b : order) {
+        if (buckets[b].empty())
+            break;
+        bool placed = false;
+        for (uint32_t seed = 1; seed < (1u << 24) && !placed; seed++) {
+            tried.clear();
+            placed = true;
+            for (uint32_t key : buckets[b]) {
+                uint32_t slot = embeddedHash(names[key].data(), names[key].size(), seed) % n;
+                if (slots[slot] != UINT32_MAX || find(tried.begin(), tried.end(), slot) != tried.end()) {
+                    placed = false;
+                    break;
+                }
+                tried.push_back(slot);
+            }
+            if (placed) {
+                for (size_t k = 0; k < tried.size(); k++)
+                    slots[tried[k]] = buckets[b][k];
+                displacements[b] = seed;
+            }
+        }
+        if (!placed)
+            return false;
+    }
+    return true;
+}
+
+// Turn a CSV database into a C++ header defining `constexpr EmbeddedSignatureTable name`.
+// Build the checker with that header included to use it as EmbeddedSignatureIndex<name>.
+inline bool generateEmbeddedTable(const string& csvPath, const string& headerPath, const string& name, string& error) {
+    ifstream csv(csvPath);
+    if (!csv) {
+        error = "Error opening file: " + csvPath;
+        return false;
+    }
+
+    // Group by extension in order of first appearance, keeping file order and dropping duplicates
+    vector<string> names;
+    vector<vector<ByteSignature>> groups;
+    vector<pair<uint32_t, uint32_t>> rows; // (group, position in group) in file order
+    string line;
+    string extension;
+    ByteSignature signature;
+    while (getline(csv, line)) {
+        if (!parseSignatureLine(line, extension, signature)) {
+            if (!trim(line).empty())
+                cerr << "Invalid line format: " << line << endl;
+            continue;
+        }
+        size_t group = find(names.begin(), names.end(), extension) - names.begin();
+        if (group == names.size()) {
+            names.push_back(extension);
+            groups.emplace_back();
+        }
+        if (find(groups[group].begin(), groups[group].end(), signature) == groups[group].end()) {
+            rows.emplace_back(static_cast<uint32_t>(group), static_cast<uint32_t>(groups[group].size()));
+            groups[group].push_back(signature);
+        }
+    }
+
+    vector<uint32_t> displacements;
+    vector<uint32_t> slots;
+    if (!buildPerfectHash(names, displacements, slots)) {
+        error = "Could not build a perfect hash for " + csvPath;
+        return false;
+    }
+
+    ostringstream out;
+    string guard = "EMBEDDED_TABLE_" + name + "_H";
+    transform(guard.begin(), guard.end(), guard.begin(), [](unsigned char c) { return isalnum(c) ? toupper(c) : '_'; });
+    out << "// Generated from " << csvPath << " by FileChecker --embed-db; do not edit\n"
+        << "#ifndef " << guard << "\n#define " << guard << "\n\n#include \"EmbeddedIndex.h\"\n\n";
+
+    out << "constexpr uint32_t " << name << "_DISPLACEMENTS[] = {";
+    for (size_t b = 0; b < displacements.size(); b++)
+        out << (b % 12 == 0 ? "\n    " : " ") << displacements[b] << ",";
+    out << "\n};\n\n";
+
+    out << "constexpr ByteSignature " << name << "_SIGNATURES[] = {\n";
+    vector<uint32_t> first(names.size());
+    uint32_t signatureCount = 0;
+    for (uint32_t group : slots) {
+        first[group] = signatureCount;
+        for (const ByteSignature& sig : groups[group]) {
+            out << "    embeddedSignature({ 0, 0, " << sig.length << ", " << sig.offset << ", {";
+            for (uint32_t i = 0; i < sig.length; i++) {
+                char hex[8];
+                snprintf(hex, sizeof(hex), "%s0x%02X", i == 0 ? " " : ", ", sig.bytes[i]);
+                out << hex;
+            }
+            out << " } }), // " << names[group] << "\n";
+            signatureCount++;
+        }
+    }
+    if (signatureCount == 0)
+        out << "    ByteSignature(),\n";
+    out << "};\n\n";
+
+    // slots maps slot to group; owners needs the reverse
+    vector<uint32_t> slotOf(names.size());
+    for (uint32_t slot = 0; slot < slots.size(); slot++)
+        slotOf[slots[slot]] = slot;
+    out << "constexpr uint32_t " << name << "_OWNERS[] = {";
+    uint32_t column = 0;
+    for (uint32_t group : slots) {
+        for (size_t k = 0; k < groups[group].size(); k++)
+            out << (column++ % 16 == 0 ? "\n    " : " ") << slotOf[group] << ",";
+    }
+    out << (signatureCount == 0 ? "\n    0,\n};\n\n" : "\n};\n\n");
+    out << "constexpr uint32_t " << name << "_ORDER[] = {";
+    column = 0;
+    for (const pair<uint32_t, uint32_t>& row : rows)
+        out << (column++ % 16 == 0 ? "\n    " : " ") << first[row.first] + row.second << ",";
+    out << (signatureCount == 0 ? "\n    0,\n};\n\n" : "\n};\n\n");
+
+    out << "constexpr EmbeddedExtension " << name << "_EXTENSIONS[] = {\n";
+    for (uint32_t group : slots) {
+        uint32_t maxLength = 0;
+        for (const ByteSignature& sig : groups[group]) {
+            if (sig.offset == 0)
+                maxLength = max(maxLength, sig.length);
+        }
+        string literal;
+        for (char c : names[group]) {
+            if (c == '"' || c == '\\')
+                literal += '\\';
+            literal += c;
+        }
+        out << "    { \"" << literal << "\", " << names[group].size() << ", " << first[group] << ", "
+            << groups[group].size() << ", " << maxLength << " },\n";
+    }
+    if (slots.empty())
+        out << "    { \"\", 0, 0, 0, 0 },\n";
+    out << "};\n\n";
+
+    // The suffix trie, in CSV order as a tree loaded from the file would add the extensions
+    ExtensionResolver resolver;
+    for (const string& extensionName : names)
+        resolver.add(extensionName);
+    uint32_t root[256];
+    vector<ResolverNode> nodes;
+    vector<ResolverEdge> edges;
+    resolver.flatten([&](const string& extensionName) { return slotOf[find(names.begin(), names.end(), extensionName) - names.begin()]; },
+                     root, nodes, edges);
+    auto number = [](uint32_t value) { return value == RESOLVER_NONE ? string("RESOLVER_NONE") : to_string(value); };
+    out << "constexpr uint32_t " << name << "_RESOLVER_ROOT[256] = {";
+    for (size_t b = 0; b < 256; b++)
+        out << (b % 8 == 0 ? "\n    " : " ") << number(root[b]) << ",";
+    out << "\n};\n\n";
+    out << "constexpr ResolverNode " << name << "_RESOLVER_NODES[] = {";
+    for (size_t i = 0; i < nodes.size(); i++)
+        out << (i % 4 == 0 ? "\n    " : " ") << "{ " << nodes[i].firstEdge << ", " << nodes[i].edgeCount << ", "
+            << number(nodes[i].name) << " },";
+    out << "\n};\n\n";
+    out << "constexpr ResolverEdge " << name << "_RESOLVER_EDGES[] = {";
+    for (size_t i = 0; i < edges.size(); i++)
+        out << (i % 6 == 0 ? "\n    " : " ") << "{ " << unsigned(edges[i].byte) << ", {}, " << edges[i].next << " },";
+    out << (edges.empty() ? "\n    { 0, {}, 0 },\n};\n\n" : "\n};\n\n");
+
+    out << "constexpr EmbeddedSignatureTable " << name << " = {\n"
+        << "    " << name << "_DISPLACEMENTS, " << displacements.size() << ",\n"
+        << "    " << name << "_EXTENSIONS, " << slots.size() << ",\n"
+        << "    " << name << "_SIGNATURES, " << name << "_OWNERS, " << name << "_ORDER, " << signatureCount << ",\n"
+        << "    " << name << "_RESOLVER_ROOT, " << name << "_RESOLVER_NODES, " << name << "_RESOLVER_EDGES, " << nodes.size() << ",\n"
+        << "};\n\n#endif\n";
+
+    ofstream header(headerPath, ios::trunc);
+    header << out.str();
+    if (!header) {
+        error = "Error writing " + headerPath;
+        return false;
+    }
+    return true;
+}
+
+#endif
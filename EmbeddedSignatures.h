@@ -0,0 +1,305 @@
+// Generated from FileSignature.txt by FileChecker --embed-db; do not edit
+#ifndef EMBEDDED_TABLE_EMBEDDED_SIGNATURES_H
+#define EMBEDDED_TABLE_EMBEDDED_SIGNATURES_H
+
+#include "EmbeddedIndex.h"
+
+constexpr uint32_t EMBEDDED_SIGNATURES_DISPLACEMENTS[] = {
+    45, 6, 19, 9, 27, 44, 1, 5, 1, 13, 190, 149,
+    984, 30, 20, 104,
+};
+
+constexpr ByteSignature EMBEDDED_SIGNATURES_SIGNATURES[] = {
+    embeddedSignature({ 0, 0, 2, 0, { 0x4D, 0x5A } }), // cpl
+    embeddedSignature({ 0, 0, 4, 0, { 0x47, 0x49, 0x46, 0x38 } }), // gif
+    embeddedSignature({ 0, 0, 8, 0, { 0xD0, 0xCF, 0x11, 0xE0, 0xA1, 0xB1, 0x1A, 0xE1 } }), // doc
+    embeddedSignature({ 0, 0, 4, 0, { 0x50, 0x4B, 0x03, 0x04 } }), // docx
+    embeddedSignature({ 0, 0, 4, 0, { 0x50, 0x4B, 0x05, 0x06 } }), // docx
+    embeddedSignature({ 0, 0, 4, 0, { 0x50, 0x4B, 0x07, 0x08 } }), // docx
+    embeddedSignature({ 0, 0, 4, 0, { 0x53, 0x4D, 0x53, 0x4E } }), // ssp
+    embeddedSignature({ 0, 0, 5, 257, { 0x75, 0x73, 0x74, 0x61, 0x72 } }), // tar
+    embeddedSignature({ 0, 0, 4, 0, { 0x50, 0x4B, 0x03, 0x04 } }), // xlsx
+    embeddedSignature({ 0, 0, 4, 0, { 0x50, 0x4B, 0x05, 0x06 } }), // xlsx
+    embeddedSignature({ 0, 0, 4, 0, { 0x50, 0x4B, 0x07, 0x08 } }), // xlsx
+    embeddedSignature({ 0, 0, 4, 0, { 0x50, 0x57, 0x53, 0x33 } }), // psafe3
+    embeddedSignature({ 0, 0, 6, 0, { 0xFD, 0x37, 0x7A, 0x58, 0x5A, 0x00 } }), // tar.xz
+    embeddedSignature({ 0, 0, 2, 0, { 0x4D, 0x5A } }), // rs
+    embeddedSignature({ 0, 0, 4, 0, { 0xFF, 0xD8, 0xFF, 0xDB } }), // jpeg
+    embeddedSignature({ 0, 0, 4, 0, { 0xFF, 0xD8, 0xFF, 0xE0 } }), // jpeg
+    embeddedSignature({ 0, 0, 4, 0, { 0xFF, 0xD8, 0xFF, 0xEE } }), // jpeg
+    embeddedSignature({ 0, 0, 4, 0, { 0xFF, 0xD8, 0xFF, 0xE1 } }), // jpeg
+    embeddedSignature({ 0, 0, 2, 0, { 0x4D, 0x5A } }), // exe
+    embeddedSignature({ 0, 0, 2, 0, { 0x5A, 0x4D } }), // exe
+    embeddedSignature({ 0, 0, 5, 0, { 0x00, 0x00, 0x1A, 0x00, 0x02 } }), // wk4
+    embeddedSignature({ 0, 0, 8, 0, { 0xD0, 0xCF, 0x11, 0xE0, 0xA1, 0xB1, 0x1A, 0xE1 } }), // ppt
+    embeddedSignature({ 0, 0, 2, 0, { 0x4D, 0x5A } }), // ime
+    embeddedSignature({ 0, 0, 2, 0, { 0x4D, 0x5A } }), // ocx
+    embeddedSignature({ 0, 0, 4, 0, { 0x52, 0x49, 0x46, 0x46 } }), // wav
+    embeddedSignature({ 0, 0, 8, 4, { 0x66, 0x74, 0x79, 0x70, 0x69, 0x73, 0x6F, 0x6D } }), // mp4
+    embeddedSignature({ 0, 0, 8, 4, { 0x66, 0x74, 0x79, 0x70, 0x4D, 0x53, 0x4E, 0x56 } }), // mp4
+    embeddedSignature({ 0, 0, 8, 0, { 0xD0, 0xCF, 0x11, 0xE0, 0xA1, 0xB1, 0x1A, 0xE1 } }), // msg
+    embeddedSignature({ 0, 0, 2, 0, { 0x4D, 0x5A } }), // iec
+    embeddedSignature({ 0, 0, 4, 0, { 0xED, 0xAB, 0xEE, 0xDB } }), // rpm
+    embeddedSignature({ 0, 0, 4, 0, { 0x30, 0x26, 0xB2, 0x75 } }), // wmv
+    embeddedSignature({ 0, 0, 4, 0, { 0x50, 0x4B, 0x03, 0x04 } }), // jar
+    embeddedSignature({ 0, 0, 4, 0, { 0x50, 0x4B, 0x05, 0x06 } }), // jar
+    embeddedSignature({ 0, 0, 4, 0, { 0x50, 0x4B, 0x07, 0x08 } }), // jar
+    embeddedSignature({ 0, 0, 4, 0, { 0x6B, 0x6F, 0x6C, 0x79 } }), // dmg
+    embeddedSignature({ 0, 0, 6, 0, { 0x01, 0xFF, 0x02, 0x04, 0x03, 0x02 } }), // drw
+    embeddedSignature({ 0, 0, 6, 0, { 0xFD, 0x37, 0x7A, 0x58, 0x5A, 0x00 } }), // xz
+    embeddedSignature({ 0, 0, 4, 0, { 0xFF, 0xD8, 0xFF, 0xDB } }), // jpg
+    embeddedSignature({ 0, 0, 4, 0, { 0xFF, 0xD8, 0xFF, 0xE0 } }), // jpg
+    embeddedSignature({ 0, 0, 4, 0, { 0xFF, 0xD8, 0xFF, 0xEE } }), // jpg
+    embeddedSignature({ 0, 0, 4, 0, { 0xFF, 0xD8, 0xFF, 0xE1 } }), // jpg
+    embeddedSignature({ 0, 0, 4, 0, { 0x50, 0x4B, 0x03, 0x04 } }), // zip
+    embeddedSignature({ 0, 0, 4, 0, { 0x50, 0x4B, 0x05, 0x06 } }), // zip
+    embeddedSignature({ 0, 0, 4, 0, { 0x50, 0x4B, 0x07, 0x08 } }), // zip
+    embeddedSignature({ 0, 0, 8, 0, { 0xD0, 0xCF, 0x11, 0xE0, 0xA1, 0xB1, 0x1A, 0xE1 } }), // xls
+    embeddedSignature({ 0, 0, 6, 0, { 0x37, 0x7A, 0xBC, 0xAF, 0x27, 0x1C } }), // 7z
+    embeddedSignature({ 0, 0, 6, 0, { 0x52, 0x61, 0x72, 0x21, 0x1A, 0x07 } }), // rar
+    embeddedSignature({ 0, 0, 2, 0, { 0x4D, 0x5A } }), // tsp
+    embeddedSignature({ 0, 0, 4, 0, { 0x50, 0x4B, 0x03, 0x04 } }), // apk
+    embeddedSignature({ 0, 0, 4, 0, { 0x50, 0x4B, 0x05, 0x06 } }), // apk
+    embeddedSignature({ 0, 0, 4, 0, { 0x50, 0x4B, 0x07, 0x08 } }), // apk
+    embeddedSignature({ 0, 0, 4, 0, { 0x52, 0x49, 0x46, 0x46 } }), // avi
+    embeddedSignature({ 0, 0, 2, 0, { 0x4D, 0x5A } }), // ax
+    embeddedSignature({ 0, 0, 5, 32769, { 0x43, 0x44, 0x30, 0x30, 0x31 } }), // iso
+    embeddedSignature({ 0, 0, 5, 34817, { 0x43, 0x44, 0x30, 0x30, 0x31 } }), // iso
+    embeddedSignature({ 0, 0, 5, 36865, { 0x43, 0x44, 0x30, 0x30, 0x31 } }), // iso
+    embeddedSignature({ 0, 0, 5, 0, { 0x25, 0x50, 0x44, 0x46, 0x2D } }), // pdf
+    embeddedSignature({ 0, 0, 3, 0, { 0x4E, 0x45, 0x53 } }), // nes
+    embeddedSignature({ 0, 0, 2, 0, { 0x4D, 0x5A } }), // dll
+    embeddedSignature({ 0, 0, 5, 0, { 0x00, 0x00, 0x1A, 0x00, 0x05 } }), // 123
+    embeddedSignature({ 0, 0, 2, 0, { 0x4D, 0x5A } }), // mui
+    embeddedSignature({ 0, 0, 4, 0, { 0x53, 0x51, 0x4C, 0x69 } }), // sqlite
+    embeddedSignature({ 0, 0, 4, 0, { 0x1A, 0x45, 0xDF, 0xA3 } }), // webm
+    embeddedSignature({ 0, 0, 8, 0, { 0xD0, 0xCF, 0x11, 0xE0, 0xA1, 0xB1, 0x1A, 0xE1 } }), // msi
+    embeddedSignature({ 0, 0, 5, 0, { 0x00, 0x00, 0x1A, 0x00, 0x00 } }), // wk3
+    embeddedSignature({ 0, 0, 5, 0, { 0x00, 0x00, 0x02, 0x00, 0x06 } }), // wk1
+    embeddedSignature({ 0, 0, 5, 0, { 0x00, 0x00, 0x1A, 0x00, 0x02 } }), // wk5
+    embeddedSignature({ 0, 0, 4, 0, { 0x53, 0x51, 0x4C, 0x69 } }), // db
+    embeddedSignature({ 0, 0, 8, 0, { 0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A } }), // png
+    embeddedSignature({ 0, 0, 4, 0, { 0x50, 0x4B, 0x03, 0x04 } }), // pptx
+    embeddedSignature({ 0, 0, 4, 0, { 0x50, 0x4B, 0x05, 0x06 } }), // pptx
+    embeddedSignature({ 0, 0, 4, 0, { 0x50, 0x4B, 0x07, 0x08 } }), // pptx
+    embeddedSignature({ 0, 0, 2, 0, { 0x4D, 0x5A } }), // sys
+    embeddedSignature({ 0, 0, 5, 0, { 0x02, 0x00, 0x5A, 0x57, 0x52 } }), // cwk
+    embeddedSignature({ 0, 0, 2, 0, { 0x1F, 0x8B } }), // gz
+    embeddedSignature({ 0, 0, 2, 0, { 0xFF, 0xFB } }), // mp3
+    embeddedSignature({ 0, 0, 2, 0, { 0xFF, 0xF3 } }), // mp3
+    embeddedSignature({ 0, 0, 2, 0, { 0xFF, 0xF2 } }), // mp3
+    embeddedSignature({ 0, 0, 3, 0, { 0x49, 0x44, 0x33 } }), // mp3
+    embeddedSignature({ 0, 0, 4, 0, { 0x4D, 0x54, 0x68, 0x64 } }), // mid
+    embeddedSignature({ 0, 0, 4, 0, { 0x53, 0x51, 0x4C, 0x69 } }), // sqlitedb
+    embeddedSignature({ 0, 0, 4, 0, { 0xD4, 0xC3, 0xB2, 0xA1 } }), // pcap
+    embeddedSignature({ 0, 0, 4, 0, { 0xA1, 0xB2, 0xC3, 0xD4 } }), // pcap
+    embeddedSignature({ 0, 0, 4, 0, { 0x0A, 0x0D, 0x0D, 0x0A } }), // pcapng
+    embeddedSignature({ 0, 0, 6, 0, { 0x7B, 0x5C, 0x72, 0x74, 0x66, 0x31 } }), // rtf
+    embeddedSignature({ 0, 0, 2, 0, { 0x4D, 0x5A } }), // scr
+    embeddedSignature({ 0, 0, 4, 0, { 0x00, 0x00, 0x49, 0x49 } }), // qxd
+    embeddedSignature({ 0, 0, 4, 0, { 0x00, 0x00, 0x4D, 0x4D } }), // qxd
+    embeddedSignature({ 0, 0, 2, 0, { 0x1F, 0x8B } }), // tar.gz
+    embeddedSignature({ 0, 0, 4, 0, { 0x4D, 0x54, 0x68, 0x64 } }), // midi
+};
+
+constexpr uint32_t EMBEDDED_SIGNATURES_OWNERS[] = {
+    0, 1, 2, 3, 3, 3, 4, 5, 6, 6, 6, 7, 8, 9, 10, 10,
+    10, 10, 11, 11, 12, 13, 14, 15, 16, 17, 17, 18, 19, 20, 21, 22,
+    22, 22, 23, 24, 25, 26, 26, 26, 26, 27, 27, 27, 28, 29, 30, 31,
+    32, 32, 32, 33, 34, 35, 35, 35, 36, 37, 38, 39, 40, 41, 42, 43,
+    44, 45, 46, 47, 48, 49, 49, 49, 50, 51, 52, 53, 53, 53, 53, 54,
+    55, 56, 56, 57, 58, 59, 60, 60, 61, 62,
+};
+
+constexpr uint32_t EMBEDDED_SIGNATURES_ORDER[] = {
+    73, 65, 64, 20, 66, 59, 86, 87, 11, 81, 82, 83, 29, 80, 61, 67,
+    1, 37, 14, 38, 15, 39, 16, 40, 17, 18, 58, 60, 72, 85, 0, 23,
+    52, 28, 22, 13, 47, 6, 19, 41, 42, 43, 3, 4, 5, 48, 49, 50,
+    31, 32, 33, 69, 70, 71, 8, 9, 10, 46, 68, 56, 30, 24, 51, 75,
+    76, 77, 78, 53, 54, 55, 57, 79, 89, 2, 44, 21, 63, 27, 34, 7,
+    45, 74, 88, 36, 12, 62, 84, 25, 26, 35,
+};
+
+constexpr EmbeddedExtension EMBEDDED_SIGNATURES_EXTENSIONS[] = {
+    { "cpl", 3, 0, 1, 2 },
+    { "gif", 3, 1, 1, 4 },
+    { "doc", 3, 2, 1, 8 },
+    { "docx", 4, 3, 3, 4 },
+    { "ssp", 3, 6, 1, 4 },
+    { "tar", 3, 7, 1, 0 },
+    { "xlsx", 4, 8, 3, 4 },
+    { "psafe3", 6, 11, 1, 4 },
+    { "tar.xz", 6, 12, 1, 6 },
+    { "rs", 2, 13, 1, 2 },
+    { "jpeg", 4, 14, 4, 4 },
+    { "exe", 3, 18, 2, 2 },
+    { "wk4", 3, 20, 1, 5 },
+    { "ppt", 3, 21, 1, 8 },
+    { "ime", 3, 22, 1, 2 },
+    { "ocx", 3, 23, 1, 2 },
+    { "wav", 3, 24, 1, 4 },
+    { "mp4", 3, 25, 2, 0 },
+    { "msg", 3, 27, 1, 8 },
+    { "iec", 3, 28, 1, 2 },
+    { "rpm", 3, 29, 1, 4 },
+    { "wmv", 3, 30, 1, 4 },
+    { "jar", 3, 31, 3, 4 },
+    { "dmg", 3, 34, 1, 4 },
+    { "drw", 3, 35, 1, 6 },
+    { "xz", 2, 36, 1, 6 },
+    { "jpg", 3, 37, 4, 4 },
+    { "zip", 3, 41, 3, 4 },
+    { "xls", 3, 44, 1, 8 },
+    { "7z", 2, 45, 1, 6 },
+    { "rar", 3, 46, 1, 6 },
+    { "tsp", 3, 47, 1, 2 },
+    { "apk", 3, 48, 3, 4 },
+    { "avi", 3, 51, 1, 4 },
+    { "ax", 2, 52, 1, 2 },
+    { "iso", 3, 53, 3, 0 },
+    { "pdf", 3, 56, 1, 5 },
+    { "nes", 3, 57, 1, 3 },
+    { "dll", 3, 58, 1, 2 },
+    { "123", 3, 59, 1, 5 },
+    { "mui", 3, 60, 1, 2 },
+    { "sqlite", 6, 61, 1, 4 },
+    { "webm", 4, 62, 1, 4 },
+    { "msi", 3, 63, 1, 8 },
+    { "wk3", 3, 64, 1, 5 },
+    { "wk1", 3, 65, 1, 5 },
+    { "wk5", 3, 66, 1, 5 },
+    { "db", 2, 67, 1, 4 },
+    { "png", 3, 68, 1, 8 },
+    { "pptx", 4, 69, 3, 4 },
+    { "sys", 3, 72, 1, 2 },
+    { "cwk", 3, 73, 1, 5 },
+    { "gz", 2, 74, 1, 2 },
+    { "mp3", 3, 75, 4, 3 },
+    { "mid", 3, 79, 1, 4 },
+    { "sqlitedb", 8, 80, 1, 4 },
+    { "pcap", 4, 81, 2, 4 },
+    { "pcapng", 6, 83, 1, 4 },
+    { "rtf", 3, 84, 1, 6 },
+    { "scr", 3, 85, 1, 2 },
+    { "qxd", 3, 86, 2, 4 },
+    { "tar.gz", 6, 88, 1, 2 },
+    { "midi", 4, 89, 1, 4 },
+};
+
+constexpr uint32_t EMBEDDED_SIGNATURES_RESOLVER_ROOT[256] = {
+    RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, 4, RESOLVER_NONE, 7, 10, 13, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, RESOLVER_NONE, 39, 81, 18, 47, 53, 30,
+    RESOLVER_NONE, 66, RESOLVER_NONE, 1, 63, 36, RESOLVER_NONE, 115,
+    26, RESOLVER_NONE, 72, 69, 129, RESOLVER_NONE, 106, 158,
+    77, RESOLVER_NONE, 139, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+    RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE, RESOLVER_NONE,
+};
+
+constexpr ResolverNode EMBEDDED_SIGNATURES_RESOLVER_NODES[] = {
+    { 0, 23, RESOLVER_NONE }, { 23, 2, RESOLVER_NONE }, { 25, 1, RESOLVER_NONE }, { 26, 0, 51 },
+    { 26, 1, RESOLVER_NONE }, { 27, 1, RESOLVER_NONE }, { 28, 0, 45 }, { 28, 4, RESOLVER_NONE },
+    { 32, 1, RESOLVER_NONE }, { 33, 0, 44 }, { 33, 2, RESOLVER_NONE }, { 35, 1, RESOLVER_NONE },
+    { 36, 0, 12 }, { 36, 1, RESOLVER_NONE }, { 37, 1, RESOLVER_NONE }, { 38, 0, 46 },
+    { 38, 1, RESOLVER_NONE }, { 39, 0, 39 }, { 39, 2, RESOLVER_NONE }, { 41, 1, RESOLVER_NONE },
+    { 42, 0, 60 }, { 42, 1, RESOLVER_NONE }, { 43, 1, RESOLVER_NONE }, { 44, 1, RESOLVER_NONE },
+    { 45, 1, RESOLVER_NONE }, { 46, 0, 7 }, { 46, 3, RESOLVER_NONE }, { 49, 1, RESOLVER_NONE },
+    { 50, 1, RESOLVER_NONE }, { 51, 0, 56 }, { 51, 5, RESOLVER_NONE }, { 56, 1, RESOLVER_NONE },
+    { 57, 1, 48 }, { 58, 1, RESOLVER_NONE }, { 59, 1, RESOLVER_NONE }, { 60, 0, 57 },
+    { 60, 2, RESOLVER_NONE }, { 62, 1, RESOLVER_NONE }, { 63, 0, 20 }, { 63, 1, RESOLVER_NONE },
+    { 64, 1, 47 }, { 65, 1, RESOLVER_NONE }, { 66, 1, RESOLVER_NONE }, { 67, 1, RESOLVER_NONE },
+    { 68, 1, RESOLVER_NONE }, { 69, 1, RESOLVER_NONE }, { 70, 0, 55 }, { 70, 3, RESOLVER_NONE },
+    { 73, 1, RESOLVER_NONE }, { 74, 1, RESOLVER_NONE }, { 75, 1, RESOLVER_NONE }, { 76, 1, RESOLVER_NONE },
+    { 77, 0, 41 }, { 77, 3, RESOLVER_NONE }, { 80, 1, RESOLVER_NONE }, { 81, 0, 1 },
+    { 81, 1, RESOLVER_NONE }, { 82, 0, 26 }, { 82, 1, RESOLVER_NONE }, { 83, 1, RESOLVER_NONE },
+    { 84, 0, 10 }, { 84, 1, RESOLVER_NONE }, { 85, 0, 11 }, { 85, 2, RESOLVER_NONE },
+    { 87, 1, RESOLVER_NONE }, { 88, 0, 38 }, { 88, 4, RESOLVER_NONE }, { 92, 1, RESOLVER_NONE },
+    { 93, 0, 40 }, { 93, 4, RESOLVER_NONE }, { 97, 1, RESOLVER_NONE }, { 98, 0, 50 },
+    { 98, 2, RESOLVER_NONE }, { 100, 1, RESOLVER_NONE }, { 101, 0, 59 }, { 101, 1, RESOLVER_NONE },
+    { 102, 0, 0 }, { 102, 4, RESOLVER_NONE }, { 106, 1, RESOLVER_NONE }, { 107, 1, 15 },
+    { 108, 0, 34 }, { 108, 2, RESOLVER_NONE }, { 110, 1, RESOLVER_NONE }, { 111, 0, 19 },
+    { 111, 1, RESOLVER_NONE }, { 112, 0, 14 }, { 112, 0, 9 }, { 112, 2, RESOLVER_NONE },
+    { 114, 0, 31 }, { 114, 0, 4 }, { 114, 1, RESOLVER_NONE }, { 115, 0, 27 },
+    { 115, 0, 3 }, { 115, 1, RESOLVER_NONE }, { 116, 0, 32 }, { 116, 3, RESOLVER_NONE },
+    { 119, 0, 22 }, { 119, 1, RESOLVER_NONE }, { 120, 1, RESOLVER_NONE }, { 121, 0, 49 },
+    { 121, 1, RESOLVER_NONE }, { 122, 1, RESOLVER_NONE }, { 123, 0, 6 }, { 123, 0, 30 },
+    { 123, 1, RESOLVER_NONE }, { 124, 0, 36 }, { 124, 2, RESOLVER_NONE }, { 126, 1, RESOLVER_NONE },
+    { 127, 0, 21 }, { 127, 1, RESOLVER_NONE }, { 128, 0, 16 }, { 128, 1, RESOLVER_NONE },
+    { 129, 0, 33 }, { 129, 1, RESOLVER_NONE }, { 130, 0, 53 }, { 130, 1, RESOLVER_NONE },
+    { 131, 1, RESOLVER_NONE }, { 132, 0, 35 }, { 132, 1, RESOLVER_NONE }, { 133, 0, 37 },
+    { 133, 1, RESOLVER_NONE }, { 134, 0, 54 }, { 134, 1, RESOLVER_NONE }, { 135, 1, RESOLVER_NONE },
+    { 136, 0, 62 }, { 136, 1, RESOLVER_NONE }, { 137, 0, 2 }, { 137, 1, RESOLVER_NONE },
+    { 138, 0, 28 }, { 138, 1, RESOLVER_NONE }, { 139, 1, RESOLVER_NONE }, { 140, 0, 13 },
+    { 140, 1, RESOLVER_NONE }, { 141, 0, 43 }, { 141, 1, RESOLVER_NONE }, { 142, 0, 18 },
+    { 142, 1, RESOLVER_NONE }, { 143, 0, 23 }, { 143, 0, 5 }, { 143, 3, RESOLVER_NONE },
+    { 146, 0, 29 }, { 146, 1, 52 }, { 147, 1, RESOLVER_NONE }, { 148, 1, RESOLVER_NONE },
+    { 149, 1, RESOLVER_NONE }, { 150, 0, 61 }, { 150, 1, 25 }, { 151, 1, RESOLVER_NONE },
+    { 152, 1, RESOLVER_NONE }, { 153, 1, RESOLVER_NONE }, { 154, 0, 8 }, { 154, 1, RESOLVER_NONE },
+    { 155, 1, RESOLVER_NONE }, { 156, 0, 42 }, { 156, 1, RESOLVER_NONE }, { 157, 0, 58 },
+    { 157, 1, RESOLVER_NONE }, { 158, 0, 17 }, { 158, 1, RESOLVER_NONE }, { 159, 1, RESOLVER_NONE },
+    { 160, 0, 24 },
+};
+
+constexpr ResolverEdge EMBEDDED_SIGNATURES_RESOLVER_EDGES[] = {
+    { 49, {}, 4 }, { 51, {}, 7 }, { 52, {}, 10 }, { 53, {}, 13 }, { 98, {}, 39 }, { 99, {}, 81 },
+    { 100, {}, 18 }, { 101, {}, 47 }, { 102, {}, 53 }, { 103, {}, 30 }, { 105, {}, 66 }, { 107, {}, 1 },
+    { 108, {}, 63 }, { 109, {}, 36 }, { 111, {}, 115 }, { 112, {}, 26 }, { 114, {}, 72 }, { 115, {}, 69 },
+    { 116, {}, 129 }, { 118, {}, 106 }, { 119, {}, 158 }, { 120, {}, 77 }, { 122, {}, 139 }, { 112, {}, 93 },
+    { 119, {}, 2 }, { 99, {}, 3 }, { 107, {}, 5 }, { 119, {}, 6 }, { 50, {}, 16 }, { 101, {}, 21 },
+    { 107, {}, 8 }, { 112, {}, 113 }, { 119, {}, 9 }, { 107, {}, 11 }, { 112, {}, 156 }, { 119, {}, 12 },
+    { 107, {}, 14 }, { 119, {}, 15 }, { 49, {}, 17 }, { 105, {}, 120 }, { 120, {}, 19 }, { 113, {}, 20 },
+    { 102, {}, 22 }, { 97, {}, 23 }, { 115, {}, 24 }, { 112, {}, 25 }, { 97, {}, 27 }, { 105, {}, 90 },
+    { 115, {}, 87 }, { 99, {}, 28 }, { 112, {}, 29 }, { 101, {}, 58 }, { 109, {}, 136 }, { 110, {}, 31 },
+    { 112, {}, 56 }, { 115, {}, 134 }, { 112, {}, 32 }, { 97, {}, 33 }, { 99, {}, 34 }, { 112, {}, 35 },
+    { 98, {}, 151 }, { 112, {}, 37 }, { 114, {}, 38 }, { 100, {}, 40 }, { 101, {}, 41 }, { 116, {}, 42 },
+    { 105, {}, 43 }, { 108, {}, 44 }, { 113, {}, 45 }, { 115, {}, 46 }, { 109, {}, 84 }, { 116, {}, 48 },
+    { 120, {}, 61 }, { 105, {}, 49 }, { 108, {}, 50 }, { 113, {}, 51 }, { 115, {}, 52 }, { 100, {}, 104 },
+    { 105, {}, 54 }, { 116, {}, 154 }, { 103, {}, 55 }, { 106, {}, 57 }, { 112, {}, 59 }, { 106, {}, 60 },
+    { 101, {}, 62 }, { 108, {}, 64 }, { 112, {}, 75 }, { 100, {}, 65 }, { 100, {}, 122 }, { 115, {}, 132 },
+    { 117, {}, 67 }, { 118, {}, 111 }, { 109, {}, 68 }, { 101, {}, 118 }, { 108, {}, 127 }, { 114, {}, 86 },
+    { 121, {}, 70 }, { 115, {}, 71 }, { 97, {}, 95 }, { 99, {}, 73 }, { 115, {}, 74 }, { 99, {}, 76 },
+    { 97, {}, 80 }, { 99, {}, 78 }, { 115, {}, 100 }, { 116, {}, 97 }, { 111, {}, 79 }, { 100, {}, 92 },
+    { 101, {}, 82 }, { 111, {}, 125 }, { 105, {}, 83 }, { 105, {}, 85 }, { 115, {}, 89 }, { 116, {}, 88 },
+    { 122, {}, 91 }, { 97, {}, 94 }, { 106, {}, 96 }, { 114, {}, 103 }, { 116, {}, 138 }, { 112, {}, 98 },
+    { 112, {}, 99 }, { 108, {}, 101 }, { 120, {}, 102 }, { 112, {}, 105 }, { 97, {}, 109 }, { 109, {}, 107 },
+    { 119, {}, 108 }, { 119, {}, 110 }, { 97, {}, 112 }, { 109, {}, 114 }, { 115, {}, 116 }, { 105, {}, 117 },
+    { 110, {}, 119 }, { 109, {}, 121 }, { 105, {}, 123 }, { 109, {}, 124 }, { 100, {}, 126 }, { 120, {}, 128 },
+    { 112, {}, 130 }, { 112, {}, 131 }, { 109, {}, 133 }, { 109, {}, 135 }, { 100, {}, 137 }, { 55, {}, 140 },
+    { 103, {}, 141 }, { 120, {}, 146 }, { 46, {}, 142 }, { 114, {}, 143 }, { 97, {}, 144 }, { 116, {}, 145 },
+    { 46, {}, 147 }, { 114, {}, 148 }, { 97, {}, 149 }, { 116, {}, 150 }, { 101, {}, 152 }, { 119, {}, 153 },
+    { 114, {}, 155 }, { 109, {}, 157 }, { 114, {}, 159 }, { 100, {}, 160 },
+};
+
+constexpr EmbeddedSignatureTable EMBEDDED_SIGNATURES = {
+    EMBEDDED_SIGNATURES_DISPLACEMENTS, 16,
+    EMBEDDED_SIGNATURES_EXTENSIONS, 63,
+    EMBEDDED_SIGNATURES_SIGNATURES, EMBEDDED_SIGNATURES_OWNERS, EMBEDDED_SIGNATURES_ORDER, 90,
+    EMBEDDED_SIGNATURES_RESOLVER_ROOT, EMBEDDED_SIGNATURES_RESOLVER_NODES, EMBEDDED_SIGNATURES_RESOLVER_EDGES, 161,
+};
+
+#endif
@@ -0,0 +1,307 @@
+// Extension resolution: the longest database extension a path ends with, found in one backward pass
+#ifndef EXTENSION_RESOLVER_H
+#define EXTENSION_RESOLVER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+const uint32_t RESOLVER_NONE = UINT32_MAX;
+
+// The trie laid out flat, for tables used in place (a compiled database, the embedded table).
+// Node 0 is the root; a node's edges are edges[firstEdge, firstEdge + edgeCount), sorted by
+// byte. name numbers the extension ending at the node the way the table owning the trie
+// numbers its extensions, or is RESOLVER_NONE.
+struct ResolverNode {
+    uint32_t firstEdge;
+    uint32_t edgeCount;
+    uint32_t name;
+};
+
+struct ResolverEdge {
+    uint8_t byte; // Lowercased
+    uint8_t reserved[3];
+    uint32_t next;
+};
+
+inline unsigned char resolverLower(unsigned char c) { return c >= 'A' && c <= 'Z' ? static_cast<unsigned char>(c + 32) : c; }
+
+inline bool resolverSpace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+// The walk shared by both layouts. Trie provides child(node, byte), nameAt(node) (a name
+// number or RESOLVER_NONE) and nameText(name).
+template <typename Trie>
+void resolveExtension(const Trie& trie, string_view path, string& extension) {
+    size_t end = path.size();
+    while (end > 0 && resolverSpace(path[end - 1]))
+        end--;
+
+    uint32_t node = 0;
+    uint32_t best = RESOLVER_NONE;
+    size_t lastDot = string_view::npos;
+    for (size_t i = end; i > 0; i--) {
+        char c = path[i - 1];
+        if (c == '/')
+            break;
+        if (c == '.') {
+            if (lastDot == string_view::npos)
+                lastDot = i - 1;
+            if (node != RESOLVER_NONE && trie.nameAt(node) != RESOLVER_NONE)
+                best = trie.nameAt(node);
+        }
+        if (node != RESOLVER_NONE)
+            node = trie.child(node, resolverLower(static_cast<unsigned char>(c)));
+        if (node == RESOLVER_NONE && lastDot != string_view::npos)
+            break; // No longer extension can match, and the fallback is known
+    }
+
+    if (best != RESOLVER_NONE) {
+        string_view name = trie.nameText(best);
+        extension.assign(name.data(), name.size());
+        return;
+    }
+    if (lastDot == string_view::npos) {
+        extension.clear();
+        return;
+    }
+    size_t begin = lastDot + 1;
+    while (begin < end && resolverSpace(path[begin]))
+        begin++;
+    extension.assign(path.data() + begin, end - begin);
+}
+
+// Trie of the database's extensions spelled backwards and lowercased, so walking a path from
+// its end follows every extension it could end with at once. "archive.TAR.GZ" passes the
+// node for "gz" and goes on through '.' to "tar.gz"; the longest one that begins right after
+// a dot wins. Nothing is allocated and nothing is printed while resolving.
+class ExtensionResolver {
+private:
+    static constexpr uint32_t NONE = RESOLVER_NONE;
+
+    struct Edge {
+        unsigned char byte; // Lowercased
+        uint32_t next;
+    };
+
+    struct Node {
+        vector<Edge> edges; // Sorted by byte
+        uint32_t name = NONE; // Extension ending here, as the database spells it
+    };
+
+    vector<Node> nodes; // nodes[0] is the root
+    vector<string> names;
+    vector<uint32_t> nameNodes; // Node each name was added at
+    uint32_t rootChildren[256]; // The root has the most edges (an extension's last letter), so it gets a table
+
+    // Utility function: The node for extension, created if create is set; NONE if absent
+    uint32_t walk(const string& extension, bool create)
+    {
+        uint32_t node = 0;
+        for (size_t i = extension.size(); i > 0; i--) {
+            unsigned char byte = resolverLower(static_cast<unsigned char>(extension[i - 1]));
+            uint32_t next = child(node, byte);
+            if (next == NONE) {
+                if (!create)
+                    return NONE;
+                next = static_cast<uint32_t>(nodes.size());
+                vector<Edge>& edges = nodes[node].edges;
+                auto it = edges.begin();
+                while (it != edges.end() && it->byte < byte)
+                    ++it;
+                edges.insert(it, Edge{ byte, next });
+                nodes.emplace_back();
+                if (node == 0)
+                    rootChildren[byte] = next;
+            }
+            node = next;
+        }
+        return node;
+    }
+
+public:
+    ExtensionResolver()
+        : nodes(1)
+    {
+        fill(begin(rootChildren), end(rootChildren), NONE);
+    }
+
+    // Public function: Forget every extension
+    void clear()
+    {
+        nodes.assign(1, Node());
+        names.clear();
+        nameNodes.clear();
+        fill(begin(rootChildren), end(rootChildren), NONE);
+    }
+
+    // Public function: Make extension resolvable. Of two spellings differing only in case, the
+    // first added is the one resolved to.
+    void add(const string& extension)
+    {
+        if (extension.empty())
+            return;
+        uint32_t node = walk(extension, true);
+        if (nodes[node].name == NONE) {
+            nodes[node].name = static_cast<uint32_t>(names.size());
+            names.push_back(extension);
+            nameNodes.push_back(node);
+        }
+    }
+
+    // Public function: Stop resolving extension (its nodes stay, unmarked)
+    void remove(const string& extension)
+    {
+        uint32_t node = extension.empty() ? NONE : walk(extension, false);
+        if (node != NONE && nodes[node].name != NONE && names[nodes[node].name] == extension)
+            nodes[node].name = NONE;
+    }
+
+    // Public function: Set extension to the longest known extension the path's file name ends
+    // with (after a dot, ignoring case and trailing whitespace), spelled as the database spells
+    // it. A name with no known extension gets the text after its last dot, trimmed, or "".
+    // extension is assigned in place, so a reused string does not allocate.
+    void resolve(string_view path, string& extension) const { resolveExtension(*this, path, extension); }
+
+    // Public function: The child of node along a lowercased byte, or RESOLVER_NONE
+    uint32_t child(uint32_t node, unsigned char byte) const
+    {
+        if (node == 0)
+            return rootChildren[byte];
+        for (const Edge& edge : nodes[node].edges) {
+            if (edge.byte == byte)
+                return edge.next;
+            if (edge.byte > byte)
+                break;
+        }
+        return NONE;
+    }
+
+    // Public function: The name ending at node, or RESOLVER_NONE, and its text
+    uint32_t nameAt(uint32_t node) const { return nodes[node].name; }
+    string_view nameText(uint32_t name) const { return names[name]; }
+
+    // Public function: Lay the trie out for a table used in place. nameNumber(extension) gives
+    // the number the table knows each extension by; root gets the root's 256 children.
+    template <typename NameNumber>
+    void flatten(NameNumber nameNumber, uint32_t* root, vector<ResolverNode>& flatNodes, vector<ResolverEdge>& flatEdges) const
+    {
+        copy(begin(rootChildren), end(rootChildren), root);
+        flatNodes.clear();
+        flatEdges.clear();
+        for (const Node& node : nodes) {
+            ResolverNode flat{ static_cast<uint32_t>(flatEdges.size()), static_cast<uint32_t>(node.edges.size()), NONE };
+            if (node.name != NONE)
+                flat.name = nameNumber(names[node.name]);
+            for (const Edge& edge : node.edges)
+                flatEdges.push_back(ResolverEdge{ edge.byte, { 0, 0, 0 }, edge.next });
+            flatNodes.push_back(flat);
+        }
+    }
+
+    // Public function: The extensions that resolve, in the order they were added
+    vector<string> extensions() const
+    {
+        vector<string> list;
+        for (size_t i = 0; i < names.size(); i++) {
+            if (nodes[nameNodes[i]].name == i)
+                list.push_back(names[i]);
+        }
+        return list;
+    }
+
+    // Public function: Number of extensions that resolve
+    size_t extensionCount() const
+    {
+        size_t count = 0;
+        for (size_t i = 0; i < names.size(); i++)
+            count += nodes[nameNodes[i]].name == i;
+        return count;
+    }
+};
+
+// A flat trie with no extensions, for a table that is not loaded
+struct EmptyResolverTrie {
+    uint32_t root[256];
+    ResolverNode node;
+};
+
+inline const EmptyResolverTrie& emptyResolverTrie() {
+    static const EmptyResolverTrie empty = [] {
+        EmptyResolverTrie trie;
+        fill(begin(trie.root), end(trie.root), RESOLVER_NONE);
+        trie.node = ResolverNode{ 0, 0, RESOLVER_NONE };
+        return trie;
+    }();
+    return empty;
+}
+
+// A flattened trie used where it lies, e.g. in a mapped file or constexpr arrays. Names is
+// callable with a name number and returns its text. Holds four pointers; copying is free.
+template <typename Names>
+class FlatExtensionResolver {
+private:
+    const uint32_t* rootChildren; // 256 entries
+    const ResolverNode* nodes;
+    const ResolverEdge* edges;
+    uint32_t nodeCount;
+    Names names;
+
+public:
+    FlatExtensionResolver(const uint32_t* rootChildren, const ResolverNode* nodes, const ResolverEdge* edges,
+                          uint32_t nodeCount, Names names)
+        : rootChildren(rootChildren), nodes(nodes), edges(edges), nodeCount(nodeCount), names(names)
+    {
+    }
+
+    // Public function: See ExtensionResolver::resolve
+    void resolve(string_view path, string& extension) const { resolveExtension(*this, path, extension); }
+
+    // Public function: The child of node along a lowercased byte, or RESOLVER_NONE
+    uint32_t child(uint32_t node, unsigned char byte) const
+    {
+        if (node == 0)
+            return rootChildren[byte];
+        const ResolverNode& at = nodes[node];
+        for (uint32_t i = at.firstEdge; i < at.firstEdge + at.edgeCount; i++) {
+            if (edges[i].byte == byte)
+                return edges[i].next;
+            if (edges[i].byte > byte)
+                break;
+        }
+        return RESOLVER_NONE;
+    }
+
+    // Public function: The name ending at node, or RESOLVER_NONE, and its text
+    uint32_t nameAt(uint32_t node) const { return nodes[node].name; }
+    string_view nameText(uint32_t name) const { return names(name); }
+
+    // Public function: The extensions that resolve, by name number
+    vector<string> extensions() const
+    {
+        vector<uint32_t> numbers;
+        for (uint32_t i = 0; i < nodeCount; i++) {
+            if (nodes[i].name != RESOLVER_NONE)
+                numbers.push_back(nodes[i].name);
+        }
+        sort(numbers.begin(), numbers.end());
+        vector<string> list;
+        for (uint32_t number : numbers)
+            list.emplace_back(names(number));
+        return list;
+    }
+
+    // Public function: Number of extensions that resolve
+    size_t extensionCount() const
+    {
+        size_t count = 0;
+        for (uint32_t i = 0; i < nodeCount; i++)
+            count += nodes[i].name != RESOLVER_NONE;
+        return count;
+    }
+};
+
+#endif
@@ -1,8 +1,13 @@
 // C++ Program to Implement Red Black Tree
+#ifndef FILE_BASE_H
+#define FILE_BASE_H
+
 #include <iostream>
 #include <utility>
 #include <string>
+#include <vector>
 #include <algorithm>
+#include "ExtensionResolver.h"
 
 using namespace std;
 
@@ -16,7 +21,7 @@ private:
     struct Data {
         vector<T> signatures;  // List of file signatures
         string extension;      // File extension
-        size_t signatureLength; // Length of each signature
+        size_t signatureLength; // Length of the longest signature
 
         // Constructor for Data
         Data(const vector<T>& sigs, const string& ext, size_t len)
@@ -41,6 +46,7 @@ private:
     };
 
     Node* root; // Root of the Red-Black Tree
+    ExtensionResolver extensions; // Every extension in the tree, for resolving paths
 
     // Utility function: Left Rotation
     void rotateLeft(Node*& node)
@@ -131,78 +137,75 @@ private:
         root->color = BLACK;
     }
 
-    // Utility function: Fixing Deletion Violation
-    void fixDelete(Node*& node)
+    // Utility function: Missing children count as black leaves
+    static bool isBlack(const Node* node) { return node == nullptr || node->color == BLACK; }
+
+    // Utility function: Fixing Deletion Violation. node may be nullptr (an empty leaf), so
+    // its parent is passed separately.
+    void fixDelete(Node* node, Node* parent)
     {
-        while (node != root && node->color == BLACK) {
-            if (node == node->parent->left) {
-                Node* sibling = node->parent->right;
+        while (node != root && isBlack(node)) {
+            if (node == parent->left) {
+                Node* sibling = parent->right;
                 if (sibling->color == RED) {
                     sibling->color = BLACK;
-                    node->parent->color = RED;
-                    rotateLeft(node->parent);
-                    sibling = node->parent->right;
+                    parent->color = RED;
+                    rotateLeft(parent);
+                    sibling = parent->right;
                 }
-                if ((sibling->left == nullptr
-                     || sibling->left->color == BLACK)
-                    && (sibling->right == nullptr
-                        || sibling->right->color
-                               == BLACK)) {
+                if (isBlack(sibling->left) && isBlack(sibling->right)) {
                     sibling->color = RED;
-                    node = node->parent;
+                    node = parent;
+                    parent = node->parent;
                 }
                 else {
-                    if (sibling->right == nullptr
-                        || sibling->right->color == BLACK) {
+                    if (isBlack(sibling->right)) {
                         if (sibling->left != nullptr)
                             sibling->left->color = BLACK;
                         sibling->color = RED;
                         rotateRight(sibling);
-                        sibling = node->parent->right;
+                        sibling = parent->right;
                     }
-                    sibling->color = node->parent->color;
-                    node->parent->color = BLACK;
+                    sibling->color = parent->color;
+                    parent->color = BLACK;
                     if (sibling->right != nullptr)
                         sibling->right->color = BLACK;
-                    rotateLeft(node->parent);
+                    rotateLeft(parent);
                     node = root;
                 }
             }
             else {
-                Node* sibling = node->parent->left;
+                Node* sibling = parent->left;
                 if (sibling->color == RED) {
                     sibling->color = BLACK;
-                    node->parent->color = RED;
-                    rotateRight(node->parent);
-                    sibling = node->parent->left;
+                    parent->color = RED;
+                    rotateRight(parent);
+                    sibling = parent->left;
                 }
-                if ((sibling->left == nullptr
-                     || sibling->left->color == BLACK)
-                    && (sibling->right == nullptr
-                        || sibling->right->color
-                               == BLACK)) {
+                if (isBlack(sibling->left) && isBlack(sibling->right)) {
                     sibling->color = RED;
-                    node = node->parent;
+                    node = parent;
+                    parent = node->parent;
                 }
                 else {
-                    if (sibling->left == nullptr
-                        || sibling->left->color == BLACK) {
+                    if (isBlack(sibling->left)) {
                         if (sibling->right != nullptr)
                             sibling->right->color = BLACK;
                         sibling->color = RED;
                         rotateLeft(sibling);
-                        sibling = node->parent->left;
+                        sibling = parent->left;
                     }
-                    sibling->color = node->parent->color;
-                    node->parent->color = BLACK;
+                    sibling->color = parent->color;
+                    parent->color = BLACK;
                     if (sibling->left != nullptr)
                         sibling->left->color = BLACK;
-                    rotateRight(node->parent);
+                    rotateRight(parent);
                     node = root;
                 }
             }
         }
-        node->color = BLACK;
+        if (node != nullptr)
+            node->color = BLACK;
     }
 
     // Utility function: Find Node with Minimum Value
@@ -270,6 +273,10 @@ public:
     // Destructor: Delete Red-Black Tree
     ~RedBlackTree() { deleteTree(root); }
 
+    // Nodes are owned through raw pointers, so copies would double-free
+    RedBlackTree(const RedBlackTree&) = delete;
+    RedBlackTree& operator=(const RedBlackTree&) = delete;
+
     // Public function: Insert a value into Red-Black Tree
     void insert(T key, const string& extension, size_t length)
     {
@@ -281,7 +288,9 @@ public:
             parent = current;
             if (extension == current->data.extension) {
                 // If the extension already exists, add the signature to the existing node
+                // and keep the length of the longest one so a single read covers them all
                 current->data.signatures.push_back(key);
+                current->data.signatureLength = max(current->data.signatureLength, length);
                 return;
             } else if (extension < current->data.extension) {
                 // Move to the left subtree if the extension is smaller
@@ -294,6 +303,7 @@ public:
 
         // Create a new node for the extension
         Node* node = new Node(key, extension, length);
+        extensions.add(extension);
         node->parent = parent;
 
         // Attach the new node to the parent
@@ -309,39 +319,33 @@ public:
         fixInsert(node);
     }
 
-    // Public function: Remove a value from Red-Black Tree
-    void remove(T key)
+    // Public function: Remove an extension and all of its signatures.
+    // The tree is ordered by extension, so that is what the search compares.
+    // Returns false if the extension is not in the tree.
+    bool remove(const string& extension)
     {
-        Node* node = root;
-        Node* z = nullptr;
-        Node* x = nullptr;
-        Node* y = nullptr;
-        while (node != nullptr) {
-            if (node->data.signatures[0] == key) {
-                z = node;
-            }
-
-            if (node->data.signatures[0] <= key) {
-                node = node->right;
-            }
-            else {
-                node = node->left;
-            }
+        Node* z = root;
+        while (z != nullptr) {
+            int cmp = extension.compare(z->data.extension);
+            if (cmp == 0)
+                break;
+            z = cmp < 0 ? z->left : z->right;
         }
+        if (z == nullptr)
+            return false;
 
-        if (z == nullptr) {
-            cout << "Key not found in the tree" << endl;
-            return;
-        }
-
-        y = z;
+        Node* x = nullptr;
+        Node* xParent = nullptr;
+        Node* y = z;
         Color yOriginalColor = y->color;
         if (z->left == nullptr) {
             x = z->right;
+            xParent = z->parent;
             transplant(root, z, z->right);
         }
         else if (z->right == nullptr) {
             x = z->left;
+            xParent = z->parent;
             transplant(root, z, z->left);
         }
         else {
@@ -349,10 +353,12 @@ public:
             yOriginalColor = y->color;
             x = y->right;
             if (y->parent == z) {
+                xParent = y;
                 if (x != nullptr)
                     x->parent = y;
             }
             else {
+                xParent = y->parent;
                 transplant(root, y, y->right);
                 y->right = z->right;
                 y->right->parent = y;
@@ -363,12 +369,16 @@ public:
             y->color = z->color;
         }
         delete z;
+        extensions.remove(extension);
         if (yOriginalColor == BLACK) {
-            fixDelete(x);
+            fixDelete(x, xParent);
         }
+        return true;
     }
+
     // Public function: Search for an extension in the Red-Black Tree and return associated signatures
-    bool search(const string& extension, vector<T>& signatures, size_t& length) {
+    // Lookups only read the tree, so any number of threads may search concurrently
+    bool search(const string& extension, vector<T>& signatures, size_t& length) const {
         Node* current = root; // Start at the root of the tree
         while (current != nullptr) {
             // cout << "Searching in node with extension: " << current->data.extension << endl;
@@ -390,10 +400,27 @@ public:
         }
 
         // If we reach here, the extension was not found
-        cout << "Extension not found: " << extension << endl;
         return false;
     }
 
+    // Public function: Find an extension without copying its signatures. Returns nullptr if absent.
+    const vector<T>* lookup(const string& extension, size_t& length) const
+    {
+        Node* current = root;
+        while (current != nullptr) {
+            int cmp = extension.compare(current->data.extension);
+            if (cmp == 0) {
+                length = current->data.signatureLength;
+                return &current->data.signatures;
+            }
+            current = cmp < 0 ? current->left : current->right;
+        }
+        return nullptr;
+    }
+
+    // Public function: Resolves a path to the longest extension in the tree it ends with
+    const ExtensionResolver& extensionResolver() const { return extensions; }
+
     // Public function: Print the Red-Black Tree
     void printTree()
     {
@@ -406,3 +433,4 @@ public:
     }
 };
 
+#endif
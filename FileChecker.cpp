@@ -3,192 +3,808 @@
 #include <fstream>
 #include <string>
 #include <vector>
-#include <iomanip> // For std::setw and std::setfill
-#include <sstream> // For std::stringstream
+#include <csignal>
+#include <cerrno>
 #include "FileBase.h"
+#include "FileUtils.h"
+#include "AsyncLogger.h"
+#include "BatchScanner.h"
+#include "CheckClient.h"
+#include "CheckServer.h"
+#include "DeepScanner.h"
+#include "DirectoryWatcher.h"
+#include "ResultCache.h"
+#include "ScanReport.h"
+#include "ShardResults.h"
+#include "SignatureStore.h"
+#include "TarScanner.h"
+#include "SignatureDatabase.h"
+#include "FlatIndex.h"
+#include "EmbeddedIndex.h"
+#include "EmbeddedSignatures.h"
+#include "Metrics.h"
 
 using namespace std;
 
-string trim(const string& str) {
-  size_t first = str.find_first_not_of(" \t\n\r");
-  size_t last = str.find_last_not_of(" \t\n\r");
-  if (first == string::npos || last == string::npos) {
-      return ""; // String is all whitespace
-  }
-  return str.substr(first, last - first + 1);
+// Which index a CSV database is loaded into
+enum IndexKind {
+    INDEX_TREE,
+    INDEX_FLAT,
+    INDEX_EMBEDDED // No database at all: the table compiled in from EmbeddedSignatures.h
+};
+
+// The index over the table compiled into this build
+typedef EmbeddedSignatureIndex<EMBEDDED_SIGNATURES> EmbeddedIndex;
+
+// Command line settings
+struct Options {
+    string databasePath = "FileSignature.txt"; // CSV or compiled database
+    IndexKind index = INDEX_TREE;
+    size_t threads = thread::hardware_concurrency();
+    HeaderReader::Backend backend = HeaderReader::IO_URING;
+    size_t batchSize = 256;
+    unsigned ioDeadline = 1000; // Milliseconds an io_uring read may take before the slow lane gets the file, 0 for no limit
+    size_t slowThreads = 2;     // Threads checking the files that missed it
+    LoggerOptions log;     // Where and how results are logged
+    string cachePath;      // Result cache for batch mode, empty for none
+    bool deepScan = false;        // Also search whole files for embedded signatures
+    size_t deepMinLength = 4;     // Shortest signature the deep scan looks for
+    size_t contentBytes = 0;      // Classify files no signature explains from this many bytes, 0 for never
+    string metricsPath;    // Where metrics snapshots go ("-" for stderr), empty for none
+    unsigned metricsInterval = 0; // Seconds between snapshots, 0 for only on SIGUSR1 and at exit
+    string serveSocket;    // Run as a daemon on this Unix socket
+    mode_t socketMode = 0600; // Its permissions
+    string connectSocket;  // Send the inputs to a daemon on this Unix socket
+    vector<string> inputs; // Paths for batch mode
+    bool streamInput = false; // Batch mode over paths read from stdin
+    char delimiter = '\n';    // What separates those paths
+    string tarPath;           // Check the members of this tar archive ("-" for stdin)
+    ShardSpec shard;          // Which slice of the paths batch mode checks
+    string resultsPath;       // Sorted result file written by batch mode (or by --merge), empty for none
+    bool merge = false;       // The inputs are result files to merge
+    bool watch = false;       // The inputs are directory trees to watch for newly written files
+    ReportOptions report;     // Aggregate report instead of per-file lines, when report.path is set
+    bool reportMismatches = false; // In report mode, still log each mismatch
+    WatchOptions watching;
+};
+
+void printUsage(const char* program) {
+    cerr << "Usage: " << program << " [--db FILE]                     (check one path read from stdin)\n"
+         << "       " << program << " [--db FILE] [-j N] <path>...    (batch mode, directories are walked recursively)\n"
+         << "       " << program << " [--db FILE] [-j N] --stdin [-0]   (batch mode over paths streamed on stdin)\n"
+         << "       " << program << " [--db FILE] --tar ARCHIVE|-      (check the members of a tar archive or stream)\n"
+         << "       " << program << " [--db FILE] [-j N] --watch <dir>...  (check files as their writers close them)\n"
+         << "       " << program << " --merge [--results FILE] <result file>...  (combine the result files of shards)\n"
+         << "       " << program << " --compile-db <csv> <output>      (compile a signature database)\n"
+         << "       " << program << " --embed-db <csv> <header>        (generate EmbeddedSignatures.h for --index embedded)\n"
+         << "       " << program << " [--db FILE] [-j N] --serve SOCKET (daemon: answer paths sent over a Unix socket)\n"
+         << "       " << program << " --connect SOCKET [path...]       (check paths with a running daemon; stdin if none)\n"
+         << "  --db FILE         signature database, CSV or compiled (default: FileSignature.txt)\n"
+         << "  --index tree|flat index a CSV database with the red-black tree or the flat hash (default: tree)\n"
+         << "  --index embedded  use the signature table built into the program; --db is ignored\n"
+         << "  -j, --threads N   number of worker threads (default: hardware concurrency)\n"
+         << "  --io uring|pread  how batch mode reads file headers (default: uring when available)\n"
+         << "  --batch N         headers read together per worker (default: 256)\n"
+         << "  --io-deadline MS  batch mode with uring: a file whose reads take longer is handed to the slow lane\n"
+         << "                    so its batch can go on (default: 1000, 0 for no limit)\n"
+         << "  --slow-threads N  threads checking those files with blocking reads (default: 2)\n"
+         << "  --stdin           read paths from stdin, one per line, checking them as they arrive\n"
+         << "  -0, --null        stdin paths are NUL-terminated (find -print0); implies --stdin\n"
+         << "  --tar ARCHIVE     check each member of a tar archive (- reads the stream from stdin)\n"
+         << "  --deep            batch mode: also scan whole files for embedded signatures (FOUND lines)\n"
+         << "  --deep-min N      shortest signature, in bytes, the deep scan reports (default: 4)\n"
+         << "  --classify        label files no signature explains as text, binary, compressed or encrypted\n"
+         << "  --classify-bytes N  bytes from the start of the file the label is based on (default: 4096)\n"
+         << "  --watch           watch the directory trees given for files written and closed, until SIGINT or SIGTERM\n"
+         << "  --watch-backend B auto, fanotify (needs CAP_SYS_ADMIN) or inotify (default: auto)\n"
+         << "  --watch-debounce MS  check a file once it has been quiet this long (default: 20)\n"
+         << "  --watch-backlog N most files waiting to be checked before events are dropped (default: 65536)\n"
+         << "  --cache FILE      batch mode: reuse results for files unchanged since the last run\n"
+         << "  --shard I/N       batch mode: check only the I-th (from 0) of N disjoint slices of the paths\n"
+         << "  --shard-by path|dir  slice by file path, or keep each directory's files together (default: path)\n"
+         << "  --results FILE    batch mode: also write the results, sorted by path, for --merge\n"
+         << "  --report FILE     batch mode: write aggregate counts to FILE instead of a line and log entry per file\n"
+         << "  --report-format F csv or json (default: json, or csv for a FILE ending in .csv)\n"
+         << "  --report-top N    directories with the most mismatches listed in the report (default: 20)\n"
+         << "  --report-mismatches  in report mode, still log each mismatch (and only mismatches)\n"
+         << "  --metrics FILE    append per-stage latency and counter snapshots as JSON lines (- for stderr)\n"
+         << "  --metrics-interval S  also write a snapshot every S seconds (SIGUSR1 writes one any time)\n"
+         << "  --socket-mode M   permissions of the --serve socket, in octal (default: 600, owner only)\n"
+         << "  --log-file FILE   where results are logged (default: log.txt)\n"
+         << "  --log-format F    text, jsonl or binary (default: text)\n"
+         << "  --log-max-bytes N rotate the log when it would grow past N bytes (default: never)\n"
+         << "  --log-keep N      rotated logs kept as FILE.1 ... FILE.N (default: 5)\n"
+         << "  --no-art          leave the ASCII art out of text logs" << endl;
 }
 
-string getFileExtension(const string& filePath) {
-    size_t lastDot = filePath.find_last_of('.');
-    if (lastDot == string::npos) {
-        return ""; // No extension found
-    }
-    cout << "File extension found: " << filePath.substr(lastDot + 1) << endl;
-    return filePath.substr(lastDot + 1);
+// Utility function: Parse a numeric option value (see parseOptionNumber). On a bad value
+// print it with the usage text and return false
+template <typename T>
+bool parseNumber(const char* program, const string& option, const string& text, T& value, int base = 10) {
+    if (parseOptionNumber(text, value, base))
+        return true;
+    cerr << "Bad value for " << option << ": " << text << endl;
+    printUsage(program);
+    return false;
+}
+
+// Which database cached results belong to: the database file's contents, or for the
+// embedded index the compiled-in table
+template <typename Index>
+uint64_t cacheFingerprint(const Index&, const Options& options) {
+    return databaseFingerprint(options.databasePath);
+}
+
+uint64_t cacheFingerprint(const EmbeddedIndex& index, const Options&) {
+    return index.fingerprint();
 }
 
-string getFileSignature(const string& filePath, size_t length) {
-    ifstream file(filePath, ios::binary);
-    if (!file) {
-        cerr << "Error opening file: " << filePath << endl;
-        return "";
+// Batch mode: one signature index shared by a pool of workers
+template <typename Index>
+int runBatch(const Index& index, const SignatureTrie& reverse, const Options& options) {
+    AsyncLogger logger(options.log);
+    if (!logger.ok()) {
+        cerr << "Error opening log file." << endl;
+        return 1;
     }
 
-    // Calculate the number of bytes to read (length is in hex digits, so divide by 2)
-    size_t bytesToRead = (length + 1) / 2; // Round up if length is odd
+    vector<string> paths;
+    if (!options.streamInput) {
+        collectPaths(options.inputs, paths);
+        if (options.shard.count > 1) {
+            paths.erase(remove_if(paths.begin(), paths.end(),
+                                  [&](const string& path) { return !options.shard.contains(path); }),
+                        paths.end());
+        }
+    }
 
-    // Check if the file is smaller than the requested number of bytes
-    file.seekg(0, ios::end);
-    size_t fileSize = file.tellg();
-    if (fileSize < bytesToRead) {
-        cerr << "File is smaller than the requested length." << endl;
-        return "";
+    // Without a usable cache every file is simply read
+    ResultCache cache;
+    if (!options.cachePath.empty()) {
+        string error;
+        if (!cache.open(options.cachePath, cacheFingerprint(index, options), paths.size(), error)) {
+            cerr << error << " (continuing without the cache)" << endl;
+        }
     }
 
-    // Move the file pointer back to the beginning
-    file.seekg(0, ios::beg);
+    DeepScanner deep;
+    if (options.deepScan) {
+        deep.build(reverse, options.deepMinLength);
+    }
 
-    // Read the specified number of bytes from the file
-    string signature(bytesToRead, '\0');
-    file.read(&signature[0], bytesToRead);
-    if (!file) {
-        cerr << "Error reading file: " << filePath << endl;
-        return "";
+    unique_ptr<ResultFileWriter> results;
+    if (!options.resultsPath.empty()) {
+        results = make_unique<ResultFileWriter>(options.resultsPath, options.shard);
+    }
+    unique_ptr<ScanReport> report;
+    if (!options.report.path.empty()) {
+        report = make_unique<ScanReport>(index.extensionResolver().extensions(), options.report);
     }
 
-    // Convert the bytes to a hex string
-    stringstream hexSignature;
-    for (unsigned char c : signature) {
-        hexSignature << std::setw(2) << std::setfill('0') << std::hex << std::uppercase << static_cast<int>(c);
+    size_t threads = options.threads == 0 ? 1 : options.threads;
+    BatchScanner<Index> scanner(index, &reverse, threads, options.backend, options.batchSize,
+                                cache.isOpen() ? &cache : nullptr, options.deepScan ? &deep : nullptr,
+                                options.contentBytes, results.get(), report.get(), options.ioDeadline, options.slowThreads);
+    BatchStats stats = options.streamInput ? scanner.runStream(STDIN_FILENO, options.delimiter, cout, logger, options.shard)
+                                           : scanner.run(paths, cout, logger);
+    cache.close();
+    logger.close();
+    bool ok = logger.ok();
+    string error;
+    if (results && !results->close(error)) {
+        cerr << error << endl;
+        ok = false;
+    }
+    if (report && !report->write(error)) {
+        cerr << error << endl;
+        ok = false;
+    }
+    printBatchStats(cerr, stats, threads);
+    return ok ? 0 : 1;
+}
+
+// Tar mode: one pass over the archive, reporting each member as if it were a file
+template <typename Index>
+int runTar(const Index& index, const SignatureTrie& reverse, const Options& options) {
+    AsyncLogger logger(options.log);
+    if (!logger.ok()) {
+        cerr << "Error opening log file." << endl;
+        return 1;
     }
 
-    // Close the file
-    file.close();
+    bool fromStdin = options.tarPath == "-";
+    int fd = fromStdin ? STDIN_FILENO : ::open(options.tarPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        cerr << "Error opening archive: " << options.tarPath << " (" << strerror(errno) << ")" << endl;
+        return 1;
+    }
 
-    // Return the hex signature
-    return hexSignature.str();
+    // Members of a named archive are reported as archive:member
+    TarScanner<Index> scanner(index, &reverse);
+    BatchStats stats;
+    string error;
+    bool ok = scanner.run(fd, fromStdin ? string() : options.tarPath + ":", cout, logger, stats, error);
+    if (!fromStdin) {
+        ::close(fd);
+    }
+    logger.close();
+    if (!ok) {
+        cerr << error << endl;
+    }
+    cerr << "Checked " << stats.files << " tar members in " << fixed << setprecision(3) << stats.seconds << " s" << endl;
+    cerr << "  matches: " << stats.matches << ", mismatches: " << stats.mismatches
+         << ", unknown extensions: " << stats.unknown << ", read errors: " << stats.errors << endl;
+    return ok && logger.ok() ? 0 : 1;
 }
 
-void LoadFileSignatures(RedBlackTree<string>& tree, const string& filePath) {
-    ifstream file(filePath);
-    if (!file) {
-        cerr << "Error opening file: " << filePath << endl;
-        return;
+// Write end of the running watch's stop pipe, for the signal handler
+static int watchStopFd = -1;
+
+void handleWatchSignal(int) {
+    if (watchStopFd >= 0) {
+        char byte = 0;
+        ssize_t ignored = write(watchStopFd, &byte, 1);
+        (void)ignored;
     }
+}
 
-    string line;
-    while (getline(file, line)) {
-        size_t firstComma = line.find(',');
-        size_t secondComma = line.find(',', firstComma + 1);
+// Watch mode: check files under the trees as soon as their writers close them, until SIGINT or
+// SIGTERM. The watcher thread debounces events into batches; the workers check them as in
+// batch mode, so output, log, cache and content labels all behave the same.
+template <typename Index>
+int runWatch(const Index& index, const SignatureTrie& reverse, const Options& options) {
+    AsyncLogger logger(options.log);
+    if (!logger.ok()) {
+        cerr << "Error opening log file." << endl;
+        return 1;
+    }
 
-        if (firstComma != string::npos && secondComma != string::npos) {
-            // Extract the extension, file signature, and length
-            string extension = line.substr(0, firstComma);
-            string signature = line.substr(firstComma + 1, secondComma - firstComma - 1);
-            size_t length = stoi(line.substr(secondComma + 1));
+    DirectoryWatcher watcher;
+    string error;
+    if (!watcher.start(options.inputs, options.watching, error)) {
+        cerr << error << endl;
+        return 1;
+    }
 
-            // Insert the data into the Red-Black Tree
-            tree.insert(signature, extension, length);
-        } else {
-            cerr << "Invalid line format: " << line << endl;
-        }
+    ResultCache cache;
+    if (!options.cachePath.empty() && !cache.open(options.cachePath, cacheFingerprint(index, options), 0, error)) {
+        cerr << error << " (continuing without the cache)" << endl;
+    }
+    DeepScanner deep;
+    if (options.deepScan) {
+        deep.build(reverse, options.deepMinLength);
+    }
+    unique_ptr<ResultFileWriter> results;
+    if (!options.resultsPath.empty()) {
+        results = make_unique<ResultFileWriter>(options.resultsPath, options.shard);
     }
 
-    file.close();
+    size_t threads = options.threads == 0 ? 1 : options.threads;
+    BatchScanner<Index> scanner(index, &reverse, threads, options.backend, options.batchSize,
+                                cache.isOpen() ? &cache : nullptr, options.deepScan ? &deep : nullptr,
+                                options.contentBytes, results.get(), nullptr, options.ioDeadline, options.slowThreads);
+    BoundedQueue<vector<string>> batches(threads * 2);
+    atomic<bool> done(false);
+
+    watchStopFd = watcher.stopDescriptor();
+    signal(SIGINT, handleWatchSignal);
+    signal(SIGTERM, handleWatchSignal);
+    const WatchStats& seen = watcher.stats();
+    cerr << "Watching " << options.inputs.size() << " trees with " << watchBackendName(watcher.backend());
+    if (watcher.backend() == WATCH_INOTIFY) {
+        cerr << " (" << seen.directories << " directories)";
+    }
+    cerr << endl;
+
+    // Idle workers sleep in the queue until the watcher hands them a batch, so a quiet watch costs no CPU
+    thread events([&]() { watcher.run(batches, options.batchSize == 0 ? 1 : options.batchSize, done); });
+    BatchStats stats = scanner.runBatches(batches, done, cout, logger);
+    events.join();
+    watchStopFd = -1;
+
+    cache.close();
+    logger.close();
+    bool ok = logger.ok();
+    if (results && !results->close(error)) {
+        cerr << error << endl;
+        ok = false;
+    }
+    printBatchStats(cerr, stats, threads);
+    cerr << "  watch: " << seen.events << " events, " << seen.coalesced << " coalesced, " << seen.dropped
+         << " dropped for a full backlog, " << seen.overflows << " kernel queue overflows" << endl;
+    return ok ? 0 : 1;
 }
 
-int main() {
-    RedBlackTree<string> tree;
-    LoadFileSignatures(tree, "FileSignature.txt");
+// Write ends of the running server's stop and reload pipes, for the signal handler
+static int serverStopFd = -1;
+static int serverReloadFd = -1;
 
-    // Open the log file in append mode
-    ofstream logFile("log.txt", ios::app);
-    if (!logFile) {
+void handleServerSignal(int signal) {
+    int fd = signal == SIGHUP ? serverReloadFd : serverStopFd;
+    if (fd >= 0) {
+        char byte = 0;
+        ssize_t ignored = write(fd, &byte, 1);
+        (void)ignored;
+    }
+}
+
+// Write end of the metrics reporter's pipe, for SIGUSR1
+static int metricsDumpFd = -1;
+
+void handleMetricsSignal(int) {
+    if (metricsDumpFd >= 0) {
+        char byte = 'd';
+        ssize_t ignored = write(metricsDumpFd, &byte, 1);
+        (void)ignored;
+    }
+}
+
+// Server mode: keep the database loaded and answer requests until SIGINT or SIGTERM.
+// SIGHUP reloads the database; requests keep being answered while the new one is built.
+template <typename Index>
+int runServer(const Options& options) {
+    SignatureStore<Index> store;
+    string error;
+    if (!store.reload(options.databasePath, error)) {
+        cerr << error << endl;
+        return 1;
+    }
+
+    AsyncLogger logger(options.log);
+    if (!logger.ok()) {
         cerr << "Error opening log file." << endl;
         return 1;
     }
 
-    string filePath;
-    cout << "Enter the file path: ";
-    cin >> filePath;
+    size_t threads = options.threads == 0 ? 1 : options.threads;
+    CheckServer<Index> server(store, &logger, threads);
+    if (!server.listen(options.serveSocket, error, options.socketMode)) {
+        cerr << error << endl;
+        return 1;
+    }
+    int reloadPipe[2];
+    if (pipe2(reloadPipe, O_CLOEXEC) < 0) {
+        cerr << "Error creating pipe: " << strerror(errno) << endl;
+        return 1;
+    }
 
-    // Log the file path
-    logFile << "File path entered: " << filePath << endl;
+    // Reloads run on their own thread so the accepting thread and the workers never wait for them
+    atomic<bool> stopping(false);
+    thread reloader([&]() {
+        char byte;
+        while (true) {
+            ssize_t n = read(reloadPipe[0], &byte, 1);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0 || stopping)
+                break;
+            string reloadError;
+            if (store.reload(options.databasePath, reloadError))
+                cerr << "Reloaded " << options.databasePath << " (version " << store.version() << ")" << endl;
+            else
+                cerr << reloadError << " (keeping version " << store.version() << ")" << endl;
+        }
+    });
 
-    string extension = trim(getFileExtension(filePath));
-    logFile << "Extracted file extension: " << extension << endl;
+    serverStopFd = server.stopDescriptor();
+    serverReloadFd = reloadPipe[1];
+    signal(SIGINT, handleServerSignal);
+    signal(SIGTERM, handleServerSignal);
+    signal(SIGHUP, handleServerSignal);
+    signal(SIGPIPE, SIG_IGN);
 
-    bool isMatch = false; // The file signature to search for
-    size_t length = 0;
-    vector<string> signatures; // To store all associated extensions
+    cerr << "Listening on " << options.serveSocket << " with " << threads << " workers" << endl;
+    server.run();
 
-    if (tree.search(extension, signatures, length)) {
-        string fileSignature = getFileSignature(filePath, length);
-        logFile << "Extracted file signature: " << fileSignature << endl;
+    serverStopFd = -1;
+    serverReloadFd = -1;
+    stopping = true;
+    close(reloadPipe[1]);
+    reloader.join();
+    close(reloadPipe[0]);
+    unlink(options.serveSocket.c_str());
+    logger.close();
+    cerr << "Answered " << server.requestsServed() << " requests" << endl;
+    return logger.ok() ? 0 : 1;
+}
 
-        // Check if the file signature matches any in the database
-        for (string element : signatures) {
-            if (element == fileSignature) {
-                isMatch = true;
-                break;
-            }
+// Client mode: send paths to a running server and print its answers
+int runClient(const Options& options) {
+    CheckClient client;
+    string error;
+    if (!client.connect(options.connectSocket, error)) {
+        cerr << error << endl;
+        return 1;
+    }
+
+    vector<string> paths = options.inputs;
+    if (paths.empty()) {
+        string line;
+        while (getline(cin, line)) {
+            if (!line.empty())
+                paths.push_back(line);
         }
+    }
+
+    string output;
+    bool ok = client.checkAll(paths, [&](const string& line) {
+        output += line;
+        output += '\n';
+        if (output.size() >= 64 * 1024) {
+            cout << output;
+            output.clear();
+        }
+    });
+    cout << output << flush;
+    if (!ok) {
+        cerr << "Connection to " << options.connectSocket << " lost" << endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Merge mode: combine the result files of a sharded scan into one report
+int runMerge(const Options& options) {
+    if (options.inputs.empty()) {
+        cerr << "--merge needs the result files to merge" << endl;
+        return 1;
+    }
+    return mergeResultFiles(options.inputs, options.resultsPath, cout, cerr) ? 0 : 1;
+}
+
+// Interactive mode: check one path read from stdin
+template <typename Index>
+int runInteractive(const Index& index, const SignatureTrie& reverse, const Options& options) {
+    // Open the log file in append mode
+    AsyncLogger logger(options.log);
+    if (!logger.ok()) {
+        cerr << "Error opening log file." << endl;
+        return 1;
+    }
 
-        if (isMatch) {
+    // The whole line is the path, spaces included
+    string filePath;
+    cout << "Enter the file path: ";
+    getline(cin, filePath);
+    if (!filePath.empty() && filePath.back() == '\r') {
+        filePath.pop_back();
+    }
+
+    CheckResult result = checkFile(index, filePath, &reverse);
+    vector<unsigned char> contentBuffer;
+    classifyUnmatched(result, contentBuffer, options.contentBytes);
+    recordCheck(result);
+    if (result.verdict == READ_ERROR) {
+        cerr << "Error reading file: " << filePath << " (" << readErrorText(result.error) << ")" << endl;
+    }
+    cout << "File extension found: " << result.extension << endl;
+
+    if (result.verdict != UNKNOWN_EXTENSION) {
+        if (result.verdict == MATCH) {
             cout << "File signature matches the expected signature." << endl;
-            logFile << "Result: File signature matches the expected signature." << endl;
         } else {
             cout << "File signature does not match the expected signature." << endl;
-            logFile << "Result: Uh oh File signature does not match the expected signature." << endl;
-            logFile << "                                .--.__\n"
-                    << "                                                      .~ (@)  ~~~---_\n"
-                    << "                                                     {     `-_~,,,,,,)\n"
-                    << "                                                     {    (_  ',\n"
-                    << "                                                      ~    . = _',\n"
-                    << "                                                       ~-   '.  =-'\n"
-                    << "                                                         ~     :\n"
-                    << "      .                                             _,.-~     ('');\n"
-                    << "      '.                                         .-~        \\  \\ ;\n"
-                    << "        ':-_                                _.--~            \\  \\;      _-=,.\n"
-                    << "          ~-:-.__                       _.-~                 {  '---- _'-=,.\n"
-                    << "             ~-._~--._             __.-~                     ~---------=,.`\n"
-                    << "                 ~~-._~~-----~~~~~~       .+++~~~~~~~~-__   /\\\n"
-                    << "                      ~-.,____           {   -     +   }  _/\\\n"
-                    << "                              ~~-.______{_    _ -=\\ / /_.~\\\n"
-                    << "                                   :      ~--~    // /         ..-\\\n"
-                    << "                                   :   / /      // /         ((\\\n"
-                    << "                                   :  / /      {   `-------,. ))\n"
-                    << "                                   :   /        ''=--------. }o\n"
-                    << "                      .=._________,\\'  )                     ))\n"
-                    << "                      )  _________ -''                     ~~\n"
-                    << "                     / /  _ _\n"
-                    << "                    (_.-.'O'-'.\n";
+            if (!result.detectedTypes.empty()) {
+                cout << "File appears to actually be: ";
+                for (const auto& type : result.detectedTypes) {
+                    cout << type << " ";
+                }
+                cout << endl;
+            }
         }
 
         // Print all associated signatures
         cout << "All Associated signatures: ";
-        logFile << "All Associated signatures: ";
-        for (const auto& ext : signatures) {
-            cout << ext << " ";
-            logFile << ext << " ";
+        for (const auto& expected : result.expected) {
+            cout << expected.toHex() << " ";
         }
         cout << endl;
-        logFile << endl;
 
-        cout << "Current signature: " << fileSignature << endl;
-        logFile << "Current signature: " << fileSignature << endl;
+        cout << "Current signature: " << result.signatureHex() << endl;
     } else {
+        cout << "Extension not found: " << result.extension << endl;
         cout << "No matching file signature found in the database." << endl;
-        logFile << "Result: No matching file signature found in the database." << endl;
     }
-    logFile << "----------------------------------------" << endl;
+    if (result.content != CONTENT_NONE) {
+        cout << "Content looks like: " << contentName(result.content) << endl;
+    }
+
+    {
+        StageTimer logTimer(STAGE_LOG);
+        logger.log(result);
+    }
     // Close the log file
-    logFile.close();
+    logger.close();
 
     return 0;
 }
 
+template <typename Index>
+int runChecker(const Index& index, const SignatureTrie& reverse, const Options& options) {
+    if (!options.tarPath.empty()) {
+        return runTar(index, reverse, options);
+    }
+    if (options.watch) {
+        return runWatch(index, reverse, options);
+    }
+    if (!options.inputs.empty() || options.streamInput) {
+        return runBatch(index, reverse, options);
+    }
+    return runInteractive(index, reverse, options);
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    bool reportFormatGiven = false;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--compile-db" && i + 2 < argc) {
+            string error;
+            if (!compileSignatureDatabase(argv[i + 1], argv[i + 2], error)) {
+                cerr << error << endl;
+                return 1;
+            }
+            cout << "Compiled " << argv[i + 1] << " into " << argv[i + 2] << endl;
+            return 0;
+        } else if (arg == "--embed-db" && i + 2 < argc) {
+            string error;
+            if (!generateEmbeddedTable(argv[i + 1], argv[i + 2], "EMBEDDED_SIGNATURES", error)) {
+                cerr << error << endl;
+                return 1;
+            }
+            cout << "Generated " << argv[i + 2] << " from " << argv[i + 1] << "; rebuild to embed it" << endl;
+            return 0;
+        } else if (arg == "--db" && i + 1 < argc) {
+            options.databasePath = argv[++i];
+        } else if (arg == "--index" && i + 1 < argc) {
+            string name = argv[++i];
+            if (name == "tree") {
+                options.index = INDEX_TREE;
+            } else if (name == "flat") {
+                options.index = INDEX_FLAT;
+            } else if (name == "embedded") {
+                options.index = INDEX_EMBEDDED;
+            } else {
+                cerr << "Unknown index: " << name << endl;
+                return 1;
+            }
+        } else if ((arg == "-j" || arg == "--threads") && i + 1 < argc) {
+            if (!parseNumber(argv[0], arg, argv[++i], options.threads)) return 1;
+        } else if (arg == "--io" && i + 1 < argc) {
+            string name = argv[++i];
+            if (name != "uring" && name != "pread") {
+                cerr << "Unknown I/O backend: " << name << endl;
+                return 1;
+            }
+            options.backend = name == "uring" ? HeaderReader::IO_URING : HeaderReader::PREAD;
+        } else if (arg == "--batch" && i + 1 < argc) {
+            if (!parseNumber(argv[0], arg, argv[++i], options.batchSize)) return 1;
+        } else if (arg == "--io-deadline" && i + 1 < argc) {
+            if (!parseNumber(argv[0], arg, argv[++i], options.ioDeadline)) return 1;
+        } else if (arg == "--slow-threads" && i + 1 < argc) {
+            if (!parseNumber(argv[0], arg, argv[++i], options.slowThreads)) return 1;
+        } else if (arg == "--stdin") {
+            options.streamInput = true;
+        } else if (arg == "-0" || arg == "--null") {
+            options.streamInput = true;
+            options.delimiter = '\0';
+        } else if (arg == "--tar" && i + 1 < argc) {
+            options.tarPath = argv[++i];
+        } else if (arg == "--deep") {
+            options.deepScan = true;
+        } else if (arg == "--deep-min" && i + 1 < argc) {
+            if (!parseNumber(argv[0], arg, argv[++i], options.deepMinLength)) return 1;
+        } else if (arg == "--classify") {
+            if (options.contentBytes == 0) {
+                options.contentBytes = CONTENT_SAMPLE;
+            }
+        } else if (arg == "--classify-bytes" && i + 1 < argc) {
+            if (!parseNumber(argv[0], arg, argv[++i], options.contentBytes)) return 1;
+        } else if (arg == "--shard" && i + 1 < argc) {
+            string spec = argv[++i];
+            if (!options.shard.parse(spec)) {
+                cerr << "Bad shard: " << spec << " (expected I/N with 0 <= I < N)" << endl;
+                return 1;
+            }
+        } else if (arg == "--shard-by" && i + 1 < argc) {
+            string name = argv[++i];
+            if (name != "path" && name != "dir") {
+                cerr << "Unknown shard key: " << name << endl;
+                return 1;
+            }
+            options.shard.byDirectory = name == "dir";
+        } else if (arg == "--results" && i + 1 < argc) {
+            options.resultsPath = argv[++i];
+        } else if (arg == "--merge") {
+            options.merge = true;
+        } else if (arg == "--watch") {
+            options.watch = true;
+        } else if (arg == "--watch-backend" && i + 1 < argc) {
+            string name = argv[++i];
+            if (name == "auto") {
+                options.watching.backend = WATCH_AUTO;
+            } else if (name == "fanotify") {
+                options.watching.backend = WATCH_FANOTIFY;
+            } else if (name == "inotify") {
+                options.watching.backend = WATCH_INOTIFY;
+            } else {
+                cerr << "Unknown watch backend: " << name << endl;
+                return 1;
+            }
+        } else if (arg == "--watch-debounce" && i + 1 < argc) {
+            if (!parseNumber(argv[0], arg, argv[++i], options.watching.debounceMs)) return 1;
+        } else if (arg == "--watch-backlog" && i + 1 < argc) {
+            if (!parseNumber(argv[0], arg, argv[++i], options.watching.backlog)) return 1;
+        } else if (arg == "--report" && i + 1 < argc) {
+            options.report.path = argv[++i];
+            if (!reportFormatGiven) {
+                size_t length = options.report.path.size();
+                bool csv = length >= 4 && options.report.path.compare(length - 4, 4, ".csv") == 0;
+                options.report.format = csv ? REPORT_CSV : REPORT_JSON;
+            }
+        } else if (arg == "--report-format" && i + 1 < argc) {
+            string name = argv[++i];
+            if (name != "csv" && name != "json") {
+                cerr << "Unknown report format: " << name << endl;
+                return 1;
+            }
+            options.report.format = name == "csv" ? REPORT_CSV : REPORT_JSON;
+            reportFormatGiven = true;
+        } else if (arg == "--report-top" && i + 1 < argc) {
+            if (!parseNumber(argv[0], arg, argv[++i], options.report.topDirectories)) return 1;
+        } else if (arg == "--report-mismatches") {
+            options.reportMismatches = true;
+        } else if (arg == "--cache" && i + 1 < argc) {
+            options.cachePath = argv[++i];
+        } else if (arg == "--metrics" && i + 1 < argc) {
+            options.metricsPath = argv[++i];
+        } else if (arg == "--metrics-interval" && i + 1 < argc) {
+            if (!parseNumber(argv[0], arg, argv[++i], options.metricsInterval)) return 1;
+        } else if (arg == "--log-file" && i + 1 < argc) {
+            options.log.path = argv[++i];
+        } else if (arg == "--log-format" && i + 1 < argc) {
+            string name = argv[++i];
+            if (name == "text") {
+                options.log.format = LOG_TEXT;
+            } else if (name == "jsonl") {
+                options.log.format = LOG_JSONL;
+            } else if (name == "binary") {
+                options.log.format = LOG_BINARY;
+            } else {
+                cerr << "Unknown log format: " << name << endl;
+                return 1;
+            }
+        } else if (arg == "--log-max-bytes" && i + 1 < argc) {
+            if (!parseNumber(argv[0], arg, argv[++i], options.log.maxBytes)) return 1;
+        } else if (arg == "--log-keep" && i + 1 < argc) {
+            if (!parseNumber(argv[0], arg, argv[++i], options.log.keepFiles)) return 1;
+        } else if (arg == "--serve" && i + 1 < argc) {
+            options.serveSocket = argv[++i];
+        } else if (arg == "--socket-mode" && i + 1 < argc) {
+            if (!parseNumber(argv[0], arg, argv[++i], options.socketMode, 8)) return 1;
+            if (options.socketMode > 0777) {
+                cerr << "Bad socket mode: " << argv[i] << " (expected octal permissions, e.g. 660)" << endl;
+                return 1;
+            }
+        } else if (arg == "--connect" && i + 1 < argc) {
+            options.connectSocket = argv[++i];
+        } else if (arg == "--no-art") {
+            options.log.decorative = false;
+        } else if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (!arg.empty() && arg[0] == '-') {
+            cerr << "Unknown option: " << arg << endl;
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            options.inputs.push_back(arg);
+        }
+    }
+
+    if (options.streamInput && !options.inputs.empty()) {
+        cerr << "--stdin reads paths from stdin and takes none on the command line" << endl;
+        return 1;
+    }
+    if (!options.tarPath.empty() && (options.streamInput || !options.inputs.empty())) {
+        cerr << "--tar checks one archive and takes no other paths" << endl;
+        return 1;
+    }
+
+    if (options.watch && (options.inputs.empty() || options.streamInput || !options.tarPath.empty())) {
+        cerr << "--watch takes the directories to watch and no other input" << endl;
+        return 1;
+    }
+    if (!options.report.path.empty()) {
+        if (options.watch || options.merge || !options.tarPath.empty() || !options.serveSocket.empty()
+            || !options.connectSocket.empty() || (options.inputs.empty() && !options.streamInput)) {
+            cerr << "--report applies to batch mode" << endl;
+            return 1;
+        }
+        // Per-file detail, if wanted at all, is limited to mismatches
+        options.log.enabled = options.reportMismatches;
+        options.log.mismatchesOnly = true;
+    }
+    if (options.watch && options.shard.count > 1) {
+        cerr << "--shard applies to batch mode" << endl;
+        return 1;
+    }
+    if ((options.shard.count > 1 || !options.resultsPath.empty()) && !options.merge
+        && (!options.tarPath.empty() || !options.serveSocket.empty() || !options.connectSocket.empty())) {
+        cerr << "--shard and --results apply to batch mode" << endl;
+        return 1;
+    }
+
+    // Neither the client nor a merge needs a database; the server has it loaded already
+    if (options.merge) {
+        return runMerge(options);
+    }
+    if (!options.connectSocket.empty()) {
+        return runClient(options);
+    }
+
+    // Snapshots are written until main returns; the reporter's destructor writes the last one
+    unique_ptr<MetricsReporter> metrics;
+    if (!options.metricsPath.empty()) {
+        if (!FILECHECKER_METRICS) {
+            cerr << "Built without metrics (FILECHECKER_METRICS=0); --metrics writes empty snapshots" << endl;
+        }
+        metrics = make_unique<MetricsReporter>(options.metricsPath, options.metricsInterval);
+        string error;
+        if (!metrics->start(error)) {
+            cerr << error << endl;
+            return 1;
+        }
+        metricsDumpFd = metrics->dumpDescriptor();
+        signal(SIGUSR1, handleMetricsSignal);
+    }
+
+    // The server loads the database itself so it can reload it later
+    if (!options.serveSocket.empty()) {
+        if (options.index == INDEX_EMBEDDED) {
+            return runServer<EmbeddedIndex>(options);
+        }
+        if (isCompiledSignatureDatabase(options.databasePath)) {
+            return runServer<SignatureDatabase>(options);
+        }
+        if (options.index == INDEX_FLAT) {
+            return runServer<FlatSignatureIndex>(options);
+        }
+        return runServer<RedBlackTree<ByteSignature>>(options);
+    }
+
+    SignatureTrie reverse;
+
+    // The embedded table needs no loading; only the reverse trie is built from it
+    if (options.index == INDEX_EMBEDDED) {
+        EmbeddedIndex index;
+        index.buildReverseIndex(reverse);
+        return runChecker(index, reverse, options);
+    }
+
+    // A compiled database is mapped and used in place; the CSV is parsed into the tree
+    if (isCompiledSignatureDatabase(options.databasePath)) {
+        SignatureDatabase database;
+        string error;
+        if (!database.open(options.databasePath, error)) {
+            cerr << error << endl;
+            return 1;
+        }
+        database.buildReverseIndex(reverse);
+        return runChecker(database, reverse, options);
+    }
+
+    if (options.index == INDEX_FLAT) {
+        FlatSignatureIndex index;
+        LoadFileSignatures(index, &reverse, options.databasePath);
+        return runChecker(index, reverse, options);
+    }
+
+    RedBlackTree<ByteSignature> tree;
+    LoadFileSignatures(tree, &reverse, options.databasePath);
+    return runChecker(tree, reverse, options);
+}
+
 
 /*To do:
 get file extension as well as hex signature and compare to data base. If hex code is found compare each extension type to current file extension and identify if it is mistmatched or not.*/
-
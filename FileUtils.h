@@ -0,0 +1,476 @@
+// Helpers shared by the interactive checker and the batch scanner
+#ifndef FILE_UTILS_H
+#define FILE_UTILS_H
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+#include "ContentClassifier.h"
+#include "FileBase.h"
+#include "HeaderReader.h"
+#include "Metrics.h"
+#include "Signature.h"
+#include "SignatureTrie.h"
+#include "ZipInspector.h"
+
+using namespace std;
+
+// Outcome of checking a single file against the signature database
+enum Verdict { MATCH, MISMATCH, UNKNOWN_EXTENSION, READ_ERROR };
+
+// Time spent on each step of a check, in nanoseconds
+struct CheckTimings {
+    uint32_t lookupNs = 0; // Extension parsing and index lookup
+    uint32_t readNs = 0;   // Header and follow-up reads (with io_uring, each chunk's wait for this file)
+    uint32_t matchNs = 0;  // Signature comparison and reverse lookup
+};
+
+// Nanoseconds as CheckTimings keeps them: past about 4.3 s they saturate rather than wrap
+inline uint32_t timingNs(uint64_t ns) {
+    return static_cast<uint32_t>(min<uint64_t>(ns, UINT32_MAX));
+}
+
+// Monotonic clock in nanoseconds, for the timings above
+inline uint64_t monotonicNanos() {
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Everything we learned about one file, used for console output and log.txt
+struct CheckResult {
+    string path;                       // Path as given by the user or found while walking
+    string extension;                  // Extension taken from the path
+    FileHeader header;                 // Raw bytes read from the file (the planned ranges)
+    SignatureSpan expected;            // Signatures registered for the extension (owned by the index)
+    vector<string> detectedTypes;      // On a mismatch, what the header says the file really is
+    Verdict verdict = UNKNOWN_EXTENSION;
+    int error = 0;                     // errno of a failed read (READ_ERROR)
+    ContainerType container = CONTAINER_NONE; // What a ZIP-based file holds, from its member names
+    ContentClass content = CONTENT_NONE;      // For files no signature explains, what the bytes look like
+    CheckTimings timings;
+
+    // Hex of the header bytes compared against the extension, only built when logging.
+    // Bytes read at other offsets follow as "@offset:hex".
+    string signatureHex() const
+    {
+        string hex = encodeHex(header.bytes, min(expected.maxLength, header.size));
+        for (const ByteSignature* it = expected.begin(); it != expected.end(); ++it) {
+            bool seen = it->offset == 0;
+            for (const ByteSignature* before = expected.begin(); before != it && !seen; ++before)
+                seen = before->offset == it->offset;
+            size_t available = 0;
+            const unsigned char* data = header.at(it->offset, available);
+            if (seen || data == nullptr)
+                continue;
+            if (!hex.empty())
+                hex += " ";
+            hex += "@" + to_string(it->offset) + ":" + encodeHex(data, min<size_t>(it->length, available));
+        }
+        return hex;
+    }
+};
+
+inline string trim(const string& str) {
+  size_t first = str.find_first_not_of(" \t\n\r");
+  size_t last = str.find_last_not_of(" \t\n\r");
+  if (first == string::npos || last == string::npos) {
+      return ""; // String is all whitespace
+  }
+  return str.substr(first, last - first + 1);
+}
+
+// Parse one "extension,signature,length[,offset]" row of FileSignature.txt. The length column
+// is informational; the decoded signature carries its own length. The optional offset (decimal
+// or 0x hex) says where in the file the signature sits and defaults to 0.
+inline bool parseSignatureLine(const string& line, string& extension, ByteSignature& signature) {
+    size_t firstComma = line.find(',');
+    size_t secondComma = line.find(',', firstComma + 1);
+    if (firstComma == string::npos || secondComma == string::npos) {
+        return false;
+    }
+    extension = trim(line.substr(0, firstComma));
+    string hex = trim(line.substr(firstComma + 1, secondComma - firstComma - 1));
+
+    uint32_t offset = 0;
+    size_t thirdComma = line.find(',', secondComma + 1);
+    if (thirdComma != string::npos) {
+        string field = trim(line.substr(thirdComma + 1));
+        char* end = nullptr;
+        unsigned long long value = field.empty() ? 0 : strtoull(field.c_str(), &end, 0);
+        if (field.empty() || *end != '\0' || field[0] == '-' || value > UINT32_MAX - MAX_SIGNATURE_BYTES) {
+            return false;
+        }
+        offset = static_cast<uint32_t>(value);
+    }
+    return !extension.empty() && parseSignature(hex, signature, offset);
+}
+
+// Load the database into the extension tree and, if given, the reverse signature trie.
+// Returns false if the file could not be opened.
+inline bool LoadFileSignatures(RedBlackTree<ByteSignature>& tree, SignatureTrie* reverse, const string& filePath) {
+    ifstream file(filePath);
+    if (!file) {
+        cerr << "Error opening file: " << filePath << endl;
+        return false;
+    }
+
+    string line;
+    string extension;
+    ByteSignature signature;
+    while (getline(file, line)) {
+        if (parseSignatureLine(line, extension, signature)) {
+            // Insert the data into the Red-Black Tree; the node length only counts offset 0 signatures
+            tree.insert(signature, extension, signature.offset == 0 ? signature.length : 0);
+
+            if (reverse != nullptr) {
+                reverse->insert(signature.bytes, signature.length, signature.offset, extension);
+            }
+        } else if (!trim(line).empty()) {
+            cerr << "Invalid line format: " << line << endl;
+        }
+    }
+
+    file.close();
+    return true;
+}
+
+inline void LoadFileSignatures(RedBlackTree<ByteSignature>& tree, const string& filePath) {
+    LoadFileSignatures(tree, nullptr, filePath);
+}
+
+// Index lookup for the red-black tree. Every index type used with prepareCheck provides
+// an overload of lookupSignatures that fills a view without copying the signatures.
+inline bool lookupSignatures(const RedBlackTree<ByteSignature>& tree, const string& extension, SignatureSpan& span) {
+    size_t length = 0;
+    const vector<ByteSignature>* signatures = tree.lookup(extension, length);
+    if (signatures == nullptr) {
+        span = SignatureSpan();
+        return false;
+    }
+    span.data = signatures->data();
+    span.size = signatures->size();
+    span.maxLength = length;
+    return true;
+}
+
+// First half of a check: extension lookup. Resets result for this path, plans the reads in
+// result.header and returns how many bytes they cover, or 0 when the extension is unknown and
+// nothing must be read. Only the ranges the extension's signatures occupy are read, merged
+// where they overlap or touch; the reverse index adds the prefix it needs at offset 0.
+template <typename Index>
+size_t prepareCheck(const Index& index, const string& filePath, const SignatureTrie* reverse, CheckResult& result) {
+    result.path = filePath;
+    {
+        StageTimer pathTimer(STAGE_PATH);
+        index.extensionResolver().resolve(filePath, result.extension);
+    }
+    StageTimer lookupTimer(STAGE_LOOKUP);
+    result.header.clearPlan();
+    result.detectedTypes.clear();
+    result.error = 0;
+    result.container = CONTAINER_NONE;
+    result.content = CONTENT_NONE;
+    result.timings = CheckTimings();
+
+    if (!lookupSignatures(index, result.extension, result.expected)) {
+        result.verdict = UNKNOWN_EXTENSION;
+        return 0;
+    }
+
+    planSignatureReads(result.expected, result.header);
+    if (reverse != nullptr) {
+        result.header.planRead(0, static_cast<uint32_t>(reverse->maxSignatureLength()));
+    }
+    return result.header.plannedBytes();
+}
+
+// Does the header start with a ZIP local file, end or spanning record ("PK")?
+inline bool hasZipHeader(const FileHeader& header) {
+    return header.size >= 4 && header.bytes[0] == 'P' && header.bytes[1] == 'K' && header.bytes[2] < 9 && header.bytes[3] < 9;
+}
+
+// Settle a ZIP-based file's format from result.container. The six formats share their
+// signatures, so the header alone cannot tell a .docx from an APK. A match whose archive is
+// positively another format becomes a mismatch; a mismatch names that one format instead of
+// all six. A plain archive with no telltale members, and anything with a .zip name, is left alone.
+inline void applyContainerType(CheckResult& result) {
+    if (result.container == CONTAINER_NONE || result.container == CONTAINER_ZIP)
+        return;
+    const char* name = containerName(result.container);
+    if (result.verdict == MATCH) {
+        if (result.extension != "zip" && result.extension != name) {
+            result.verdict = MISMATCH;
+            result.detectedTypes.assign(1, name);
+        }
+    } else if (result.verdict == MISMATCH) {
+        result.detectedTypes.assign(1, name);
+    }
+}
+
+// Set result.verdict to MATCH or MISMATCH from the header alone, with no further reads
+inline void compareHeader(CheckResult& result) {
+    result.verdict = MISMATCH;
+    uint64_t headerWord = result.header.head();
+    for (const ByteSignature& element : result.expected) {
+        if (element.matches(result.header, headerWord)) {
+            result.verdict = MATCH;
+            break;
+        }
+    }
+}
+
+// First step of finishing a check: the verdict from the header read so far. Returns false
+// when nothing is left to do (no signatures to compare, or the read failed).
+inline bool judgeHeader(CheckResult& result, bool readOk) {
+    if (result.expected.empty()) {
+        result.verdict = UNKNOWN_EXTENSION;
+        return false;
+    }
+    if (!readOk) {
+        result.verdict = READ_ERROR;
+        return false;
+    }
+    compareHeader(result);
+    return true;
+}
+
+// Plan into probe the signatures at other offsets that could name a mismatched file. They
+// were not read up front; mismatches are rare, so they are fetched afterwards rather than
+// widening every read. Returns false if there is nothing more to read.
+inline bool planProbe(const CheckResult& result, const SignatureTrie* reverse, FileHeader& probe) {
+    if (result.verdict != MISMATCH || reverse == nullptr)
+        return false;
+    probe = result.header;
+    return reverse->planOffsets(probe);
+}
+
+// Name a mismatched file by the signatures its header holds
+inline void nameMismatch(CheckResult& result, const SignatureTrie* reverse) {
+    if (result.verdict == MISMATCH && reverse != nullptr)
+        reverse->match(result.header, result.detectedTypes);
+}
+
+// ZIP-based files: a couple of small reads of the central directory say which format it is
+inline bool wantsZipInspection(const CheckResult& result) {
+    bool zipNamed = result.verdict == MATCH && isZipExtension(result.extension);
+    bool zipFound = result.verdict == MISMATCH && !result.detectedTypes.empty() && isZipExtension(result.detectedTypes[0]);
+    return (zipNamed || zipFound) && hasZipHeader(result.header);
+}
+
+// Second half of a check: compare the header already read into result.header, with blocking
+// reads for whatever else it takes
+inline void finishCheck(CheckResult& result, bool readOk, const SignatureTrie* reverse) {
+    if (!judgeHeader(result, readOk))
+        return;
+
+    // Keep the first read if the probe fails
+    FileHeader probe;
+    if (planProbe(result, reverse, probe) && readHeaderPread(result.path.c_str(), probe) == 0)
+        result.header = probe;
+    nameMismatch(result, reverse);
+
+    if (wantsZipInspection(result)) {
+        result.container = inspectZip(result.path.c_str());
+        applyContainerType(result);
+    }
+}
+
+// Check one file: extension lookup, header read and comparison against every known signature.
+// Only reads the index, so it is safe to call from several threads sharing one loaded index.
+// When a reverse index is given, mismatched files are also identified by their header.
+// This form reuses result's buffers, so a long-lived caller checks without allocating.
+template <typename Index>
+void checkFile(const Index& index, const string& filePath, const SignatureTrie* reverse, CheckResult& result) {
+    uint64_t start = monotonicNanos();
+    size_t readLength = prepareCheck(index, filePath, reverse, result);
+    uint64_t looked = monotonicNanos();
+    if (readLength > 0) {
+        result.error = readHeaderPread(filePath.c_str(), result.header);
+    }
+    uint64_t read = monotonicNanos();
+    finishCheck(result, result.error == 0, reverse);
+    result.timings.lookupNs = static_cast<uint32_t>(looked - start);
+    result.timings.readNs = static_cast<uint32_t>(read - looked);
+    result.timings.matchNs = static_cast<uint32_t>(monotonicNanos() - read);
+}
+
+// Did the signatures leave the file unexplained: an unknown extension, or a mismatch the
+// reverse index could not name either?
+inline bool needsContentCheck(const CheckResult& result) {
+    return result.verdict == UNKNOWN_EXTENSION || (result.verdict == MISMATCH && result.detectedTypes.empty());
+}
+
+// Classify an unexplained file from its first sampleBytes bytes (read into buffer)
+inline void classifyUnmatched(CheckResult& result, vector<unsigned char>& buffer, size_t sampleBytes) {
+    if (sampleBytes > 0 && needsContentCheck(result))
+        result.content = classifyFile(result.path.c_str(), buffer, sampleBytes);
+}
+
+// Is the file too short to hold any of its extension's signatures?
+inline bool isShortFile(const CheckResult& result) {
+    for (const ByteSignature& element : result.expected) {
+        size_t available = 0;
+        result.header.at(element.offset, available);
+        if (available >= element.length)
+            return false;
+    }
+    return !result.expected.empty();
+}
+
+// Add a finished check to the metrics: its read and match times and what the verdict was.
+// fromCache says the header was not read, so there is no read or match time to record.
+inline void recordCheck(const CheckResult& result, bool fromCache = false) {
+#if FILECHECKER_METRICS
+    if (result.verdict != UNKNOWN_EXTENSION && !fromCache) {
+        recordStage(STAGE_READ, result.timings.readNs);
+        recordStage(STAGE_MATCH, result.timings.matchNs);
+    }
+    countEvent(COUNT_FILES);
+    switch (result.verdict) {
+        case MATCH: countEvent(COUNT_MATCHES); break;
+        case MISMATCH: countEvent(COUNT_MISMATCHES); break;
+        case UNKNOWN_EXTENSION: countEvent(COUNT_UNKNOWN); break;
+        case READ_ERROR: countEvent(COUNT_IO_ERRORS); break;
+    }
+    if (result.verdict == MISMATCH && isShortFile(result))
+        countEvent(COUNT_SHORT_FILES);
+#else
+    (void)result;
+    (void)fromCache;
+#endif
+}
+
+template <typename Index>
+CheckResult checkFile(const Index& index, const string& filePath, const SignatureTrie* reverse = nullptr) {
+    CheckResult result;
+    checkFile(index, filePath, reverse, result);
+    return result;
+}
+
+// Short label for a verdict, used in batch output
+inline const char* verdictName(Verdict verdict) {
+    switch (verdict) {
+        case MATCH: return "MATCH";
+        case MISMATCH: return "MISMATCH";
+        case UNKNOWN_EXTENSION: return "UNKNOWN";
+        case READ_ERROR: return "ERROR";
+    }
+    return "UNKNOWN";
+}
+
+// Append the one-line summary used by batch mode and the server:
+// VERDICT<TAB>path<TAB>extension<TAB>signature or error[<TAB>detected,types]
+// A classified file has "content:<class>" in place of the detected types.
+inline void appendResultLine(string& out, const CheckResult& result) {
+    out += verdictName(result.verdict);
+    out += '\t';
+    out += result.path;
+    out += '\t';
+    out += result.extension;
+    out += '\t';
+    if (result.verdict == READ_ERROR) {
+        out += readErrorText(result.error);
+    } else if (result.verdict != UNKNOWN_EXTENSION) {
+        out += result.signatureHex();
+    }
+    for (size_t t = 0; t < result.detectedTypes.size(); t++) {
+        out += (t == 0 ? '\t' : ',');
+        out += result.detectedTypes[t];
+    }
+    if (result.content != CONTENT_NONE) {
+        out += "\tcontent:";
+        out += contentName(result.content);
+    }
+    out += '\n';
+}
+
+// Append the log.txt entry for one checked file. decorative adds the ASCII art on mismatches.
+inline void writeLogEntry(ostream& logFile, const CheckResult& result, bool decorative = true) {
+    logFile << "File path entered: " << result.path << "\n";
+    logFile << "Extracted file extension: " << result.extension << "\n";
+
+    if (result.verdict == UNKNOWN_EXTENSION) {
+        logFile << "Result: No matching file signature found in the database." << "\n";
+        if (result.content != CONTENT_NONE)
+            logFile << "Content looks like: " << contentName(result.content) << "\n";
+        logFile << "----------------------------------------" << "\n";
+        return;
+    }
+
+    string signature = result.signatureHex();
+    logFile << "Extracted file signature: " << signature << "\n";
+    if (result.verdict == MATCH) {
+        logFile << "Result: File signature matches the expected signature." << "\n";
+    } else if (result.verdict == READ_ERROR) {
+        logFile << "Result: Could not read the file signature." << "\n";
+    } else {
+        logFile << "Result: Uh oh File signature does not match the expected signature." << "\n";
+    }
+    if (result.verdict == MISMATCH && decorative) {
+        logFile << "                                .--.__\n"
+                << "                                                      .~ (@)  ~~~---_\n"
+                << "                                                     {     `-_~,,,,,,)\n"
+                << "                                                     {    (_  ',\n"
+                << "                                                      ~    . = _',\n"
+                << "                                                       ~-   '.  =-'\n"
+                << "                                                         ~     :\n"
+                << "      .                                             _,.-~     ('');\n"
+                << "      '.                                         .-~        \\  \\ ;\n"
+                << "        ':-_                                _.--~            \\  \\;      _-=,.\n"
+                << "          ~-:-.__                       _.-~                 {  '---- _'-=,.\n"
+                << "             ~-._~--._             __.-~                     ~---------=,.`\n"
+                << "                 ~~-._~~-----~~~~~~       .+++~~~~~~~~-__   /\\\n"
+                << "                      ~-.,____           {   -     +   }  _/\\\n"
+                << "                              ~~-.______{_    _ -=\\ / /_.~\\\n"
+                << "                                   :      ~--~    // /         ..-\\\n"
+                << "                                   :   / /      // /         ((\\\n"
+                << "                                   :  / /      {   `-------,. ))\n"
+                << "                                   :   /        ''=--------. }o\n"
+                << "                      .=._________,\\'  )                     ))\n"
+                << "                      )  _________ -''                     ~~\n"
+                << "                     / /  _ _\n"
+                << "                    (_.-.'O'-'.\n";
+    }
+
+    if (!result.detectedTypes.empty()) {
+        logFile << "Detected file type: ";
+        for (const auto& type : result.detectedTypes) {
+            logFile << type << " ";
+        }
+        logFile << "\n";
+    }
+    if (result.content != CONTENT_NONE)
+        logFile << "Content looks like: " << contentName(result.content) << "\n";
+
+    logFile << "All Associated signatures: ";
+    for (const auto& expected : result.expected) {
+        logFile << expected.toHex() << " ";
+    }
+    logFile << "\n";
+    logFile << "Current signature: " << signature << "\n";
+    logFile << "----------------------------------------" << "\n";
+}
+
+// Parse a command line number: digits only (in base), within the range of value. Returns
+// false, leaving value alone, for anything else.
+template <typename T>
+bool parseOptionNumber(const string& text, T& value, int base = 10) {
+    if (text.empty() || text.size() > 20 || text.find_first_not_of(base == 8 ? "01234567" : "0123456789") != string::npos)
+        return false;
+    errno = 0;
+    unsigned long long parsed = strtoull(text.c_str(), nullptr, base);
+    if (errno != 0 || parsed > numeric_limits<T>::max())
+        return false;
+    value = static_cast<T>(parsed);
+    return true;
+}
+
+#endif
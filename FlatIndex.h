@@ -0,0 +1,183 @@
+// Read-optimized extension index: open addressing over inline keys, signatures in one arena
+#ifndef FLAT_INDEX_H
+#define FLAT_INDEX_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "ExtensionResolver.h"
+#include "FileUtils.h"
+
+using namespace std;
+
+// Alternative to RedBlackTree<ByteSignature> for lookups. Built once, then read-only:
+// every extension lives in a slot of one contiguous table with its name stored inline,
+// and all signatures sit back to back in a single arena, so a lookup is a hash, a probe
+// or two comparing two words, and a view into the arena. Nothing is copied.
+class FlatSignatureIndex {
+public:
+    static const size_t MAX_KEY = 15; // Longest extension stored inline
+
+private:
+    // Structure for one slot of the hash table
+    struct Slot {
+        uint64_t key[2];    // Extension, NUL padded to 16 bytes
+        uint32_t first;     // Index of the first signature in the arena
+        uint32_t count;     // Number of signatures; 0 marks an empty slot
+        uint32_t maxLength; // Longest offset 0 signature, in bytes
+        uint32_t reserved;
+    };
+
+    vector<Slot> slots;             // Power of two sized, at most half full
+    vector<ByteSignature> arena;    // Signatures grouped by extension
+    size_t mask;                    // slots.size() - 1
+    size_t extensions;              // Number of occupied slots
+    ExtensionResolver resolver;     // Resolves paths to the extensions in the table
+
+    // Utility function: Pack an extension into a padded key. Returns false if it is too long.
+    static bool packKey(const char* data, size_t size, uint64_t key[2])
+    {
+        if (size > MAX_KEY)
+            return false;
+        char buffer[16] = {};
+        memcpy(buffer, data, size);
+        memcpy(key, buffer, sizeof(buffer));
+        return true;
+    }
+
+    // Utility function: Mix the key words into a slot index
+    static size_t hashKey(const uint64_t key[2])
+    {
+        uint64_t h = key[0] * 0x9E3779B97F4A7C15ull ^ key[1] * 0xC2B2AE3D27D4EB4Full;
+        return static_cast<size_t>(h ^ (h >> 29));
+    }
+
+public:
+    FlatSignatureIndex()
+        : slots(1), mask(0), extensions(0)
+    {
+    }
+
+    // Public function: Replace the contents with the given rows (extension, signature)
+    void build(vector<pair<string, ByteSignature>> rows)
+    {
+        // Group by extension, keeping file order within an extension and dropping duplicates
+        stable_sort(rows.begin(), rows.end(),
+                    [](const pair<string, ByteSignature>& a, const pair<string, ByteSignature>& b) { return a.first < b.first; });
+
+        size_t distinct = 0;
+        for (size_t i = 0; i < rows.size(); i++) {
+            if (i == 0 || rows[i].first != rows[i - 1].first)
+                distinct++;
+        }
+        size_t capacity = 2;
+        while (capacity < distinct * 2)
+            capacity *= 2;
+
+        slots.assign(capacity, Slot());
+        mask = capacity - 1;
+        extensions = 0;
+        resolver.clear();
+        arena.clear();
+        arena.reserve(rows.size());
+
+        for (size_t i = 0; i < rows.size();) {
+            size_t j = i;
+            uint32_t first = static_cast<uint32_t>(arena.size());
+            uint32_t maxLength = 0;
+            for (; j < rows.size() && rows[j].first == rows[i].first; j++) {
+                const ByteSignature& sig = rows[j].second;
+                if (find(arena.begin() + first, arena.end(), sig) == arena.end()) {
+                    arena.push_back(sig);
+                    if (sig.offset == 0)
+                        maxLength = max(maxLength, sig.length);
+                }
+            }
+
+            uint64_t key[2];
+            if (!packKey(rows[i].first.data(), rows[i].first.size(), key)) {
+                cerr << "Extension longer than " << MAX_KEY << " characters skipped: " << rows[i].first << endl;
+                arena.resize(first);
+                i = j;
+                continue;
+            }
+            size_t index = hashKey(key) & mask;
+            while (slots[index].count != 0)
+                index = (index + 1) & mask;
+            Slot& slot = slots[index];
+            slot.key[0] = key[0];
+            slot.key[1] = key[1];
+            slot.first = first;
+            slot.count = static_cast<uint32_t>(arena.size() - first);
+            slot.maxLength = maxLength;
+            extensions++;
+            resolver.add(rows[i].first);
+            i = j;
+        }
+    }
+
+    // Public function: Find the signatures for an extension as a view into the arena
+    bool lookup(const string& extension, SignatureSpan& span) const
+    {
+        uint64_t key[2];
+        if (packKey(extension.data(), extension.size(), key)) {
+            for (size_t index = hashKey(key) & mask; slots[index].count != 0; index = (index + 1) & mask) {
+                const Slot& slot = slots[index];
+                if (slot.key[0] == key[0] && slot.key[1] == key[1]) {
+                    span.data = arena.data() + slot.first;
+                    span.size = slot.count;
+                    span.maxLength = slot.maxLength;
+                    return true;
+                }
+            }
+        }
+        span = SignatureSpan();
+        return false;
+    }
+
+    // Public function: Resolves a path to the longest extension in the table it ends with
+    const ExtensionResolver& extensionResolver() const { return resolver; }
+
+    // Public function: Number of extensions and signatures
+    size_t extensionCount() const { return extensions; }
+    size_t signatureCount() const { return arena.size(); }
+};
+
+// Index lookup for the flat index, see lookupSignatures for the tree
+inline bool lookupSignatures(const FlatSignatureIndex& index, const string& extension, SignatureSpan& span) {
+    return index.lookup(extension, span);
+}
+
+// Load the CSV database into the flat index and, if given, the reverse signature trie.
+// Returns false if the file could not be opened.
+inline bool LoadFileSignatures(FlatSignatureIndex& index, SignatureTrie* reverse, const string& filePath) {
+    ifstream file(filePath);
+    if (!file) {
+        cerr << "Error opening file: " << filePath << endl;
+        return false;
+    }
+
+    vector<pair<string, ByteSignature>> rows;
+    string line;
+    string extension;
+    ByteSignature signature;
+    while (getline(file, line)) {
+        if (parseSignatureLine(line, extension, signature)) {
+            rows.emplace_back(extension, signature);
+            if (reverse != nullptr) {
+                reverse->insert(signature.bytes, signature.length, signature.offset, extension);
+            }
+        } else if (!trim(line).empty()) {
+            cerr << "Invalid line format: " << line << endl;
+        }
+    }
+
+    index.build(move(rows));
+    return true;
+}
+
+#endif
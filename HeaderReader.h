@@ -0,0 +1,905 @@
+// Batched header reads: io_uring on Linux, with a portable pread fallback
+#ifndef HEADER_READER_H
+#define HEADER_READER_H
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "SafeOpen.h"
+#include "Signature.h"
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace std;
+
+// One header to fetch. The header's read plan says which ranges; an empty plan means
+// there is nothing to read for this file.
+struct HeaderRequest {
+    const char* path = nullptr;   // File to read
+    FileHeader* header = nullptr; // Read plan in, bytes out
+    int error = 0;                // errno of the failed step or a SkipReason, 0 on success
+    uint64_t size = 0;            // Length of the file, once it has been opened
+    uint64_t readNs = 0;          // How long its reads took; with io_uring, from its chunk's submission to its last completion
+};
+
+// One range of a file to read once its header has been looked at: the follow-up reads of a
+// check, such as a ZIP file's central directory. Nothing past the end of the file is read.
+struct RangeRequest {
+    const char* path = nullptr;   // File to read
+    uint64_t offset = 0;          // Where the range starts
+    size_t length = 0;            // Bytes wanted
+    vector<unsigned char> bytes;  // Bytes read, fewer than length only at the end of the file
+    int error = 0;                // errno of the failed step or a SkipReason, 0 on success
+    uint64_t size = 0;            // Length of the file, once it has been opened
+    uint64_t readNs = 0;          // As for HeaderRequest
+};
+
+// Portable path: open (regular files only, see openRegularFile), one pread per planned
+// range that starts before the end of the file, close. Returns 0, an errno or a SkipReason.
+inline int readHeaderPread(const char* path, FileHeader& header, uint64_t& size) {
+    header.clearReads();
+    int error = 0;
+    size = 0;
+    int fd = openRegularFile(path, error, size);
+    if (fd < 0) {
+        return error;
+    }
+    for (size_t i = 0; i < header.segmentCount && error == 0; i++) {
+        const ReadSegment& segment = header.segments[i];
+        if (segment.offset >= size)
+            continue; // Past the end: nothing to read
+        ssize_t bytesRead = pread(fd, header.bytes + segment.start, segment.length, segment.offset);
+        if (bytesRead < 0)
+            error = errno;
+        else
+            header.setRead(i, static_cast<size_t>(bytesRead));
+    }
+    close(fd);
+    return error;
+}
+
+inline int readHeaderPread(const char* path, FileHeader& header) {
+    uint64_t size = 0;
+    return readHeaderPread(path, header, size);
+}
+
+// Portable path for a range: open, pread until the range or the file ends, close
+inline int readRangePread(RangeRequest& request) {
+    request.bytes.clear();
+    int error = 0;
+    uint64_t& size = request.size;
+    size = 0;
+    int fd = openRegularFile(request.path, error, size);
+    if (fd < 0)
+        return error;
+    if (request.offset < size) {
+        request.bytes.resize(static_cast<size_t>(min<uint64_t>(request.length, size - request.offset)));
+        size_t done = 0;
+        while (done < request.bytes.size()) {
+            ssize_t n = pread(fd, request.bytes.data() + done, request.bytes.size() - done,
+                              static_cast<off_t>(request.offset + done));
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0)
+                error = errno;
+            if (n <= 0)
+                break;
+            done += static_cast<size_t>(n);
+        }
+        request.bytes.resize(done);
+    }
+    close(fd);
+    return error;
+}
+
+#ifdef __linux__
+// Minimal io_uring wrapper over the raw syscalls, so no liburing is needed
+class IoUring {
+private:
+    int ringFd;
+    unsigned entries;
+    bool extArg; // Can a wait be given a timeout (IORING_FEAT_EXT_ARG)?
+    // Submission queue
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    io_uring_sqe* sqes;
+    unsigned pendingTail; // Local tail, published on submit
+    // Completion queue
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+    io_uring_cqe* cqes;
+    // Mappings, released in the destructor
+    void* sqRing;
+    size_t sqRingSize;
+    void* cqRing;
+    size_t cqRingSize;
+    size_t sqesSize;
+
+    // Utility function: Check the kernel supports every opcode we submit
+    bool probe()
+    {
+        const unsigned ops = 256;
+        vector<unsigned char> buffer(sizeof(io_uring_probe) + ops * sizeof(io_uring_probe_op), 0);
+        io_uring_probe* p = reinterpret_cast<io_uring_probe*>(buffer.data());
+        if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PROBE, p, ops) < 0)
+            return false;
+        for (int op : { IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE }) {
+            if (op > p->last_op || !(p->ops[op].flags & IO_URING_OP_SUPPORTED))
+                return false;
+        }
+        return true;
+    }
+
+public:
+    enum WaitResult { WAIT_READY, WAIT_TIMED_OUT, WAIT_FAILED };
+
+    IoUring()
+        : ringFd(-1), entries(0), extArg(false), sqHead(nullptr), sqTail(nullptr), sqMask(nullptr), sqArray(nullptr),
+          sqes(nullptr), pendingTail(0), cqHead(nullptr), cqTail(nullptr), cqMask(nullptr), cqes(nullptr),
+          sqRing(MAP_FAILED), sqRingSize(0), cqRing(MAP_FAILED), cqRingSize(0), sqesSize(0)
+    {
+    }
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    ~IoUring()
+    {
+        if (sqes != nullptr)
+            munmap(sqes, sqesSize);
+        if (cqRing != MAP_FAILED)
+            munmap(cqRing, cqRingSize);
+        if (sqRing != MAP_FAILED)
+            munmap(sqRing, sqRingSize);
+        if (ringFd >= 0)
+            close(ringFd);
+    }
+
+    // Public function: Create the ring. Returns false if io_uring is unavailable or too old.
+    bool init(unsigned queueDepth)
+    {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        int fd = static_cast<int>(syscall(__NR_io_uring_setup, queueDepth, &params));
+        if (fd < 0)
+            return false;
+        ringFd = fd;
+        entries = params.sq_entries;
+        extArg = (params.features & IORING_FEAT_EXT_ARG) != 0;
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+        cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        void* sqeMap = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+        if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqeMap == MAP_FAILED) {
+            if (sqeMap != MAP_FAILED)
+                munmap(sqeMap, sqesSize);
+            return false;
+        }
+        sqes = static_cast<io_uring_sqe*>(sqeMap);
+
+        char* sq = static_cast<char*>(sqRing);
+        sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        pendingTail = *sqTail;
+
+        char* cq = static_cast<char*>(cqRing);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        return probe();
+    }
+
+    // Public function: Number of submission slots
+    unsigned capacity() const { return entries; }
+
+    // Public function: Can submitAndWaitUntil stop waiting at a deadline?
+    bool takesTimeout() const { return extArg; }
+
+    // Public function: The ring's descriptor, readable when a completion is waiting
+    int descriptor() const { return ringFd; }
+
+    // Public function: Get a cleared submission entry, or nullptr if the queue is full
+    io_uring_sqe* nextSqe()
+    {
+        unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+        if (pendingTail - head >= entries)
+            return nullptr;
+        unsigned index = pendingTail & *sqMask;
+        sqArray[index] = index;
+        pendingTail++;
+        io_uring_sqe* sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    // Public function: Publish queued entries and block until waitFor completions are ready
+    bool submitAndWait(unsigned waitFor)
+    {
+        unsigned toSubmit = pendingTail - *sqTail;
+        __atomic_store_n(sqTail, pendingTail, __ATOMIC_RELEASE);
+        while (true) {
+            long ret = syscall(__NR_io_uring_enter, ringFd, toSubmit, waitFor, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (ret < 0) {
+                if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                    return false;
+                continue;
+            }
+            toSubmit -= min<unsigned>(toSubmit, static_cast<unsigned>(ret));
+            if (toSubmit == 0)
+                return true;
+        }
+    }
+
+    // Public function: Like submitAndWait, but stop waiting at deadline (needs takesTimeout()).
+    // Everything queued is submitted either way. WAIT_READY may still leave fewer than waitFor
+    // completions when the call that submitted also ran out of time; the next call says so.
+    WaitResult submitAndWaitUntil(unsigned waitFor, chrono::steady_clock::time_point deadline)
+    {
+        unsigned toSubmit = pendingTail - *sqTail;
+        __atomic_store_n(sqTail, pendingTail, __ATOMIC_RELEASE);
+        while (true) {
+            long long left = chrono::duration_cast<chrono::nanoseconds>(deadline - chrono::steady_clock::now()).count();
+            __kernel_timespec timeout;
+            timeout.tv_sec = left > 0 ? left / 1000000000 : 0;
+            timeout.tv_nsec = left > 0 ? left % 1000000000 : 0;
+            io_uring_getevents_arg arg;
+            memset(&arg, 0, sizeof(arg));
+            arg.ts = reinterpret_cast<uint64_t>(&timeout);
+            long ret = syscall(__NR_io_uring_enter, ringFd, toSubmit, waitFor, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                               &arg, sizeof(arg));
+            if (ret < 0) {
+                if (errno == ETIME && toSubmit == 0)
+                    return WAIT_TIMED_OUT;
+                if (errno != ETIME && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                    return WAIT_FAILED;
+                continue;
+            }
+            toSubmit -= min<unsigned>(toSubmit, static_cast<unsigned>(ret));
+            if (toSubmit == 0)
+                return WAIT_READY;
+        }
+    }
+
+    // Public function: Take one completion if there is one
+    bool popCqe(uint64_t& userData, int& res)
+    {
+        unsigned head = *cqHead;
+        if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+            return false;
+        const io_uring_cqe& cqe = cqes[head & *cqMask];
+        userData = cqe.user_data;
+        res = cqe.res;
+        __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+};
+
+// Where the kernel writes one request's ranges. The reader owns these rather than the
+// caller's header, so a read left running at a deadline can never write into a header that
+// has since been handed back and reused.
+struct HeaderStaging {
+    unsigned char bytes[MAX_HEADER_BYTES];
+};
+
+// Range bytes one chunk of RangeRequests reads at most (a single larger range gets a chunk of its own)
+const size_t MAX_RANGE_STAGING = size_t(4) << 20;
+
+// Which filesystems a read may be tried on inline, in the submitting thread. Filesystems
+// that cannot read without waiting (FUSE, NFS, SMB) wait right there, out of reach of any
+// deadline, so their reads are queued to the kernel's workers instead (IOSQE_ASYNC); local
+// filesystems are read inline, which is faster. Types come from /proc/self/mountinfo, so
+// finding out never asks a stalled server anything.
+class MountTypes {
+private:
+    unordered_map<uint64_t, bool> inline_; // Device -> can its files be read inline?
+    bool loaded = false;
+
+    static uint64_t key(uint32_t major, uint32_t minor) { return (static_cast<uint64_t>(major) << 32) | minor; }
+
+    static bool readsInline(const string& type)
+    {
+        for (const char* local : { "ext2", "ext3", "ext4", "xfs", "btrfs", "bcachefs", "f2fs", "tmpfs", "ramfs", "overlay" }) {
+            if (type == local)
+                return true;
+        }
+        return false;
+    }
+
+    // Utility function: (Re)read the mount table
+    void load()
+    {
+        loaded = true;
+        FILE* mounts = fopen("/proc/self/mountinfo", "re");
+        if (mounts == nullptr)
+            return;
+        char line[4096];
+        while (fgets(line, sizeof(line), mounts) != nullptr) {
+            // "36 35 98:0 /root /mnt opts [optional fields] - type source superopts"
+            unsigned major, minor;
+            const char* dash = strstr(line, " - ");
+            char type[64];
+            if (sscanf(line, "%*u %*u %u:%u", &major, &minor) == 2 && dash != nullptr && sscanf(dash + 3, "%63s", type) == 1)
+                inline_[key(major, minor)] = readsInline(type);
+        }
+        fclose(mounts);
+    }
+
+public:
+    // Public function: May reads of files on this device be tried inline? A device the table
+    // does not list yet (mounted since) makes it be read again, once.
+    bool readInline(uint32_t major, uint32_t minor)
+    {
+        if (!loaded)
+            load();
+        auto it = inline_.find(key(major, minor));
+        if (it == inline_.end()) {
+            load();
+            it = inline_.find(key(major, minor));
+            if (it == inline_.end())
+                it = inline_.emplace(key(major, minor), false).first;
+        }
+        return it->second;
+    }
+};
+
+// What the top byte of user_data says an operation was; the opens matter to RingReaper,
+// which closes whatever a late open hands back
+enum RingOp : uint64_t { OP_OPEN = 1, OP_READ, OP_CLOSE };
+
+// A ring given up on because an operation outlived its deadline, with everything its
+// remaining operations still use
+struct AbandonedRing {
+    unique_ptr<IoUring> ring;
+    unique_ptr<HeaderStaging[]> staging;
+    unique_ptr<unsigned char[]> rangeStaging;
+    vector<int> fds;        // Descriptors operations still in flight read from; closed at the end
+    unsigned outstanding = 0; // Completions still to come
+};
+
+// Keeps abandoned rings alive until their last completion arrives. One thread polls every
+// ring's descriptor, so a file stuck for minutes costs a descriptor and a few pages, not a
+// blocked worker.
+class RingReaper {
+private:
+    mutex lock;
+    vector<unique_ptr<AbandonedRing>> incoming;
+    int wakeFd;
+
+    RingReaper()
+        : wakeFd(eventfd(0, EFD_CLOEXEC))
+    {
+        thread([this]() { run(); }).detach();
+    }
+
+    // Utility function: Take every completion that has arrived. Returns true once the ring has no more to come.
+    static bool drain(AbandonedRing& abandoned)
+    {
+        uint64_t userData;
+        int res;
+        while (abandoned.outstanding > 0 && abandoned.ring->popCqe(userData, res)) {
+            if ((userData >> 56) == OP_OPEN && res >= 0)
+                close(res);
+            abandoned.outstanding--;
+        }
+        if (abandoned.outstanding > 0)
+            return false;
+        for (int fd : abandoned.fds)
+            close(fd);
+        return true;
+    }
+
+    void run()
+    {
+        vector<unique_ptr<AbandonedRing>> rings;
+        vector<pollfd> polls;
+        while (true) {
+            polls.assign(1, pollfd{ wakeFd, POLLIN, 0 });
+            for (const auto& abandoned : rings)
+                polls.push_back(pollfd{ abandoned->ring->descriptor(), POLLIN, 0 });
+            // Without an eventfd, look for new rings every 100 ms instead of being woken
+            if (poll(polls.data(), polls.size(), wakeFd >= 0 ? -1 : 100) < 0 && errno != EINTR)
+                this_thread::sleep_for(chrono::milliseconds(100));
+            if (wakeFd >= 0 && (polls[0].revents & POLLIN)) {
+                uint64_t count;
+                if (read(wakeFd, &count, sizeof(count)) < 0) {
+                    // Nothing to do: the counter is reset by whichever read succeeds
+                }
+            }
+            {
+                lock_guard<mutex> guard(lock);
+                for (auto& abandoned : incoming)
+                    rings.push_back(move(abandoned));
+                incoming.clear();
+            }
+            for (size_t i = 0; i < rings.size();) {
+                if (drain(*rings[i])) {
+                    rings[i] = move(rings.back());
+                    rings.pop_back();
+                } else {
+                    i++;
+                }
+            }
+        }
+    }
+
+public:
+    // Public function: The process-wide reaper. Never destroyed, since its thread may still be
+    // waiting on a stuck file when the program exits.
+    static RingReaper& instance()
+    {
+        static RingReaper* reaper = new RingReaper();
+        return *reaper;
+    }
+
+    // Public function: Look after abandoned until its operations have all completed
+    void adopt(unique_ptr<AbandonedRing> abandoned)
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            incoming.push_back(move(abandoned));
+        }
+        uint64_t one = 1;
+        if (wakeFd >= 0 && write(wakeFd, &one, sizeof(one)) < 0) {
+            // The counter is already non-zero; the reaper is awake either way
+        }
+    }
+};
+#endif
+
+// Reads file headers in batches. With io_uring every open, read and close of a batch is
+// queued at once, so thousands of header reads are in flight per system call; otherwise
+// each file costs an open, an fstat, a pread and a close. Either way only regular files are
+// read, symlinks are not followed, and ranges past the end of a file are never asked for.
+// Follow-up reads of arbitrary ranges (RangeRequest) take the same path.
+//
+// Given a deadline, the io_uring backend stops waiting for a chunk when it passes (one
+// deadline covers the open, read and close phases together): requests still in flight fail with SKIP_TIMED_OUT, the ring goes to RingReaper with them, and the
+// batch carries on with a fresh ring. A pread cannot be interrupted, so that backend has no
+// deadline.
+class HeaderReader {
+public:
+    enum Backend { PREAD, IO_URING };
+
+private:
+    Backend backend;
+    chrono::milliseconds deadline; // Longest wait for one chunk, all its phases together; 0 for no limit
+    size_t timedOut;               // Requests failed with SKIP_TIMED_OUT so far
+#ifdef __linux__
+    enum PhaseResult { PHASE_DONE, PHASE_TIMED_OUT, PHASE_FAILED };
+
+    unique_ptr<IoUring> ring;
+    unsigned ringEntries;
+    unique_ptr<HeaderStaging[]> staging; // One per ring entry
+    unique_ptr<unsigned char[]> rangeStaging; // Where the kernel writes a chunk's ranges
+    size_t rangeStagingSize = 0;
+    vector<size_t> rangeStarts;          // Per-request place in rangeStaging
+    vector<int> fds;                     // Per-request descriptors for the chunk in flight
+    vector<uint64_t> sizes;              // Per-request file sizes from statx
+    vector<unsigned char> readsInline;   // Per-request: may its reads be tried in the submitting thread?
+    MountTypes mounts;
+    vector<unsigned char> inFlight;      // Per-request operations not yet completed in this phase
+    chrono::steady_clock::time_point chunkStart; // When the chunk in flight was submitted
+
+    static uint64_t userData(RingOp op, size_t request, size_t segment)
+    {
+        return (static_cast<uint64_t>(op) << 56) | (static_cast<uint64_t>(segment) << 32) | request;
+    }
+
+    // Utility function: Nanoseconds since the chunk in flight was submitted
+    uint64_t sinceChunkStart() const
+    {
+        return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - chunkStart).count());
+    }
+
+    // Utility function: Hand the ring, its staging and the descriptors its unfinished
+    // operations use to the reaper and carry on with a new ring. Requests left behind fail
+    // with SKIP_TIMED_OUT, unless only their close was left.
+    template <typename Request>
+    void abandonRing(Request* requests, size_t count, RingOp op, unsigned outstanding)
+    {
+        auto abandoned = make_unique<AbandonedRing>();
+        for (size_t i = 0; i < count; i++) {
+            if (inFlight[i] == 0)
+                continue;
+            inFlight[i] = 0;
+            if (op == OP_CLOSE) {
+                fds[i] = -1; // The close owns it now
+                continue;
+            }
+            requests[i].error = SKIP_TIMED_OUT;
+            requests[i].readNs = sinceChunkStart();
+            timedOut++;
+            if (fds[i] >= 0) {
+                abandoned->fds.push_back(fds[i]);
+                fds[i] = -1;
+            }
+        }
+        abandoned->ring = move(ring);
+        abandoned->staging = move(staging);
+        abandoned->rangeStaging = move(rangeStaging);
+        rangeStagingSize = 0;
+        abandoned->outstanding = outstanding;
+        RingReaper::instance().adopt(move(abandoned));
+
+        staging.reset(new HeaderStaging[ringEntries]);
+        ring = make_unique<IoUring>();
+        if (!ring->init(ringEntries))
+            ring.reset();
+    }
+
+    // Utility function: Queue the operations of one phase, submit them together and hand
+    // back each result. prepare(i, next) queues request i's operations, taking entries from
+    // next(i); complete(i, segment, res) gets each result. Chunks are sized so a phase always
+    // fits the ring. With a deadline, whatever has not completed by until is abandoned.
+    template <typename Request, typename Prepare, typename Complete>
+    PhaseResult runPhase(Request* requests, size_t count, RingOp op, chrono::steady_clock::time_point until,
+                         Prepare prepare, Complete complete)
+    {
+        if (!ring)
+            return PHASE_FAILED;
+        unsigned queued = 0;
+        auto next = [&](size_t i) -> io_uring_sqe* {
+            io_uring_sqe* sqe = ring->nextSqe();
+            if (sqe != nullptr) {
+                queued++;
+                inFlight[i]++;
+            }
+            return sqe;
+        };
+        for (size_t i = 0; i < count; i++) {
+            if (!prepare(i, next))
+                return PHASE_FAILED;
+        }
+
+        bool timed = deadline.count() > 0 && ring->takesTimeout();
+        uint64_t data;
+        int res;
+        for (unsigned reaped = 0; reaped < queued;) {
+            if (ring->popCqe(data, res)) {
+                size_t i = static_cast<uint32_t>(data);
+                inFlight[i]--;
+                complete(i, static_cast<size_t>((data >> 32) & 0xFFFFFF), res);
+                reaped++;
+                continue;
+            }
+            // Wake for each completion rather than the last, so a request's read time is its own
+            IoUring::WaitResult wait = !timed ? (ring->submitAndWait(1) ? IoUring::WAIT_READY : IoUring::WAIT_FAILED)
+                                              : ring->submitAndWaitUntil(1, until);
+            if (wait == IoUring::WAIT_FAILED)
+                return PHASE_FAILED;
+            if (wait == IoUring::WAIT_TIMED_OUT) {
+                abandonRing(requests, count, op, queued - reaped);
+                return PHASE_TIMED_OUT;
+            }
+        }
+        return PHASE_DONE;
+    }
+
+    // Utility function: Open, read and close a chunk of files with three submissions. wanted(i)
+    // says whether request i has anything to read; once its file is open, queueReads(i, next)
+    // queues its reads and completeRead(i, segment, res) takes each result.
+    template <typename Request, typename Wanted, typename QueueReads, typename CompleteRead>
+    bool readChunk(Request* requests, size_t count, Wanted wanted, QueueReads queueReads, CompleteRead completeRead)
+    {
+        fds.assign(count, -1);
+        sizes.assign(count, 0);
+        readsInline.assign(count, 1);
+        inFlight.assign(count, 0);
+
+        // One deadline for the whole chunk, so a straggler holds it up for at most that long
+        chunkStart = chrono::steady_clock::now();
+        auto until = chunkStart + deadline;
+        PhaseResult phase = runPhase(requests, count, OP_OPEN, until,
+            [&](size_t i, auto& next) {
+                if (!wanted(i))
+                    return true;
+                io_uring_sqe* sqe = next(i);
+                if (sqe == nullptr)
+                    return false;
+                sqe->opcode = IORING_OP_OPENAT;
+                sqe->fd = AT_FDCWD;
+                sqe->addr = reinterpret_cast<uint64_t>(requests[i].path);
+                sqe->open_flags = CHECK_OPEN_FLAGS;
+                sqe->user_data = userData(OP_OPEN, i, 0);
+                return true;
+            },
+            [&](size_t i, size_t, int res) {
+                requests[i].readNs = sinceChunkStart();
+                if (res < 0)
+                    requests[i].error = openErrorReason(-res);
+                else
+                    fds[i] = res;
+            });
+
+        // What each opened file is and how long it is: only regular files are read, and only
+        // the ranges that start before their end. Asked here rather than through the ring, which
+        // hands every statx to its workers; AT_STATX_DONT_SYNC answers from cached attributes,
+        // so a network filesystem's server is not consulted.
+        for (size_t i = 0; i < count && phase != PHASE_FAILED; i++) {
+            if (fds[i] < 0)
+                continue;
+            struct statx info;
+            if (statx(fds[i], "", AT_EMPTY_PATH | AT_STATX_DONT_SYNC, STATX_TYPE | STATX_SIZE, &info) != 0) {
+                requests[i].error = errno;
+                continue;
+            }
+            requests[i].error = skipReasonFor(info.stx_mode);
+            sizes[i] = info.stx_size;
+            requests[i].size = info.stx_size;
+            readsInline[i] = mounts.readInline(info.stx_dev_major, info.stx_dev_minor);
+            // O_NONBLOCK was for the open. Local filesystems ignore it when reading; on the
+            // others it would turn a read handed to the kernel's workers into EAGAIN.
+            if (requests[i].error == 0 && !readsInline[i] && fcntl(fds[i], F_SETFL, 0) != 0)
+                requests[i].error = errno;
+        }
+
+        if (phase != PHASE_FAILED) {
+            phase = runPhase(requests, count, OP_READ, until,
+                [&](size_t i, auto& next) {
+                    if (fds[i] < 0 || requests[i].error != 0)
+                        return true;
+                    return queueReads(i, next);
+                },
+                [&](size_t i, size_t segment, int res) {
+                    requests[i].readNs = sinceChunkStart();
+                    completeRead(i, segment, res);
+                });
+        }
+
+        // Close whatever was opened even if a previous phase failed
+        PhaseResult closed = runPhase(requests, count, OP_CLOSE, until,
+            [&](size_t i, auto& next) {
+                if (fds[i] < 0)
+                    return true;
+                io_uring_sqe* sqe = next(i);
+                if (sqe == nullptr)
+                    return false;
+                sqe->opcode = IORING_OP_CLOSE;
+                sqe->fd = fds[i];
+                sqe->user_data = userData(OP_CLOSE, i, 0);
+                return true;
+            },
+            [&](size_t i, size_t, int) { fds[i] = -1; });
+        if (closed == PHASE_FAILED) {
+            for (int& fd : fds) {
+                if (fd >= 0)
+                    close(fd);
+                fd = -1;
+            }
+        }
+        return phase != PHASE_FAILED && closed != PHASE_FAILED;
+    }
+
+    // Utility function: Queue a read of length bytes at offset of request i's open file into buffer
+    bool queueRead(size_t i, io_uring_sqe* sqe, unsigned char* buffer, size_t length, uint64_t offset, size_t segment)
+    {
+        if (sqe == nullptr)
+            return false;
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = fds[i];
+        sqe->addr = reinterpret_cast<uint64_t>(buffer);
+        sqe->len = static_cast<uint32_t>(length);
+        sqe->off = offset;
+        sqe->user_data = userData(OP_READ, i, segment);
+        if (!readsInline[i])
+            sqe->flags |= IOSQE_ASYNC;
+        return true;
+    }
+
+    // Utility function: Read a chunk of headers: one read per planned range that starts before
+    // the end of the file; user_data carries the request and the range
+    bool readChunkUring(HeaderRequest* requests, size_t count)
+    {
+        return readChunk(requests, count,
+            [&](size_t i) { return requests[i].header->segmentCount > 0; },
+            [&](size_t i, auto& next) {
+                const FileHeader& header = *requests[i].header;
+                for (size_t s = 0; s < header.segmentCount; s++) {
+                    const ReadSegment& segment = header.segments[s];
+                    if (segment.offset >= sizes[i])
+                        continue;
+                    if (!queueRead(i, next(i), staging[i].bytes + segment.start, segment.length, segment.offset, s))
+                        return false;
+                }
+                return true;
+            },
+            [&](size_t i, size_t s, int res) {
+                FileHeader& header = *requests[i].header;
+                if (res < 0) {
+                    requests[i].error = -res;
+                } else {
+                    memcpy(header.bytes + header.segments[s].start, staging[i].bytes + header.segments[s].start,
+                           static_cast<size_t>(res));
+                    header.setRead(s, static_cast<size_t>(res));
+                }
+            });
+    }
+
+    // Utility function: Read a chunk of ranges, stagedBytes long together, one read each
+    bool readRangesUring(RangeRequest* requests, size_t count, size_t stagedBytes)
+    {
+        if (rangeStagingSize < stagedBytes) {
+            rangeStaging.reset(new unsigned char[stagedBytes]);
+            rangeStagingSize = stagedBytes;
+        }
+        rangeStarts.resize(count);
+        size_t start = 0;
+        for (size_t i = 0; i < count; i++) {
+            rangeStarts[i] = start;
+            start += requests[i].length;
+        }
+        return readChunk(requests, count,
+            [&](size_t i) { return requests[i].length > 0; },
+            [&](size_t i, auto& next) {
+                if (requests[i].offset >= sizes[i])
+                    return true;
+                size_t length = static_cast<size_t>(min<uint64_t>(requests[i].length, sizes[i] - requests[i].offset));
+                return queueRead(i, next(i), rangeStaging.get() + rangeStarts[i], length, requests[i].offset, 0);
+            },
+            [&](size_t i, size_t, int res) {
+                if (res < 0) {
+                    requests[i].error = -res;
+                } else {
+                    const unsigned char* bytes = rangeStaging.get() + rangeStarts[i];
+                    requests[i].bytes.assign(bytes, bytes + res);
+                }
+            });
+    }
+#endif
+
+    // Utility function: Read one request with blocking calls, timing it
+    static void readPread(HeaderRequest& request)
+    {
+        auto start = chrono::steady_clock::now();
+        request.error = readHeaderPread(request.path, *request.header, request.size);
+        request.readNs = static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+    }
+
+    static void readPread(RangeRequest& request)
+    {
+        auto start = chrono::steady_clock::now();
+        request.error = readRangePread(request);
+        request.readNs = static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+    }
+
+public:
+    // Constructor: Use io_uring when asked for and available, otherwise pread. deadlineMs
+    // bounds the wait for each io_uring chunk (0 waits as long as it takes).
+    explicit HeaderReader(Backend preferred = IO_URING, unsigned queueDepth = 256, unsigned deadlineMs = 0)
+        : backend(PREAD), deadline(deadlineMs), timedOut(0)
+    {
+#ifdef __linux__
+        // Room for a whole chunk's reads when most files want one or two ranges
+        ringEntries = max<unsigned>(queueDepth * 2, MAX_READ_SEGMENTS);
+        ring = make_unique<IoUring>();
+        if (preferred == IO_URING && ring->init(ringEntries)) {
+            backend = IO_URING;
+            ringEntries = ring->capacity();
+            staging.reset(new HeaderStaging[ringEntries]);
+        }
+#else
+        (void)preferred;
+        (void)queueDepth;
+#endif
+    }
+
+    // Public function: Which backend is in use
+    Backend activeBackend() const { return backend; }
+
+    // Public function: Number of requests that have failed with SKIP_TIMED_OUT
+    size_t timedOutCount() const { return timedOut; }
+
+    // Public function: Fill every request's header. Per-file failures are reported in request.error.
+    void readBatch(HeaderRequest* requests, size_t count)
+    {
+        for (size_t i = 0; i < count; i++) {
+            requests[i].error = 0;
+            requests[i].size = 0;
+            requests[i].readNs = 0;
+            requests[i].header->clearReads();
+        }
+#ifdef __linux__
+        if (backend == IO_URING) {
+            for (size_t start = 0; start < count;) {
+                // As many files as fit one phase: every range to read takes its own entry
+                size_t n = 0;
+                size_t used = 0;
+                while (start + n < count) {
+                    size_t need = max<size_t>(requests[start + n].header->segmentCount, 1);
+                    if (used + need > ringEntries)
+                        break;
+                    used += need;
+                    n++;
+                }
+                if (!readChunkUring(requests + start, n)) {
+                    // The ring itself failed; finish with pread, leaving alone files that already missed their deadline
+                    backend = PREAD;
+                    for (size_t i = start; i < count; i++) {
+                        if (requests[i].header->segmentCount > 0 && requests[i].error != SKIP_TIMED_OUT)
+                            readPread(requests[i]);
+                    }
+                    return;
+                }
+                start += n;
+            }
+            return;
+        }
+#endif
+        for (size_t i = 0; i < count; i++) {
+            if (requests[i].header->segmentCount > 0)
+                readPread(requests[i]);
+        }
+    }
+
+    // Public function: Read every request's range, in chunks under the same deadline as
+    // headers. Per-file failures are reported in request.error.
+    void readRanges(RangeRequest* requests, size_t count)
+    {
+        for (size_t i = 0; i < count; i++) {
+            requests[i].error = 0;
+            requests[i].size = 0;
+            requests[i].readNs = 0;
+            requests[i].bytes.clear();
+        }
+#ifdef __linux__
+        if (backend == IO_URING) {
+            for (size_t start = 0; start < count;) {
+                // As many ranges as fit the ring and the staging limit, and at least one
+                size_t n = 0;
+                size_t staged = 0;
+                while (start + n < count && n < ringEntries
+                       && (n == 0 || staged + requests[start + n].length <= MAX_RANGE_STAGING)) {
+                    staged += requests[start + n].length;
+                    n++;
+                }
+                if (!readRangesUring(requests + start, n, staged)) {
+                    backend = PREAD;
+                    for (size_t i = start; i < count; i++) {
+                        if (requests[i].error != SKIP_TIMED_OUT)
+                            readPread(requests[i]);
+                    }
+                    return;
+                }
+                start += n;
+            }
+            return;
+        }
+#endif
+        for (size_t i = 0; i < count; i++)
+            readPread(requests[i]);
+    }
+};
+
+// Name of a backend for summaries
+inline const char* backendName(HeaderReader::Backend backend) {
+    return backend == HeaderReader::IO_URING ? "io_uring" : "pread";
+}
+
+#endif
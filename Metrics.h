@@ -0,0 +1,386 @@
+// Per-stage latency histograms and event counters for the checker
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Build with -DFILECHECKER_METRICS=0 to compile the instrumentation out: the hooks below
+// become empty inline functions and no clock is read on their behalf.
+#ifndef FILECHECKER_METRICS
+#define FILECHECKER_METRICS 1
+#endif
+
+// Where a check spends its time
+enum Stage {
+    STAGE_PATH,   // Extension resolution (ExtensionResolver)
+    STAGE_LOOKUP, // Index lookup and read planning
+    STAGE_READ,   // Open and header read
+    STAGE_MATCH,  // Signature comparison and reverse lookup
+    STAGE_LOG,    // Handing the result to the logger
+    STAGE_COUNT
+};
+
+// What happened to the files checked
+enum Counter {
+    COUNT_FILES,
+    COUNT_MATCHES,
+    COUNT_MISMATCHES,
+    COUNT_UNKNOWN,
+    COUNT_SHORT_FILES, // Shorter than a range their signatures cover
+    COUNT_IO_ERRORS,
+    COUNTER_COUNT
+};
+
+inline const char* stageName(size_t stage) {
+    static const char* const names[STAGE_COUNT] = { "path", "lookup", "read", "match", "log" };
+    return stage < STAGE_COUNT ? names[stage] : "unknown";
+}
+
+inline const char* counterName(size_t counter) {
+    static const char* const names[COUNTER_COUNT] = { "files", "matches", "mismatches", "unknown_extensions",
+                                                      "short_files", "io_errors" };
+    return counter < COUNTER_COUNT ? names[counter] : "unknown";
+}
+
+// Log-linear buckets in the style of an HDR histogram: values below 2^SUB_BITS get a bucket
+// each, and every power of two above that is split into 2^SUB_BITS equal buckets, so any
+// value is known to within about 3%. Values past 2^MAX_BITS ns (about 18 minutes) are clamped.
+const unsigned HISTOGRAM_SUB_BITS = 5;
+const unsigned HISTOGRAM_MAX_BITS = 40;
+const size_t HISTOGRAM_SUB_BUCKETS = size_t(1) << HISTOGRAM_SUB_BITS;
+const size_t HISTOGRAM_BUCKETS = (HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS;
+
+inline size_t histogramBucket(uint64_t value) {
+    if (value >= (uint64_t(1) << HISTOGRAM_MAX_BITS))
+        return HISTOGRAM_BUCKETS - 1;
+    if (value < HISTOGRAM_SUB_BUCKETS)
+        return static_cast<size_t>(value);
+    unsigned exponent = 63 - static_cast<unsigned>(__builtin_clzll(value)); // >= SUB_BITS
+    unsigned shift = exponent - HISTOGRAM_SUB_BITS;
+    return (shift + 1) * HISTOGRAM_SUB_BUCKETS + static_cast<size_t>((value >> shift) - HISTOGRAM_SUB_BUCKETS);
+}
+
+// Smallest value that falls in a bucket
+inline uint64_t histogramBucketStart(size_t bucket) {
+    if (bucket < HISTOGRAM_SUB_BUCKETS)
+        return bucket;
+    size_t shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+    return (uint64_t(HISTOGRAM_SUB_BUCKETS) + bucket % HISTOGRAM_SUB_BUCKETS) << shift;
+}
+
+// One stage's histogram as owned by a single thread. Only the owner writes, so an update is
+// a plain load and store (no locked instruction); the atomics let a dump read it meanwhile.
+struct StageHistogram {
+    atomic<uint64_t> buckets[HISTOGRAM_BUCKETS];
+    atomic<uint64_t> count;
+    atomic<uint64_t> total;
+    atomic<uint64_t> maximum;
+
+    StageHistogram()
+        : count(0), total(0), maximum(0)
+    {
+        for (atomic<uint64_t>& bucket : buckets)
+            bucket.store(0, memory_order_relaxed);
+    }
+
+    void record(uint64_t ns)
+    {
+        atomic<uint64_t>& bucket = buckets[histogramBucket(ns)];
+        bucket.store(bucket.load(memory_order_relaxed) + 1, memory_order_relaxed);
+        count.store(count.load(memory_order_relaxed) + 1, memory_order_relaxed);
+        total.store(total.load(memory_order_relaxed) + ns, memory_order_relaxed);
+        if (ns > maximum.load(memory_order_relaxed))
+            maximum.store(ns, memory_order_relaxed);
+    }
+};
+
+// Everything one thread has recorded
+struct ThreadMetrics {
+    StageHistogram stages[STAGE_COUNT];
+    atomic<uint64_t> counters[COUNTER_COUNT];
+
+    ThreadMetrics()
+    {
+        for (atomic<uint64_t>& counter : counters)
+            counter.store(0, memory_order_relaxed);
+    }
+};
+
+// Merged view of every thread's metrics at one moment
+struct MetricsSnapshot {
+    struct StageSummary {
+        uint64_t count = 0;
+        uint64_t total = 0;
+        uint64_t maximum = 0;
+        vector<uint64_t> buckets = vector<uint64_t>(HISTOGRAM_BUCKETS);
+
+        // Upper end of the bucket holding the given percentile, capped at the exact maximum
+        uint64_t percentile(double p) const
+        {
+            if (count == 0)
+                return 0;
+            uint64_t rank = static_cast<uint64_t>(p / 100.0 * static_cast<double>(count) + 0.5);
+            rank = rank == 0 ? 1 : rank;
+            uint64_t seen = 0;
+            for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+                seen += buckets[i];
+                if (seen >= rank)
+                    return i + 1 < HISTOGRAM_BUCKETS ? min(histogramBucketStart(i + 1) - 1, maximum) : maximum;
+            }
+            return maximum;
+        }
+    };
+
+    uint64_t timestampNs = 0; // Wall clock, for lining dumps up with other data
+    size_t threads = 0;
+    StageSummary stages[STAGE_COUNT];
+    uint64_t counters[COUNTER_COUNT] = {};
+
+    // One JSON object on one line
+    string toJson() const
+    {
+        string out = "{\"timestamp_ns\":" + to_string(timestampNs) + ",\"threads\":" + to_string(threads);
+        out += ",\"counters\":{";
+        for (size_t c = 0; c < COUNTER_COUNT; c++) {
+            out += (c == 0 ? "\"" : ",\"");
+            out += counterName(c);
+            out += "\":" + to_string(counters[c]);
+        }
+        out += "},\"stages\":{";
+        for (size_t s = 0; s < STAGE_COUNT; s++) {
+            const StageSummary& stage = stages[s];
+            out += (s == 0 ? "\"" : ",\"");
+            out += stageName(s);
+            out += "\":{\"count\":" + to_string(stage.count);
+            out += ",\"mean_ns\":" + to_string(stage.count > 0 ? stage.total / stage.count : 0);
+            out += ",\"p50_ns\":" + to_string(stage.percentile(50));
+            out += ",\"p90_ns\":" + to_string(stage.percentile(90));
+            out += ",\"p99_ns\":" + to_string(stage.percentile(99));
+            out += ",\"p999_ns\":" + to_string(stage.percentile(99.9));
+            out += ",\"max_ns\":" + to_string(stage.maximum) + "}";
+        }
+        out += "}}";
+        return out;
+    }
+};
+
+// Every thread's ThreadMetrics, created on the thread's first record. Blocks outlive their
+// threads so that a dump after a batch run still counts the workers that have exited.
+class MetricsRegistry {
+private:
+    mutex registryMutex;
+    vector<unique_ptr<ThreadMetrics>> threads;
+
+public:
+    static MetricsRegistry& instance()
+    {
+        static MetricsRegistry registry;
+        return registry;
+    }
+
+    // Public function: A new block for the calling thread
+    ThreadMetrics* add()
+    {
+        lock_guard<mutex> lock(registryMutex);
+        threads.push_back(make_unique<ThreadMetrics>());
+        return threads.back().get();
+    }
+
+    // Public function: Merge every thread's block
+    MetricsSnapshot snapshot()
+    {
+        MetricsSnapshot snapshot;
+        snapshot.timestampNs = static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+            chrono::system_clock::now().time_since_epoch()).count());
+        lock_guard<mutex> lock(registryMutex);
+        snapshot.threads = threads.size();
+        for (const unique_ptr<ThreadMetrics>& block : threads) {
+            for (size_t c = 0; c < COUNTER_COUNT; c++)
+                snapshot.counters[c] += block->counters[c].load(memory_order_relaxed);
+            for (size_t s = 0; s < STAGE_COUNT; s++) {
+                const StageHistogram& from = block->stages[s];
+                MetricsSnapshot::StageSummary& to = snapshot.stages[s];
+                to.count += from.count.load(memory_order_relaxed);
+                to.total += from.total.load(memory_order_relaxed);
+                to.maximum = max(to.maximum, from.maximum.load(memory_order_relaxed));
+                for (size_t b = 0; b < HISTOGRAM_BUCKETS; b++)
+                    to.buckets[b] += from.buckets[b].load(memory_order_relaxed);
+            }
+        }
+        return snapshot;
+    }
+};
+
+#if FILECHECKER_METRICS
+
+// The calling thread's block
+inline ThreadMetrics& threadMetrics() {
+    thread_local ThreadMetrics* local = MetricsRegistry::instance().add();
+    return *local;
+}
+
+// Record time spent in a stage
+inline void recordStage(Stage stage, uint64_t ns) {
+    threadMetrics().stages[stage].record(ns);
+}
+
+// Count an event
+inline void countEvent(Counter counter) {
+    atomic<uint64_t>& value = threadMetrics().counters[counter];
+    value.store(value.load(memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+// Times the enclosing scope as one stage
+class StageTimer {
+private:
+    Stage stage;
+    chrono::steady_clock::time_point start;
+
+public:
+    explicit StageTimer(Stage timedStage)
+        : stage(timedStage), start(chrono::steady_clock::now())
+    {
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+    ~StageTimer()
+    {
+        recordStage(stage, static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+                               chrono::steady_clock::now() - start).count()));
+    }
+};
+
+#else
+
+inline void recordStage(Stage, uint64_t) {}
+inline void countEvent(Counter) {}
+
+class StageTimer {
+public:
+    explicit StageTimer(Stage) {}
+};
+
+#endif
+
+// Writes a snapshot as one JSON line to a file ("-" for stderr) every interval seconds
+// (0 for never), whenever dump() is called, and once more when stopped. dump() only writes
+// a byte to a pipe, so it can be called from a signal handler; the snapshot is taken and
+// written on the reporter's own thread.
+class MetricsReporter {
+private:
+    string path;
+    unsigned intervalSeconds;
+    int wakePipe[2];
+    thread reporter;
+
+    // Utility function: Append the current snapshot to the output
+    void write() const
+    {
+        string line = MetricsRegistry::instance().snapshot().toJson();
+        if (path == "-") {
+            cerr << line << endl;
+            return;
+        }
+        ofstream out(path, ios::app);
+        if (!out) {
+            cerr << "Error opening metrics file " << path << ": " << strerror(errno) << endl;
+            return;
+        }
+        out << line << '\n';
+    }
+
+    // Utility function: The reporter thread. 'd' asks for a dump, 'q' (or a closed pipe) to stop.
+    void loop() const
+    {
+        int timeout = intervalSeconds > 0 ? static_cast<int>(intervalSeconds * 1000) : -1;
+        pollfd wake = { wakePipe[0], POLLIN, 0 };
+        while (true) {
+            int ready = poll(&wake, 1, timeout);
+            if (ready < 0) {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+            if (ready == 0) {
+                write();
+                continue;
+            }
+            char byte;
+            ssize_t n = read(wakePipe[0], &byte, 1);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0 || byte == 'q')
+                break;
+            write();
+        }
+    }
+
+public:
+    MetricsReporter(const string& outputPath, unsigned interval)
+        : path(outputPath), intervalSeconds(interval)
+    {
+        wakePipe[0] = wakePipe[1] = -1;
+    }
+
+    MetricsReporter(const MetricsReporter&) = delete;
+    MetricsReporter& operator=(const MetricsReporter&) = delete;
+
+    ~MetricsReporter() { stop(); }
+
+    // Public function: Start the reporter thread. Returns false with error filled in.
+    bool start(string& error)
+    {
+        if (pipe2(wakePipe, O_CLOEXEC) < 0) {
+            error = string("Error creating pipe: ") + strerror(errno);
+            return false;
+        }
+        reporter = thread(&MetricsReporter::loop, this);
+        return true;
+    }
+
+    // Public function: Ask for a snapshot now
+    void dump() const
+    {
+        char byte = 'd';
+        ssize_t ignored = ::write(wakePipe[1], &byte, 1);
+        (void)ignored;
+    }
+
+    // Public function: Descriptor dump() writes to, for signal handlers
+    int dumpDescriptor() const { return wakePipe[1]; }
+
+    // Public function: Write a final snapshot and stop the thread
+    void stop()
+    {
+        if (!reporter.joinable())
+            return;
+        char byte = 'q';
+        ssize_t ignored = ::write(wakePipe[1], &byte, 1);
+        (void)ignored;
+        reporter.join();
+        write();
+        close(wakePipe[0]);
+        close(wakePipe[1]);
+        wakePipe[0] = wakePipe[1] = -1;
+    }
+};
+
+#endif
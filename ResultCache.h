@@ -0,0 +1,547 @@
+// Persistent result cache: lets a rescan skip files that have not changed since the last run
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "FileUtils.h"
+
+using namespace std;
+
+// File layout (native byte order): ResultCacheHeader, then a power-of-two number of
+// ResultCacheEntry slots forming an open-addressing hash table keyed by file identity
+// (device, inode, extension). The size and mtime in each entry say which version of the
+// file it describes; the database fingerprint in the header says which database produced
+// the verdicts, and a different one empties the cache.
+const char RESULT_CACHE_MAGIC[8] = { 'F', 'C', 'C', 'A', 'C', 'H', 'E', '\0' };
+const uint32_t RESULT_CACHE_VERSION = 2; // 2: container type
+const size_t RESULT_CACHE_SEGMENTS = MAX_READ_SEGMENTS; // Read ranges kept per entry
+const size_t RESULT_CACHE_BYTES = 144; // Header bytes kept per entry (a mismatch's offset probes included)
+const size_t RESULT_CACHE_MAX_PROBES = 64;
+
+struct ResultCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t entrySize;           // sizeof(ResultCacheEntry); must match the reader
+    uint64_t databaseFingerprint; // Which signature database the verdicts came from
+    uint64_t capacity;            // Number of slots, a power of two
+    uint64_t count;               // Occupied slots (recounted after a crash)
+    uint32_t clean;               // 1 after an orderly close, 0 while open
+    uint32_t reserved;
+    char padding[64 - 48];
+};
+
+// 256 bytes, a whole number of cache lines
+struct ResultCacheEntry {
+    uint32_t sequence;  // 0 empty, odd while being written, even once complete
+    uint32_t checksum;  // FNV-1a over the fields below; catches entries torn by a crash
+    uint64_t device;
+    uint64_t inode;
+    uint64_t size;
+    int64_t mtimeNs;
+    uint32_t extensionHash;
+    uint8_t verdict;
+    uint8_t segmentCount;
+    uint8_t container;  // ContainerType of a ZIP-based file
+    uint8_t content;    // ContentClass of an unexplained file, 0 if it was not classified
+    uint32_t segmentOffset[RESULT_CACHE_SEGMENTS];
+    uint16_t segmentLength[RESULT_CACHE_SEGMENTS]; // Bytes planned
+    uint16_t segmentRead[RESULT_CACHE_SEGMENTS];   // Bytes that were there
+    unsigned char bytes[RESULT_CACHE_BYTES];       // Read bytes, back to back
+};
+
+static_assert(sizeof(ResultCacheHeader) == 64, "cache header layout");
+static_assert(sizeof(ResultCacheEntry) == 256, "cache entry layout");
+
+// What identifies one version of one file, from stat()
+struct CacheKey {
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    uint64_t size = 0;
+    int64_t mtimeNs = 0;
+    uint32_t extensionHash = 0; // The verdict depends on the name too (hard links, renames)
+};
+
+// FNV-1a, 64 bit, for fingerprints and slot hashing
+inline uint64_t fnv1a64(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Fingerprint of a signature database file's contents. Returns 0 if it cannot be read.
+inline uint64_t databaseFingerprint(const string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return 0;
+    uint64_t hash = fnv1a64(RESULT_CACHE_MAGIC, sizeof(RESULT_CACHE_MAGIC));
+    char buffer[64 * 1024];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0)
+        hash = fnv1a64(buffer, static_cast<size_t>(n), hash);
+    ::close(fd);
+    return n < 0 ? 0 : hash;
+}
+
+// lstat() the file behind a prepared check. Returns false if it cannot be stat'ed or is not a
+// regular file (a symlink or a FIFO is never cached; the check itself turns it away).
+inline bool makeCacheKey(const CheckResult& result, CacheKey& key) {
+    struct stat info;
+    if (lstat(result.path.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+        return false;
+    key.device = static_cast<uint64_t>(info.st_dev);
+    key.inode = static_cast<uint64_t>(info.st_ino);
+    key.size = static_cast<uint64_t>(info.st_size);
+    key.mtimeNs = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+    key.extensionHash = static_cast<uint32_t>(fnv1a64(result.extension.data(), result.extension.size()));
+    return true;
+}
+
+// Hit and miss counts for one run
+struct CacheStats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t stores = 0;
+    size_t skipped = 0; // Results that could not be stored (too many bytes, or the table is crowded)
+
+    double hitRate() const { return hits + misses > 0 ? 100.0 * hits / (hits + misses) : 0.0; }
+};
+
+// The cache file mapped into memory. Lookups and stores are safe from any number of threads:
+// each slot is guarded by a sequence number (a seqlock). Readers copy the slot and treat one
+// that changed under them as a miss rather than retrying. Stores update slots in place; a
+// crash can at worst tear one entry, which its checksum then rejects. When the table passes
+// half full it is rehashed into a file twice the size, with lookups and stores held off
+// meanwhile, so a run that started with a small table (stream or watch mode) keeps caching.
+class ResultCache {
+private:
+    int fd;
+    ResultCacheHeader* header;
+    ResultCacheEntry* entries;
+    size_t mappedSize;
+    size_t mask;
+    string cachePath;
+    uint64_t cacheFingerprint;
+    bool growFailed;        // Could not write a larger table; stop trying for this run
+    shared_mutex resizing;  // Held shared by lookups and stores, exclusively while growing
+    atomic<size_t> hits, misses, stores, skipped, added;
+
+    enum Placement { PLACED_NEW, PLACED_UPDATE, SLOT_BUSY, TABLE_CROWDED };
+
+    // Utility function: Checksum of an entry, excluding the sequence and checksum words
+    static uint32_t entryChecksum(const ResultCacheEntry& entry)
+    {
+        const unsigned char* begin = reinterpret_cast<const unsigned char*>(&entry) + 2 * sizeof(uint32_t);
+        uint64_t hash = fnv1a64(begin, sizeof(entry) - 2 * sizeof(uint32_t));
+        return static_cast<uint32_t>(hash ^ (hash >> 32));
+    }
+
+    // Utility function: First slot to probe for a file
+    size_t slotFor(const CacheKey& key) const
+    {
+        uint64_t identity[3] = { key.device, key.inode, key.extensionHash };
+        return static_cast<size_t>(fnv1a64(identity, sizeof(identity))) & mask;
+    }
+
+    static bool sameFile(const ResultCacheEntry& entry, const CacheKey& key)
+    {
+        return entry.device == key.device && entry.inode == key.inode && entry.extensionHash == key.extensionHash;
+    }
+
+    // Utility function: Map an existing cache file. Returns false if it is not a usable cache.
+    bool mapFile(int file, size_t fileSize)
+    {
+        if (fileSize < sizeof(ResultCacheHeader))
+            return false;
+        void* map = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+        if (map == MAP_FAILED)
+            return false;
+        ResultCacheHeader* h = static_cast<ResultCacheHeader*>(map);
+        uint64_t capacity = h->capacity;
+        if (memcmp(h->magic, RESULT_CACHE_MAGIC, sizeof(h->magic)) != 0 || h->version != RESULT_CACHE_VERSION
+            || h->entrySize != sizeof(ResultCacheEntry) || capacity == 0 || (capacity & (capacity - 1)) != 0
+            || fileSize != sizeof(ResultCacheHeader) + capacity * sizeof(ResultCacheEntry)) {
+            munmap(map, fileSize);
+            return false;
+        }
+        fd = file;
+        header = h;
+        entries = reinterpret_cast<ResultCacheEntry*>(static_cast<char*>(map) + sizeof(ResultCacheHeader));
+        mappedSize = fileSize;
+        mask = static_cast<size_t>(capacity - 1);
+        return true;
+    }
+
+    // Utility function: Write an empty cache of the given capacity to path (via a temporary
+    // file and rename), copying the valid entries of the currently mapped cache if asked.
+    bool createFile(const string& path, uint64_t fingerprint, size_t capacity, bool keepEntries, string& error)
+    {
+        string tmpPath = path + ".tmp";
+        int file = ::open(tmpPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        size_t fileSize = sizeof(ResultCacheHeader) + capacity * sizeof(ResultCacheEntry);
+        if (file < 0 || ftruncate(file, static_cast<off_t>(fileSize)) != 0) {
+            error = "Error creating cache " + tmpPath + ": " + strerror(errno);
+            if (file >= 0)
+                ::close(file);
+            return false;
+        }
+        void* map = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+        if (map == MAP_FAILED) {
+            error = "Error mapping cache " + tmpPath + ": " + strerror(errno);
+            ::close(file);
+            return false;
+        }
+
+        ResultCacheHeader* h = static_cast<ResultCacheHeader*>(map);
+        memcpy(h->magic, RESULT_CACHE_MAGIC, sizeof(h->magic));
+        h->version = RESULT_CACHE_VERSION;
+        h->entrySize = sizeof(ResultCacheEntry);
+        h->databaseFingerprint = fingerprint;
+        h->capacity = capacity;
+        h->clean = 1;
+
+        // Rehash what we had into the new table
+        ResultCacheEntry* table = reinterpret_cast<ResultCacheEntry*>(static_cast<char*>(map) + sizeof(ResultCacheHeader));
+        size_t newMask = capacity - 1;
+        uint64_t count = 0;
+        for (size_t i = 0; keepEntries && header != nullptr && i <= mask; i++) {
+            const ResultCacheEntry& entry = entries[i];
+            if (entry.sequence == 0 || (entry.sequence & 1) != 0 || entry.checksum != entryChecksum(entry))
+                continue;
+            uint64_t identity[3] = { entry.device, entry.inode, entry.extensionHash };
+            size_t slot = static_cast<size_t>(fnv1a64(identity, sizeof(identity))) & newMask;
+            while (table[slot].sequence != 0)
+                slot = (slot + 1) & newMask;
+            table[slot] = entry;
+            table[slot].sequence = 2;
+            count++;
+        }
+        h->count = count;
+
+        bool ok = msync(map, fileSize, MS_SYNC) == 0 && fsync(file) == 0;
+        munmap(map, fileSize);
+        ::close(file);
+        if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+            error = "Error writing cache " + path + ": " + strerror(errno);
+            unlink(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // Utility function: Unmap and close
+    void unmap()
+    {
+        if (header != nullptr)
+            munmap(header, mappedSize);
+        if (fd >= 0)
+            ::close(fd);
+        header = nullptr;
+        entries = nullptr;
+        fd = -1;
+        mappedSize = 0;
+        mask = 0;
+    }
+
+    // Utility function: Write entry into its slot (empty, or an older version of the same file)
+    Placement place(const CacheKey& key, const ResultCacheEntry& entry)
+    {
+        size_t slot = slotFor(key);
+        for (size_t probe = 0; probe < RESULT_CACHE_MAX_PROBES; probe++, slot = (slot + 1) & mask) {
+            ResultCacheEntry& shared = entries[slot];
+            uint32_t sequence = __atomic_load_n(&shared.sequence, __ATOMIC_ACQUIRE);
+            if ((sequence & 1) != 0)
+                return SLOT_BUSY; // Someone else is writing this slot
+            if (sequence != 0 && !sameFile(shared, key))
+                continue;
+            // Claim the slot
+            if (!__atomic_compare_exchange_n(&shared.sequence, &sequence, sequence + 1, false,
+                                             __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+                return SLOT_BUSY;
+            memcpy(reinterpret_cast<char*>(&shared) + sizeof(uint32_t), reinterpret_cast<const char*>(&entry) + sizeof(uint32_t),
+                   sizeof(entry) - sizeof(uint32_t));
+            __atomic_store_n(&shared.sequence, sequence + 2, __ATOMIC_RELEASE);
+            return sequence == 0 ? PLACED_NEW : PLACED_UPDATE;
+        }
+        return TABLE_CROWDED;
+    }
+
+    // Utility function: True once the table is more than half full
+    bool crowded() const
+    {
+        return header->count + added.load(memory_order_relaxed) > (mask + 1) / 2;
+    }
+
+    // Utility function: Rehash into a file twice the size and map that instead. The new file
+    // is written beside the old one and renamed over it, so a crash leaves one or the other;
+    // the old one is still marked unclean and recovers as it would have. Returns false (and
+    // stops further attempts) if the larger file cannot be written.
+    bool grow(size_t seenCapacity)
+    {
+        unique_lock<shared_mutex> lock(resizing);
+        if (header == nullptr || growFailed)
+            return false;
+        if (mask + 1 != seenCapacity)
+            return true; // Another thread grew it first
+        string error;
+        int oldFd = fd;
+        ResultCacheHeader* oldHeader = header;
+        size_t oldSize = mappedSize;
+        if (!createFile(cachePath, cacheFingerprint, (mask + 1) * 2, true, error) || !mapPath(cachePath)) {
+            growFailed = true;
+            return false;
+        }
+        munmap(oldHeader, oldSize);
+        ::close(oldFd);
+        added.store(0, memory_order_relaxed); // createFile counted what it copied
+        header->clean = 0;
+        msync(header, sizeof(ResultCacheHeader), MS_SYNC);
+        return true;
+    }
+
+    // Utility function: Open and map path, leaving the object closed on failure
+    bool mapPath(const string& path)
+    {
+        int file = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+        if (file < 0)
+            return false;
+        struct stat info;
+        if (fstat(file, &info) != 0 || !mapFile(file, static_cast<size_t>(info.st_size))) {
+            ::close(file);
+            return false;
+        }
+        return true;
+    }
+
+public:
+    ResultCache()
+        : fd(-1), header(nullptr), entries(nullptr), mappedSize(0), mask(0), cacheFingerprint(0), growFailed(false),
+          hits(0), misses(0), stores(0), skipped(0), added(0)
+    {
+    }
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    ~ResultCache() { close(); }
+
+    // Public function: Open (or create) the cache at path for a database with the given
+    // fingerprint, sized for about expectedEntries files. A cache built against another
+    // database, or not a cache at all, is replaced by an empty one. The table grows as
+    // results are stored, so expectedEntries only saves rehashes when it is known up front.
+    bool open(const string& path, uint64_t fingerprint, size_t expectedEntries, string& error)
+    {
+        close();
+        cachePath = path;
+        cacheFingerprint = fingerprint;
+        growFailed = false;
+        size_t wanted = 1024;
+        while (wanted < expectedEntries * 2)
+            wanted *= 2;
+
+        if (!mapPath(path) || header->databaseFingerprint != fingerprint) {
+            unmap();
+            if (!createFile(path, fingerprint, wanted, false, error) || !mapPath(path)) {
+                if (error.empty())
+                    error = "Error opening cache " + path;
+                return false;
+            }
+        }
+
+        // After a crash: finish or discard entries that were being written, and recount
+        if (header->clean == 0) {
+            uint64_t count = 0;
+            for (size_t i = 0; i <= mask; i++) {
+                if ((entries[i].sequence & 1) != 0)
+                    entries[i].sequence++; // Checksum no longer matches, so it reads as a miss
+                count += entries[i].sequence != 0;
+            }
+            header->count = count;
+        }
+
+        // Keep the table at most half full so probes stay short
+        size_t needed = max<size_t>(wanted, static_cast<size_t>(header->count) * 2);
+        if (needed > mask + 1) {
+            size_t capacity = mask + 1;
+            while (capacity < needed)
+                capacity *= 2;
+            if (!createFile(path, fingerprint, capacity, true, error))
+                return false;
+            unmap();
+            if (!mapPath(path)) {
+                error = "Error opening cache " + path;
+                return false;
+            }
+        }
+
+        header->clean = 0;
+        msync(header, sizeof(ResultCacheHeader), MS_SYNC);
+        return true;
+    }
+
+    // Public function: Flush to disk and mark the file cleanly closed
+    void close()
+    {
+        if (header == nullptr)
+            return;
+        header->count += added.exchange(0);
+        msync(header, mappedSize, MS_SYNC);
+        header->clean = 1;
+        msync(header, sizeof(ResultCacheHeader), MS_SYNC);
+        unmap();
+    }
+
+    bool isOpen() const { return header != nullptr; }
+
+    // Public function: Restore the header bytes, verdict, container type and content class
+    // stored for this version of the file. Returns false (a miss) if there is none or the file has changed.
+    bool lookup(const CacheKey& key, FileHeader& fileHeader, Verdict& verdict, ContainerType& container, ContentClass& content)
+    {
+        shared_lock<shared_mutex> lock(resizing);
+        size_t slot = slotFor(key);
+        for (size_t probe = 0; probe < RESULT_CACHE_MAX_PROBES; probe++, slot = (slot + 1) & mask) {
+            const ResultCacheEntry& shared = entries[slot];
+            uint32_t before = __atomic_load_n(&shared.sequence, __ATOMIC_ACQUIRE);
+            if (before == 0)
+                break;
+            ResultCacheEntry entry;
+            memcpy(&entry, &shared, sizeof(entry));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if ((before & 1) != 0 || __atomic_load_n(&shared.sequence, __ATOMIC_RELAXED) != before)
+                break; // Being written right now
+            if (!sameFile(entry, key))
+                continue;
+            if (entry.size != key.size || entry.mtimeNs != key.mtimeNs || entry.checksum != entryChecksum(entry))
+                break;
+
+            fileHeader.clearPlan();
+            size_t start = 0;
+            for (size_t i = 0; i < entry.segmentCount; i++) {
+                fileHeader.planRead(entry.segmentOffset[i], entry.segmentLength[i]);
+            }
+            if (fileHeader.segmentCount != entry.segmentCount)
+                break;
+            for (size_t i = 0; i < entry.segmentCount; i++) {
+                memcpy(fileHeader.bytes + fileHeader.segments[i].start, entry.bytes + start, entry.segmentRead[i]);
+                fileHeader.setRead(i, entry.segmentRead[i]);
+                start += entry.segmentRead[i];
+            }
+            verdict = static_cast<Verdict>(entry.verdict);
+            container = static_cast<ContainerType>(entry.container);
+            content = static_cast<ContentClass>(entry.content);
+            hits.fetch_add(1, memory_order_relaxed);
+            return true;
+        }
+        misses.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+
+    // Public function: Remember a finished check. Only matches and mismatches are stored;
+    // read errors may be transient and unknown extensions never open the file anyway.
+    void store(const CacheKey& key, const FileHeader& fileHeader, Verdict verdict, ContainerType container,
+               ContentClass content = CONTENT_NONE)
+    {
+        if (verdict != MATCH && verdict != MISMATCH)
+            return;
+
+        ResultCacheEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.device = key.device;
+        entry.inode = key.inode;
+        entry.size = key.size;
+        entry.mtimeNs = key.mtimeNs;
+        entry.extensionHash = key.extensionHash;
+        entry.verdict = static_cast<uint8_t>(verdict);
+        entry.container = static_cast<uint8_t>(container);
+        entry.content = static_cast<uint8_t>(content);
+        size_t used = 0;
+        bool fits = fileHeader.segmentCount <= RESULT_CACHE_SEGMENTS;
+        for (size_t i = 0; fits && i < fileHeader.segmentCount; i++) {
+            const ReadSegment& segment = fileHeader.segments[i];
+            fits = used + segment.read <= RESULT_CACHE_BYTES;
+            if (fits) {
+                entry.segmentOffset[i] = segment.offset;
+                entry.segmentLength[i] = static_cast<uint16_t>(segment.length);
+                entry.segmentRead[i] = static_cast<uint16_t>(segment.read);
+                memcpy(entry.bytes + used, fileHeader.bytes + segment.start, segment.read);
+                used += segment.read;
+            }
+        }
+        if (!fits) {
+            skipped.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+        entry.segmentCount = static_cast<uint8_t>(fileHeader.segmentCount);
+        entry.checksum = entryChecksum(entry);
+
+        // A crowded table is grown and the store tried once more
+        for (int attempt = 0; attempt < 2; attempt++) {
+            Placement placement;
+            size_t capacity;
+            bool full;
+            {
+                shared_lock<shared_mutex> lock(resizing);
+                placement = place(key, entry);
+                if (placement == PLACED_NEW)
+                    added.fetch_add(1, memory_order_relaxed);
+                capacity = mask + 1;
+                full = crowded() && !growFailed;
+            }
+            if (placement == PLACED_NEW || placement == PLACED_UPDATE) {
+                stores.fetch_add(1, memory_order_relaxed);
+                if (full)
+                    grow(capacity);
+                return;
+            }
+            if (placement == SLOT_BUSY || !grow(capacity))
+                break;
+        }
+        skipped.fetch_add(1, memory_order_relaxed);
+    }
+
+    // Public function: Counts since the cache was opened
+    CacheStats stats() const
+    {
+        CacheStats s;
+        s.hits = hits.load(memory_order_relaxed);
+        s.misses = misses.load(memory_order_relaxed);
+        s.stores = stores.load(memory_order_relaxed);
+        s.skipped = skipped.load(memory_order_relaxed);
+        return s;
+    }
+};
+
+// Answer a prepared check from the cache: no open, no read, no signature loop. On a hit
+// result is complete (the reverse index still names mismatched files from the cached bytes).
+// On a miss key is left filled in for ResultCache::store, or keyOk is false if stat failed.
+inline bool checkFromCache(ResultCache& cache, CheckResult& result, const SignatureTrie* reverse, CacheKey& key, bool& keyOk) {
+    keyOk = makeCacheKey(result, key);
+    Verdict verdict;
+    ContainerType container;
+    ContentClass content;
+    if (!keyOk || !cache.lookup(key, result.header, verdict, container, content))
+        return false;
+    result.verdict = verdict;
+    result.container = container;
+    result.content = content;
+    if (verdict == MISMATCH && reverse != nullptr)
+        reverse->match(result.header, result.detectedTypes);
+    if (verdict == MISMATCH)
+        applyContainerType(result);
+    return true;
+}
+
+#endif
@@ -0,0 +1,88 @@
+// Opening files to check: symlinks are not followed, nothing waits, only regular files are read
+#ifndef SAFE_OPEN_H
+#define SAFE_OPEN_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Flags every check opens a file with. O_NOFOLLOW keeps a symlink from leading the scan
+// out of the tree it was given; O_NONBLOCK makes opening a FIFO with no writer (or a
+// device that waits for carrier) return at once, so fstat can turn it away; O_NOCTTY keeps
+// a terminal from becoming ours.
+const int CHECK_OPEN_FLAGS = O_RDONLY | O_CLOEXEC | O_NOFOLLOW | O_NONBLOCK | O_NOCTTY;
+
+// Why a file was skipped rather than read. Stored in CheckResult::error next to errno
+// values, so they start well above any errno and fit the 16 bits result files keep.
+enum SkipReason : int {
+    SKIP_SYMLINK = 4096, // Final component is a symbolic link
+    SKIP_DIRECTORY,
+    SKIP_FIFO,
+    SKIP_DEVICE,         // Character or block device
+    SKIP_SOCKET,
+    SKIP_TIMED_OUT       // I/O did not finish within the deadline
+};
+
+// The skip reason for a file of this type, or 0 for a regular file
+inline int skipReasonFor(mode_t mode) {
+    if (S_ISREG(mode))
+        return 0;
+    if (S_ISDIR(mode))
+        return SKIP_DIRECTORY;
+    if (S_ISFIFO(mode))
+        return SKIP_FIFO;
+    if (S_ISSOCK(mode))
+        return SKIP_SOCKET;
+    if (S_ISLNK(mode))
+        return SKIP_SYMLINK;
+    return SKIP_DEVICE;
+}
+
+// An open error as a check reports it: with O_NOFOLLOW, ELOOP means the path is a symlink
+inline int openErrorReason(int error) {
+    return error == ELOOP ? SKIP_SYMLINK : error;
+}
+
+// Text for CheckResult::error: our own wording for skipped files, strerror otherwise
+inline const char* readErrorText(int error) {
+    switch (error) {
+        case SKIP_SYMLINK: return "Symbolic link (not followed)";
+        case SKIP_DIRECTORY: return "Is a directory (not read)";
+        case SKIP_FIFO: return "FIFO (not read)";
+        case SKIP_DEVICE: return "Device file (not read)";
+        case SKIP_SOCKET: return "Socket (not read)";
+        case SKIP_TIMED_OUT: return "I/O deadline passed";
+    }
+    return strerror(error);
+}
+
+// Open path with CHECK_OPEN_FLAGS and make sure it is a regular file. Returns the descriptor
+// and sets size from fstat (so nobody seeks to the end to learn it), or returns -1 with error
+// set to an errno or a SkipReason.
+inline int openRegularFile(const char* path, int& error, uint64_t& size) {
+    int fd = ::open(path, CHECK_OPEN_FLAGS);
+    if (fd < 0) {
+        error = openErrorReason(errno);
+        return -1;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        error = errno;
+        ::close(fd);
+        return -1;
+    }
+    error = skipReasonFor(info.st_mode);
+    if (error != 0) {
+        ::close(fd);
+        return -1;
+    }
+    size = static_cast<uint64_t>(info.st_size);
+    return fd;
+}
+
+#endif
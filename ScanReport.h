@@ -0,0 +1,386 @@
+// Report mode: aggregate counts for very large scans, in memory that does not grow with the file count
+#ifndef SCAN_REPORT_H
+#define SCAN_REPORT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "AsyncLogger.h"
+#include "FileUtils.h"
+
+using namespace std;
+
+enum ReportFormat { REPORT_CSV, REPORT_JSON };
+
+// Settings for a report
+struct ReportOptions {
+    string path;                      // Where the report is written
+    ReportFormat format = REPORT_JSON;
+    size_t topDirectories = 20;       // Directories with the most mismatches listed
+    size_t unknownExtensions = 1024;  // Extensions outside the database counted by name; the rest go to "(other)"
+    size_t matrixCells = 16384;       // Claimed/detected pairs counted; the rest go to "(other)"
+};
+
+// Verdict counts for one extension (or for the whole scan)
+struct ExtensionCounts {
+    uint64_t checked = 0;
+    uint64_t matched = 0;
+    uint64_t mismatched = 0;
+    uint64_t unknown = 0;
+    uint64_t errors = 0;
+
+    void add(Verdict verdict)
+    {
+        checked++;
+        matched += verdict == MATCH;
+        mismatched += verdict == MISMATCH;
+        unknown += verdict == UNKNOWN_EXTENSION;
+        errors += verdict == READ_ERROR;
+    }
+
+    void add(const ExtensionCounts& other)
+    {
+        checked += other.checked;
+        matched += other.matched;
+        mismatched += other.mismatched;
+        unknown += other.unknown;
+        errors += other.errors;
+    }
+};
+
+// The keys seen most often in a stream, in a fixed number of counters (Space-Saving, Metwally
+// et al.): a new key takes over the smallest counter and inherits its count, so every count
+// is at most overcount too high, and any key seen more often than the smallest count is kept.
+class HeavyHitters {
+public:
+    struct Counter {
+        string key;
+        uint64_t count;
+        uint64_t overcount; // Upper bound on how much of count belongs to earlier keys
+    };
+
+private:
+    size_t capacity;
+    vector<Counter> counters;
+    unordered_map<string, size_t> slots; // Key -> index in counters
+
+public:
+    explicit HeavyHitters(size_t counterCount = 1024)
+        : capacity(max<size_t>(counterCount, 1))
+    {
+        counters.reserve(capacity);
+        slots.reserve(capacity);
+    }
+
+    // Public function: Count key n times; over is carried in from a merged summary
+    void add(const string& key, uint64_t n = 1, uint64_t over = 0)
+    {
+        auto it = slots.find(key);
+        if (it != slots.end()) {
+            counters[it->second].count += n;
+            counters[it->second].overcount += over;
+            return;
+        }
+        if (counters.size() < capacity) {
+            slots.emplace(key, counters.size());
+            counters.push_back({ key, n, over });
+            return;
+        }
+        size_t smallest = 0;
+        for (size_t i = 1; i < counters.size(); i++) {
+            if (counters[i].count < counters[smallest].count)
+                smallest = i;
+        }
+        Counter& victim = counters[smallest];
+        slots.erase(victim.key);
+        uint64_t floor = victim.count;
+        victim = { key, floor + n, floor + over };
+        slots.emplace(key, smallest);
+    }
+
+    // Public function: Fold another summary into this one
+    void merge(const HeavyHitters& other)
+    {
+        for (const Counter& counter : other.counters)
+            add(counter.key, counter.count, counter.overcount);
+    }
+
+    // Public function: The n largest counts, largest first
+    vector<Counter> top(size_t n) const
+    {
+        vector<Counter> sorted = counters;
+        sort(sorted.begin(), sorted.end(), [](const Counter& a, const Counter& b) {
+            return a.count != b.count ? a.count > b.count : a.key < b.key;
+        });
+        if (sorted.size() > n)
+            sorted.resize(n);
+        return sorted;
+    }
+};
+
+// One worker's counters, merged into the report when the worker is done. Extensions of the
+// database have fixed ids shared by all tallies; other extensions and claimed/detected pairs
+// are counted by name up to a cap, past which they land in "(other)".
+struct ReportTally {
+    ExtensionCounts total;
+    vector<ExtensionCounts> known;                      // By database extension id
+    unordered_map<string, ExtensionCounts> unknown;     // Extensions outside the database
+    ExtensionCounts otherUnknown;                       // Past the unknown cap
+    unordered_map<uint64_t, uint64_t> matrix;           // (claimed id << 32 | detected id) -> mismatches
+    uint64_t otherPairs = 0;                            // Past the matrix cap
+    HeavyHitters directories;
+
+    ReportTally(size_t knownCount, const ReportOptions& options)
+        : known(knownCount), directories(max<size_t>(1024, options.topDirectories * 16))
+    {
+        unknown.reserve(options.unknownExtensions);
+        matrix.reserve(options.matrixCells);
+    }
+};
+
+// Collects the tallies of a scan and writes the report. Memory is bounded by the database
+// size and the caps in ReportOptions, however many files are scanned.
+class ScanReport {
+private:
+    static const uint32_t NO_TYPE = UINT32_MAX; // Detected column of a mismatch nothing explains
+
+    ReportOptions options;
+    vector<string> names;                    // Database extensions by id
+    unordered_map<string, uint32_t> ids;     // And back
+    mutex lock;
+    ReportTally merged;
+
+    // Utility function: The report's name for an extension
+    static string label(const string& extension) { return extension.empty() ? "(none)" : extension; }
+
+    // Utility function: Append a CSV field, quoted if it needs to be
+    static void appendCsv(string& out, const string& field)
+    {
+        if (field.find_first_of(",\"\n\r") == string::npos) {
+            out += field;
+            return;
+        }
+        out += '"';
+        for (char c : field) {
+            if (c == '"')
+                out += '"';
+            out += c;
+        }
+        out += '"';
+    }
+
+    string pairName(uint32_t id) const { return id == NO_TYPE ? "(none)" : names[id]; }
+
+    // Utility function: Every per-extension row, database extensions first, then the rest by name
+    vector<pair<string, ExtensionCounts>> extensionRows() const
+    {
+        vector<pair<string, ExtensionCounts>> rows;
+        for (size_t id = 0; id < names.size(); id++) {
+            if (merged.known[id].checked > 0)
+                rows.emplace_back(names[id], merged.known[id]);
+        }
+        size_t firstUnknown = rows.size();
+        for (const auto& entry : merged.unknown)
+            rows.emplace_back(label(entry.first), entry.second);
+        sort(rows.begin() + static_cast<ptrdiff_t>(firstUnknown), rows.end(),
+             [](const pair<string, ExtensionCounts>& a, const pair<string, ExtensionCounts>& b) { return a.first < b.first; });
+        if (merged.otherUnknown.checked > 0)
+            rows.emplace_back("(other)", merged.otherUnknown);
+        return rows;
+    }
+
+    // Utility function: Claimed/detected cells, most mismatches first
+    vector<pair<uint64_t, uint64_t>> matrixRows() const
+    {
+        vector<pair<uint64_t, uint64_t>> cells(merged.matrix.begin(), merged.matrix.end());
+        sort(cells.begin(), cells.end(), [](const pair<uint64_t, uint64_t>& a, const pair<uint64_t, uint64_t>& b) {
+            return a.second != b.second ? a.second > b.second : a.first < b.first;
+        });
+        return cells;
+    }
+
+    void writeCsv(string& out) const
+    {
+        out += "section,extension,detected,directory,files,matched,mismatched,unknown,read_errors\n";
+        auto counts = [&out](const ExtensionCounts& c) {
+            out += to_string(c.checked) + "," + to_string(c.matched) + "," + to_string(c.mismatched) + ","
+                + to_string(c.unknown) + "," + to_string(c.errors) + "\n";
+        };
+        out += "total,,,,";
+        counts(merged.total);
+        for (const auto& row : extensionRows()) {
+            out += "extension,";
+            appendCsv(out, row.first);
+            out += ",,,";
+            counts(row.second);
+        }
+        for (const auto& cell : matrixRows()) {
+            out += "claimed_vs_detected,";
+            appendCsv(out, names[cell.first >> 32]);
+            out += ',';
+            appendCsv(out, pairName(static_cast<uint32_t>(cell.first)));
+            out += ",,,," + to_string(cell.second) + ",,\n";
+        }
+        if (merged.otherPairs > 0)
+            out += "claimed_vs_detected,(other),(other),,,," + to_string(merged.otherPairs) + ",,\n";
+        for (const HeavyHitters::Counter& dir : merged.directories.top(options.topDirectories)) {
+            out += "directory,,,";
+            appendCsv(out, dir.key);
+            out += ",,," + to_string(dir.count) + ",,\n";
+        }
+    }
+
+    void writeJson(string& out) const
+    {
+        auto counts = [&out](const ExtensionCounts& c) {
+            out += "\"files\":" + to_string(c.checked) + ",\"matched\":" + to_string(c.matched) + ",\"mismatched\":"
+                + to_string(c.mismatched) + ",\"unknown\":" + to_string(c.unknown) + ",\"read_errors\":" + to_string(c.errors);
+        };
+        out += "{\"total\":{";
+        counts(merged.total);
+        out += "},\n\"extensions\":[";
+        bool first = true;
+        for (const auto& row : extensionRows()) {
+            out += first ? "\n" : ",\n";
+            first = false;
+            out += "{\"extension\":";
+            appendJsonString(out, row.first);
+            out += ',';
+            counts(row.second);
+            out += '}';
+        }
+        out += "],\n\"claimed_vs_detected\":[";
+        first = true;
+        for (const auto& cell : matrixRows()) {
+            out += first ? "\n" : ",\n";
+            first = false;
+            out += "{\"claimed\":";
+            appendJsonString(out, names[cell.first >> 32]);
+            out += ",\"detected\":";
+            appendJsonString(out, pairName(static_cast<uint32_t>(cell.first)));
+            out += ",\"files\":" + to_string(cell.second) + "}";
+        }
+        out += "],\n\"other_pairs\":" + to_string(merged.otherPairs);
+        out += ",\n\"top_directories\":[";
+        first = true;
+        for (const HeavyHitters::Counter& dir : merged.directories.top(options.topDirectories)) {
+            out += first ? "\n" : ",\n";
+            first = false;
+            out += "{\"directory\":";
+            appendJsonString(out, dir.key);
+            out += ",\"mismatched\":" + to_string(dir.count) + ",\"overcount\":" + to_string(dir.overcount) + "}";
+        }
+        out += "]}\n";
+    }
+
+public:
+    // extensions are the database's, e.g. from ExtensionResolver::extensions()
+    ScanReport(const vector<string>& extensions, const ReportOptions& reportOptions)
+        : options(reportOptions), names(extensions), merged(extensions.size(), reportOptions)
+    {
+        for (size_t id = 0; id < names.size(); id++)
+            ids.emplace(names[id], static_cast<uint32_t>(id));
+    }
+
+    ScanReport(const ScanReport&) = delete;
+    ScanReport& operator=(const ScanReport&) = delete;
+
+    // Public function: A tally for one worker
+    ReportTally makeTally() const { return ReportTally(names.size(), options); }
+
+    // Public function: Count one result into a worker's tally. Only reads the report.
+    void add(ReportTally& tally, const CheckResult& result) const
+    {
+        tally.total.add(result.verdict);
+        auto id = ids.find(result.extension);
+        if (id != ids.end()) {
+            tally.known[id->second].add(result.verdict);
+        } else {
+            auto it = tally.unknown.find(result.extension);
+            if (it != tally.unknown.end())
+                it->second.add(result.verdict);
+            else if (tally.unknown.size() < options.unknownExtensions)
+                tally.unknown[result.extension].add(result.verdict);
+            else
+                tally.otherUnknown.add(result.verdict);
+        }
+        if (result.verdict != MISMATCH)
+            return;
+
+        // The first detected type is the one with the longest matching signature
+        uint32_t detected = NO_TYPE;
+        if (!result.detectedTypes.empty()) {
+            auto found = ids.find(result.detectedTypes[0]);
+            if (found != ids.end())
+                detected = found->second;
+        }
+        if (id != ids.end()) {
+            uint64_t key = uint64_t(id->second) << 32 | detected;
+            auto cell = tally.matrix.find(key);
+            if (cell != tally.matrix.end())
+                cell->second++;
+            else if (tally.matrix.size() < options.matrixCells)
+                tally.matrix.emplace(key, 1);
+            else
+                tally.otherPairs++;
+        }
+
+        size_t slash = result.path.find_last_of('/');
+        tally.directories.add(slash == string::npos ? string(".") : result.path.substr(0, slash == 0 ? 1 : slash));
+    }
+
+    // Public function: Fold a finished worker's tally into the report. Safe from any thread.
+    void merge(const ReportTally& tally)
+    {
+        lock_guard<mutex> guard(lock);
+        merged.total.add(tally.total);
+        for (size_t id = 0; id < names.size(); id++)
+            merged.known[id].add(tally.known[id]);
+        for (const auto& entry : tally.unknown) {
+            auto it = merged.unknown.find(entry.first);
+            if (it != merged.unknown.end())
+                it->second.add(entry.second);
+            else if (merged.unknown.size() < options.unknownExtensions)
+                merged.unknown.emplace(entry.first, entry.second);
+            else
+                merged.otherUnknown.add(entry.second);
+        }
+        merged.otherUnknown.add(tally.otherUnknown);
+        for (const auto& cell : tally.matrix) {
+            auto it = merged.matrix.find(cell.first);
+            if (it != merged.matrix.end())
+                it->second += cell.second;
+            else if (merged.matrix.size() < options.matrixCells)
+                merged.matrix.emplace(cell.first, cell.second);
+            else
+                merged.otherPairs += cell.second;
+        }
+        merged.otherPairs += tally.otherPairs;
+        merged.directories.merge(tally.directories);
+    }
+
+    // Public function: Write the report to its file. Returns false with error set on failure.
+    bool write(string& error)
+    {
+        lock_guard<mutex> guard(lock);
+        string out;
+        if (options.format == REPORT_CSV)
+            writeCsv(out);
+        else
+            writeJson(out);
+        ofstream file(options.path, ios::binary | ios::trunc);
+        file << out;
+        file.close();
+        if (!file) {
+            error = "Error writing report: " + options.path;
+            return false;
+        }
+        return true;
+    }
+};
+
+#endif
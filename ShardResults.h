@@ -0,0 +1,481 @@
+// Sharded scans: which paths a shard checks, and the sorted result files shards write and merge
+#ifndef SHARD_RESULTS_H
+#define SHARD_RESULTS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "FileUtils.h"
+
+using namespace std;
+
+// Which slice of the paths this process checks: the paths whose hash modulo count is index.
+// Paths are hashed as given (so every shard must be started with the same arguments, from
+// the same directory), or by their directory so that a subtree's files stay together.
+struct ShardSpec {
+    uint32_t index = 0;
+    uint32_t count = 1;
+    bool byDirectory = false;
+
+    // Public function: Parse "i/N" with 0 <= i < N. Returns false if malformed.
+    bool parse(const string& text)
+    {
+        unsigned long i = 0, n = 0;
+        char slash = 0, extra = 0;
+        if (sscanf(text.c_str(), "%lu%c%lu%c", &i, &slash, &n, &extra) != 3 || slash != '/' || n == 0 || i >= n
+            || n > UINT32_MAX)
+            return false;
+        index = static_cast<uint32_t>(i);
+        count = static_cast<uint32_t>(n);
+        return true;
+    }
+
+    // Public function: Does this shard check path?
+    bool contains(const string& path) const
+    {
+        if (count <= 1)
+            return true;
+        size_t length = path.size();
+        if (byDirectory) {
+            size_t slash = path.find_last_of('/');
+            length = slash == string::npos ? 0 : slash;
+        }
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < length; i++) {
+            hash ^= static_cast<unsigned char>(path[i]);
+            hash *= 1099511628211ull;
+        }
+        return hash % count == index;
+    }
+};
+
+// Result files: a fixed header, then one record per file sorted by path (bytewise), so the
+// files of all shards merge in a single pass. Records are
+//   u32 length (excluding itself), u8 verdict, u8 content, u16 error,
+//   u16 pathLength, u16 extensionLength, u16 signatureLength, u16 detectedLength,
+//   then the path, extension, signature (as printed) and detected types (comma separated).
+// Integers are in host byte order; result files are meant for the machines of one scan.
+const char RESULT_FILE_MAGIC[8] = { 'F', 'C', 'R', 'E', 'S', '1', '\n', '\0' };
+const size_t RESULT_RECORD_FIXED = 16; // Bytes of a record before its strings, length included
+const size_t RESULT_RECORD_MAX = RESULT_RECORD_FIXED + 4 * 0xFFFF; // Every string at its cap
+
+struct ResultFileHeader {
+    char magic[8];
+    uint32_t shardIndex;
+    uint32_t shardCount;
+    uint64_t records;
+    uint64_t counts[4];   // Per Verdict
+    uint32_t byDirectory;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(ResultFileHeader) == 64, "result file header layout");
+
+// Utility function: Append a length-capped string and return how much was appended
+inline uint16_t appendCapped(string& out, const string& text) {
+    size_t length = min<size_t>(text.size(), 0xFFFF);
+    out.append(text, 0, length);
+    return static_cast<uint16_t>(length);
+}
+
+// Append the record for one finished check
+inline void encodeResultRecord(string& out, const CheckResult& result) {
+    size_t start = out.size();
+    out.resize(start + RESULT_RECORD_FIXED);
+    string detected;
+    for (size_t t = 0; t < result.detectedTypes.size(); t++) {
+        if (t > 0)
+            detected += ',';
+        detected += result.detectedTypes[t];
+    }
+    uint16_t lengths[4];
+    lengths[0] = appendCapped(out, result.path);
+    lengths[1] = appendCapped(out, result.extension);
+    lengths[2] = result.verdict == MATCH || result.verdict == MISMATCH ? appendCapped(out, result.signatureHex()) : 0;
+    lengths[3] = appendCapped(out, detected);
+
+    uint32_t length = static_cast<uint32_t>(out.size() - start - sizeof(uint32_t));
+    uint8_t verdict = static_cast<uint8_t>(result.verdict);
+    uint8_t content = static_cast<uint8_t>(result.content);
+    uint16_t error = static_cast<uint16_t>(min(result.error, 0xFFFF));
+    char* fixed = &out[start];
+    memcpy(fixed, &length, 4);
+    memcpy(fixed + 4, &verdict, 1);
+    memcpy(fixed + 5, &content, 1);
+    memcpy(fixed + 6, &error, 2);
+    memcpy(fixed + 8, lengths, sizeof(lengths));
+}
+
+// One decoded record; the strings point into the buffer it was decoded from
+struct ResultRecord {
+    Verdict verdict = UNKNOWN_EXTENSION;
+    ContentClass content = CONTENT_NONE;
+    int error = 0;
+    string_view path;
+    string_view extension;
+    string_view signature;
+    string_view detected;
+};
+
+// Decode the record at data (length prefix included). Returns false if it is malformed.
+inline bool decodeResultRecord(const char* data, size_t size, ResultRecord& record) {
+    if (size < RESULT_RECORD_FIXED)
+        return false;
+    uint32_t length;
+    uint16_t error;
+    uint16_t lengths[4];
+    memcpy(&length, data, 4);
+    memcpy(&error, data + 6, 2);
+    memcpy(lengths, data + 8, sizeof(lengths));
+    size_t total = RESULT_RECORD_FIXED;
+    for (uint16_t l : lengths)
+        total += l;
+    if (size_t(length) + 4 != total || total > size || static_cast<uint8_t>(data[4]) > READ_ERROR)
+        return false;
+    record.verdict = static_cast<Verdict>(static_cast<uint8_t>(data[4]));
+    record.content = static_cast<ContentClass>(static_cast<uint8_t>(data[5]));
+    record.error = error;
+    const char* p = data + RESULT_RECORD_FIXED;
+    record.path = string_view(p, lengths[0]);
+    record.extension = string_view(p += lengths[0], lengths[1]);
+    record.signature = string_view(p += lengths[1], lengths[2]);
+    record.detected = string_view(p += lengths[2], lengths[3]);
+    return true;
+}
+
+// Path of an encoded record, for sorting without decoding the rest
+inline string_view recordPath(const char* data) {
+    uint16_t pathLength;
+    memcpy(&pathLength, data + 8, 2);
+    return string_view(data + RESULT_RECORD_FIXED, pathLength);
+}
+
+// Append the batch-mode line for a record, see appendResultLine
+inline void appendRecordLine(string& out, const ResultRecord& record) {
+    out += verdictName(record.verdict);
+    out += '\t';
+    out.append(record.path.data(), record.path.size());
+    out += '\t';
+    out.append(record.extension.data(), record.extension.size());
+    out += '\t';
+    if (record.verdict == READ_ERROR)
+        out += readErrorText(record.error);
+    else
+        out.append(record.signature.data(), record.signature.size());
+    if (!record.detected.empty()) {
+        out += '\t';
+        out.append(record.detected.data(), record.detected.size());
+    }
+    if (record.content != CONTENT_NONE) {
+        out += "\tcontent:";
+        out += contentName(record.content);
+    }
+    out += '\n';
+}
+
+// Sequential reader over a file of records (a sorted run, or a result file past its header)
+class RecordStream {
+private:
+    ifstream in;
+    string record;
+
+public:
+    bool failed = false; // A truncated or malformed record was met
+
+    explicit RecordStream(const string& path, size_t skip = 0)
+        : in(path, ios::binary)
+    {
+        if (in && skip > 0)
+            in.seekg(static_cast<streamoff>(skip));
+        failed = !in;
+    }
+
+    // Public function: Read the next record into current(). Returns false at the end.
+    bool next()
+    {
+        uint32_t length;
+        if (failed || !in.read(reinterpret_cast<char*>(&length), 4))
+            return false;
+        if (length + size_t(4) > RESULT_RECORD_MAX) {
+            failed = true; // A corrupt length; do not allocate for it
+            return false;
+        }
+        record.resize(4 + size_t(length));
+        memcpy(&record[0], &length, 4);
+        ResultRecord check;
+        if (length + size_t(4) < RESULT_RECORD_FIXED || !in.read(&record[4], length)
+            || !decodeResultRecord(record.data(), record.size(), check)) {
+            failed = true;
+            return false;
+        }
+        return true;
+    }
+
+    const string& current() const { return record; }
+};
+
+// Merge sorted record streams, calling emit(record bytes) in path order. Streams must
+// already hold their first record (next() returned true); exhausted ones drop out.
+template <typename Emit>
+void mergeRecordStreams(vector<RecordStream*>& streams, Emit emit) {
+    auto later = [&](size_t a, size_t b) {
+        string_view pa = recordPath(streams[a]->current().data());
+        string_view pb = recordPath(streams[b]->current().data());
+        return pa != pb ? pa > pb : a > b;
+    };
+    priority_queue<size_t, vector<size_t>, decltype(later)> heap(later);
+    for (size_t i = 0; i < streams.size(); i++)
+        heap.push(i);
+    while (!heap.empty()) {
+        size_t i = heap.top();
+        heap.pop();
+        emit(streams[i]->current());
+        if (streams[i]->next())
+            heap.push(i);
+    }
+}
+
+// Collects the records of a shard from any number of threads and writes them sorted by
+// path. Records are kept back to back in one buffer; past memoryLimit bytes the buffer
+// is sorted and spilled to a run file next to the output, and close() merges the runs,
+// so a shard of any size is written in bounded memory.
+class ResultFileWriter {
+private:
+    string path;
+    ResultFileHeader header;
+    mutex lock;
+    string buffer;            // Encoded records
+    vector<uint64_t> offsets; // Start of each record in buffer
+    vector<string> runs;      // Spilled run files
+    size_t memoryLimit;
+    bool ok = true;
+    string error;
+
+    // Utility function: Write the buffered records sorted by path, then forget them
+    bool writeSorted(ostream& out)
+    {
+        const char* base = buffer.data();
+        sort(offsets.begin(), offsets.end(),
+             [base](uint64_t a, uint64_t b) { return recordPath(base + a) < recordPath(base + b); });
+        for (uint64_t offset : offsets) {
+            uint32_t length;
+            memcpy(&length, base + offset, 4);
+            out.write(base + offset, 4 + static_cast<streamsize>(length));
+        }
+        buffer.clear();
+        offsets.clear();
+        return static_cast<bool>(out);
+    }
+
+    // Utility function: Spill the buffer to a new run file
+    void spill()
+    {
+        string runPath = path + ".run" + to_string(runs.size());
+        ofstream run(runPath, ios::binary | ios::trunc);
+        runs.push_back(runPath);
+        if (!run || !writeSorted(run)) {
+            ok = false;
+            error = "Error writing " + runPath;
+        }
+    }
+
+public:
+    ResultFileWriter(const string& outputPath, const ShardSpec& shard, size_t bufferBytes = 64 << 20)
+        : path(outputPath), memoryLimit(bufferBytes)
+    {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, RESULT_FILE_MAGIC, sizeof(header.magic));
+        header.shardIndex = shard.index;
+        header.shardCount = shard.count;
+        header.byDirectory = shard.byDirectory ? 1 : 0;
+    }
+
+    ResultFileWriter(const ResultFileWriter&) = delete;
+    ResultFileWriter& operator=(const ResultFileWriter&) = delete;
+
+    ~ResultFileWriter()
+    {
+        for (const string& run : runs)
+            remove(run.c_str());
+    }
+
+    // Public function: Take a block of encoded records. Safe to call from any number of threads.
+    void append(const string& records)
+    {
+        lock_guard<mutex> guard(lock);
+        for (size_t position = 0; position + 4 <= records.size();) {
+            uint32_t length;
+            memcpy(&length, records.data() + position, 4);
+            offsets.push_back(buffer.size() + position);
+            header.counts[static_cast<uint8_t>(records[position + 4])]++;
+            header.records++;
+            position += 4 + size_t(length);
+        }
+        buffer += records;
+        if (buffer.size() >= memoryLimit)
+            spill();
+    }
+
+    // Public function: Write the result file. Returns false with error set if anything failed.
+    bool close(string& message)
+    {
+        lock_guard<mutex> guard(lock);
+        ofstream out(path, ios::binary | ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        if (runs.empty()) {
+            writeSorted(out);
+        } else {
+            if (!offsets.empty())
+                spill();
+            vector<unique_ptr<RecordStream>> owned;
+            vector<RecordStream*> streams;
+            for (const string& run : runs) {
+                owned.push_back(make_unique<RecordStream>(run));
+                if (owned.back()->next())
+                    streams.push_back(owned.back().get());
+            }
+            mergeRecordStreams(streams, [&](const string& record) { out.write(record.data(), static_cast<streamsize>(record.size())); });
+            for (const unique_ptr<RecordStream>& stream : owned) {
+                if (stream->failed && ok) {
+                    ok = false;
+                    error = "Error reading back a sorted run of " + path;
+                }
+            }
+            for (const string& run : runs)
+                remove(run.c_str());
+            runs.clear();
+        }
+        out.close();
+        if (ok && !out) {
+            ok = false;
+            error = "Error writing " + path;
+        }
+        message = error;
+        return ok;
+    }
+};
+
+// Read and check a result file's header. Returns false with error set if it is not one.
+inline bool readResultFileHeader(const string& path, ResultFileHeader& header, string& error) {
+    ifstream in(path, ios::binary);
+    if (!in) {
+        error = "Error opening " + path;
+        return false;
+    }
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || memcmp(header.magic, RESULT_FILE_MAGIC, sizeof(header.magic)) != 0) {
+        error = path + " is not a result file";
+        return false;
+    }
+    if (header.shardCount == 0 || header.shardIndex >= header.shardCount) {
+        error = path + " names shard " + to_string(header.shardIndex) + "/" + to_string(header.shardCount)
+            + ", which does not exist; the file is corrupt";
+        return false;
+    }
+    return true;
+}
+
+// Merge the result files of a sharded scan: print every record in path order as a batch
+// line to out, optionally write them to mergedPath as one result file, and summarize on
+// report: the aggregate counts, plus any shard that is missing, repeated or from a
+// different split, and any path that more than one file reported.
+inline bool mergeResultFiles(const vector<string>& paths, const string& mergedPath, ostream& out, ostream& report) {
+    vector<ResultFileHeader> headers(paths.size());
+    vector<unique_ptr<RecordStream>> owned;
+    vector<RecordStream*> streams;
+    bool ok = true;
+    for (size_t i = 0; i < paths.size(); i++) {
+        string error;
+        if (!readResultFileHeader(paths[i], headers[i], error)) {
+            report << error << endl;
+            return false;
+        }
+        owned.push_back(make_unique<RecordStream>(paths[i], sizeof(ResultFileHeader)));
+        if (owned.back()->next())
+            streams.push_back(owned.back().get());
+    }
+
+    // Shard coverage
+    uint32_t shardCount = paths.empty() ? 0 : headers[0].shardCount;
+    vector<uint32_t> seen(shardCount, 0);
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (headers[i].shardCount != shardCount || headers[i].byDirectory != headers[0].byDirectory) {
+            report << "Warning: " << paths[i] << " comes from a different split (" << headers[i].shardIndex << "/"
+                   << headers[i].shardCount << ")" << endl;
+        } else if (seen[headers[i].shardIndex]++ > 0) {
+            report << "Warning: shard " << headers[i].shardIndex << "/" << shardCount << " appears more than once" << endl;
+        }
+    }
+    for (uint32_t s = 0; s < shardCount; s++) {
+        if (seen[s] == 0)
+            report << "Warning: shard " << s << "/" << shardCount << " is missing" << endl;
+    }
+
+    unique_ptr<ofstream> mergedOut;
+    ResultFileHeader mergedHeader;
+    memset(&mergedHeader, 0, sizeof(mergedHeader));
+    memcpy(mergedHeader.magic, RESULT_FILE_MAGIC, sizeof(mergedHeader.magic));
+    mergedHeader.shardCount = 1;
+    if (!mergedPath.empty()) {
+        mergedOut = make_unique<ofstream>(mergedPath, ios::binary | ios::trunc);
+        mergedOut->write(reinterpret_cast<const char*>(&mergedHeader), sizeof(mergedHeader));
+    }
+
+    uint64_t counts[4] = {};
+    uint64_t duplicates = 0;
+    string previous;
+    bool first = true;
+    string line;
+    ResultRecord record;
+    mergeRecordStreams(streams, [&](const string& bytes) {
+        decodeResultRecord(bytes.data(), bytes.size(), record);
+        if (!first && record.path == previous) {
+            duplicates++;
+            return;
+        }
+        first = false;
+        previous.assign(record.path.data(), record.path.size());
+        counts[record.verdict]++;
+        line.clear();
+        appendRecordLine(line, record);
+        out << line;
+        if (mergedOut)
+            mergedOut->write(bytes.data(), static_cast<streamsize>(bytes.size()));
+    });
+    out.flush();
+    for (size_t i = 0; i < owned.size(); i++) {
+        if (owned[i]->failed) {
+            report << "Error: " << paths[i] << " is truncated or corrupt; its remaining records were skipped" << endl;
+            ok = false;
+        }
+    }
+
+    if (mergedOut) {
+        mergedHeader.records = counts[0] + counts[1] + counts[2] + counts[3];
+        memcpy(mergedHeader.counts, counts, sizeof(counts));
+        mergedOut->seekp(0);
+        mergedOut->write(reinterpret_cast<const char*>(&mergedHeader), sizeof(mergedHeader));
+        mergedOut->close();
+        if (!*mergedOut) {
+            report << "Error writing " << mergedPath << endl;
+            ok = false;
+        }
+    }
+
+    uint64_t total = counts[0] + counts[1] + counts[2] + counts[3];
+    report << "Merged " << total << " files from " << paths.size() << " result files (" << shardCount << " shards)" << endl;
+    report << "  matches: " << counts[MATCH] << ", mismatches: " << counts[MISMATCH]
+           << ", unknown extensions: " << counts[UNKNOWN_EXTENSION] << ", read errors: " << counts[READ_ERROR] << endl;
+    if (duplicates > 0)
+        report << "  " << duplicates << " paths were reported by more than one file; the first was kept" << endl;
+    return ok;
+}
+
+#endif
@@ -0,0 +1,265 @@
+// Signatures decoded to raw bytes, plus conversions to and from the hex used in FileSignature.txt
+#ifndef SIGNATURE_H
+#define SIGNATURE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+using namespace std;
+
+// Longest signature we keep
+const size_t MAX_SIGNATURE_BYTES = 32;
+
+// Value of one hex digit, or -1 if the character is not a hex digit
+inline int hexDigitValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Decode a hex string such as "89504E47" into raw bytes. Returns false on malformed input.
+inline bool decodeHex(const string& hex, string& bytes) {
+    if (hex.size() % 2 != 0) {
+        return false;
+    }
+    bytes.clear();
+    bytes.reserve(hex.size() / 2);
+    for (size_t i = 0; i < hex.size(); i += 2) {
+        int high = hexDigitValue(hex[i]);
+        int low = hexDigitValue(hex[i + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        bytes.push_back(static_cast<char>((high << 4) | low));
+    }
+    return true;
+}
+
+// Encode raw bytes as uppercase hex, the format used in log.txt
+inline string encodeHex(const unsigned char* data, size_t size) {
+    static const char digits[] = "0123456789ABCDEF";
+    string hex(size * 2, '0');
+    for (size_t i = 0; i < size; i++) {
+        hex[2 * i] = digits[data[i] >> 4];
+        hex[2 * i + 1] = digits[data[i] & 0x0F];
+    }
+    return hex;
+}
+
+// Limits on what a single check reads: a handful of coalesced ranges, all landing
+// in one fixed buffer so reading a header never allocates
+const size_t MAX_READ_SEGMENTS = 8;
+const size_t MAX_HEADER_BYTES = 256;
+
+// One contiguous range of a file to read
+struct ReadSegment {
+    uint32_t offset = 0; // File offset
+    uint32_t length = 0; // Bytes wanted
+    uint32_t start = 0;  // Where the bytes go in FileHeader::bytes
+    uint32_t read = 0;   // Bytes actually read (fewer near the end of the file)
+};
+
+// The parts of a file a check needs: first a read plan (sorted, coalesced ranges), then
+// the bytes read for each range. Segments are stored back to back in bytes, so when the
+// plan starts at offset 0 the buffer begins with the file's first bytes.
+struct FileHeader {
+    unsigned char bytes[MAX_HEADER_BYTES] = {};
+    ReadSegment segments[MAX_READ_SEGMENTS];
+    size_t segmentCount = 0;
+    size_t size = 0;                            // Bytes read at offset 0 (the contiguous prefix)
+
+    // Start a new plan
+    void clearPlan()
+    {
+        segmentCount = 0;
+        size = 0;
+    }
+
+    // Add [offset, offset + length) to the plan, merging it with any range it overlaps or
+    // touches so the file is never read twice and nothing outside the signatures is read.
+    // Returns false if the plan would exceed the segment or byte limits.
+    bool planRead(uint32_t offset, uint32_t length)
+    {
+        if (length == 0)
+            return true;
+        uint64_t begin = offset;
+        uint64_t end = uint64_t(offset) + length;
+
+        // Absorb every existing range that overlaps or touches the new one
+        size_t kept = 0;
+        ReadSegment merged[MAX_READ_SEGMENTS];
+        for (size_t i = 0; i < segmentCount; i++) {
+            uint64_t b = segments[i].offset;
+            uint64_t e = b + segments[i].length;
+            if (e < begin || b > end) {
+                merged[kept++] = segments[i];
+            } else {
+                begin = min(begin, b);
+                end = max(end, e);
+            }
+        }
+        if (kept == MAX_READ_SEGMENTS || end - begin > MAX_HEADER_BYTES)
+            return false;
+
+        // Insert in offset order and lay the ranges out in the buffer
+        size_t position = 0;
+        while (position < kept && merged[position].offset < begin)
+            position++;
+        for (size_t i = kept; i > position; i--)
+            merged[i] = merged[i - 1];
+        merged[position].offset = static_cast<uint32_t>(begin);
+        merged[position].length = static_cast<uint32_t>(end - begin);
+
+        uint32_t start = 0;
+        for (size_t i = 0; i <= kept; i++) {
+            merged[i].start = start;
+            merged[i].read = 0;
+            start += merged[i].length;
+        }
+        if (start > MAX_HEADER_BYTES)
+            return false;
+        memcpy(segments, merged, (kept + 1) * sizeof(ReadSegment));
+        segmentCount = kept + 1;
+        return true;
+    }
+
+    // Total bytes the plan asks for
+    size_t plannedBytes() const
+    {
+        size_t total = 0;
+        for (size_t i = 0; i < segmentCount; i++)
+            total += segments[i].length;
+        return total;
+    }
+
+    // Is [offset, offset + length) already inside a planned range?
+    bool covers(uint32_t offset, uint32_t length) const
+    {
+        for (size_t i = 0; i < segmentCount; i++) {
+            if (offset >= segments[i].offset && uint64_t(offset) + length <= uint64_t(segments[i].offset) + segments[i].length)
+                return true;
+        }
+        return false;
+    }
+
+    // Forget what was read, keeping the plan
+    void clearReads()
+    {
+        for (size_t i = 0; i < segmentCount; i++)
+            segments[i].read = 0;
+        size = 0;
+    }
+
+    // After reading: record how much of segment i arrived (less than planned near the end of the file)
+    void setRead(size_t i, size_t bytesRead)
+    {
+        segments[i].read = static_cast<uint32_t>(min<size_t>(bytesRead, segments[i].length));
+        if (i == 0 && segments[0].offset == 0)
+            size = segments[0].read;
+    }
+
+    // Bytes read starting at a file offset; count is how many are available from there
+    const unsigned char* at(uint32_t offset, size_t& count) const
+    {
+        for (size_t i = 0; i < segmentCount; i++) {
+            const ReadSegment& segment = segments[i];
+            if (offset >= segment.offset && offset < segment.offset + segment.read) {
+                count = segment.offset + segment.read - offset;
+                return bytes + segment.start + (offset - segment.offset);
+            }
+        }
+        count = 0;
+        return nullptr;
+    }
+
+    // First eight bytes as one word, compared against ByteSignature::head
+    uint64_t head() const
+    {
+        uint64_t word;
+        memcpy(&word, bytes, sizeof(word));
+        return word;
+    }
+};
+
+// A signature decoded once at load time: length bytes expected at a file offset.
+// Offset 0 signatures match with a masked word compare on the first eight bytes and a
+// memcmp for anything longer, with no formatting involved.
+// Fixed width and trivially copyable, so compiled databases can store it as-is.
+struct ByteSignature {
+    uint64_t head = 0;                             // First (up to) eight bytes
+    uint64_t mask = 0;                             // Which bytes of head are significant
+    uint32_t length = 0;                           // Signature length in bytes
+    uint32_t offset = 0;                           // Where in the file the signature sits
+    unsigned char bytes[MAX_SIGNATURE_BYTES] = {}; // The full signature
+
+    // Is the signature present? headerWord is header.head(), loaded once per file.
+    bool matches(const FileHeader& header, uint64_t headerWord) const
+    {
+        if (offset != 0) {
+            size_t available = 0;
+            const unsigned char* data = header.at(offset, available);
+            return data != nullptr && available >= length && memcmp(bytes, data, length) == 0;
+        }
+        if (header.size < length || (headerWord & mask) != head)
+            return false;
+        return length <= sizeof(head)
+            || memcmp(bytes + sizeof(head), header.bytes + sizeof(head), length - sizeof(head)) == 0;
+    }
+
+    // Hex form, only built when something is logged. Offset signatures are shown as "@offset:hex".
+    string toHex() const
+    {
+        string hex = encodeHex(bytes, length);
+        return offset == 0 ? hex : "@" + to_string(offset) + ":" + hex;
+    }
+
+    bool operator==(const ByteSignature& other) const
+    {
+        return length == other.length && offset == other.offset && memcmp(bytes, other.bytes, length) == 0;
+    }
+};
+
+// Non-owning view of the signatures registered for one extension. Whatever index produced
+// it (tree, mapped database, ...) owns the records and must outlive the view.
+struct SignatureSpan {
+    const ByteSignature* data = nullptr;
+    size_t size = 0;
+    size_t maxLength = 0; // Longest signature at offset 0, i.e. the file prefix a check shows
+
+    const ByteSignature* begin() const { return data; }
+    const ByteSignature* end() const { return data + size; }
+    bool empty() const { return size == 0; }
+};
+
+// Plan the reads for a set of signatures. Returns false if some signature did not fit.
+inline bool planSignatureReads(const SignatureSpan& signatures, FileHeader& header) {
+    bool fits = true;
+    for (const ByteSignature& signature : signatures)
+        fits = header.planRead(signature.offset, signature.length) && fits;
+    return fits;
+}
+
+// Decode one hex signature from FileSignature.txt. Returns false if it is malformed or too long.
+inline bool parseSignature(const string& hex, ByteSignature& signature, uint32_t offset = 0) {
+    string decoded;
+    if (!decodeHex(hex, decoded) || decoded.empty() || decoded.size() > MAX_SIGNATURE_BYTES) {
+        return false;
+    }
+
+    signature = ByteSignature();
+    signature.length = static_cast<uint32_t>(decoded.size());
+    signature.offset = offset;
+    memcpy(signature.bytes, decoded.data(), decoded.size());
+
+    unsigned char maskBytes[sizeof(uint64_t)] = {};
+    memset(maskBytes, 0xFF, min(decoded.size(), sizeof(uint64_t)));
+    memcpy(&signature.mask, maskBytes, sizeof(signature.mask));
+    memcpy(&signature.head, signature.bytes, sizeof(signature.head));
+    signature.head &= signature.mask;
+    return true;
+}
+
+#endif
@@ -0,0 +1,377 @@
+// Precompiled signature database: FileSignature.txt compiled to a binary file that is mmapped and used in place
+#ifndef SIGNATURE_DATABASE_H
+#define SIGNATURE_DATABASE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ExtensionResolver.h"
+#include "FileUtils.h"
+
+using namespace std;
+
+// File layout (native byte order, every section 8-byte aligned):
+//   SignatureDbHeader
+//   SignatureDbExtension[extensionCount]  sorted by name, for binary search
+//   ByteSignature[signatureCount]         grouped by extension
+//   uint32_t[256], ResolverNode[resolverNodeCount], ResolverEdge[resolverEdgeCount]
+//                                         extension suffix trie (ExtensionResolver::flatten),
+//                                         names numbered by their SignatureDbExtension index
+const char SIGNATURE_DB_MAGIC[8] = { 'F', 'S', 'I', 'G', 'D', 'B', '\0', '\0' };
+const uint32_t SIGNATURE_DB_VERSION = 3; // 2: ByteSignature carries a file offset; 3: resolver trie
+const size_t SIGNATURE_DB_MAX_EXTENSION = 15; // Longest extension name stored inline
+
+struct SignatureDbHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t checksum;          // FNV-1a over everything after the header
+    uint32_t extensionCount;
+    uint32_t signatureCount;
+    uint32_t signatureRecordSize; // sizeof(ByteSignature) of the compiler; must match the reader
+    uint32_t reserved;
+    uint64_t extensionsOffset;
+    uint64_t signaturesOffset;
+    uint64_t fileSize;
+    uint64_t resolverOffset;    // Root table, then nodes, then edges
+    uint32_t resolverNodeCount;
+    uint32_t resolverEdgeCount;
+};
+
+struct SignatureDbExtension {
+    char name[SIGNATURE_DB_MAX_EXTENSION + 1]; // NUL padded
+    uint32_t firstSignature;
+    uint32_t signatureCount;
+    uint32_t maxLength;                        // Longest offset 0 signature for this extension, in bytes
+    uint32_t reserved;
+};
+
+// Where the resolver's nodes and edges start (the root table comes first; sections are 8-byte aligned)
+inline uint64_t signatureDbNodesOffset(const SignatureDbHeader& header) {
+    return header.resolverOffset + 256 * sizeof(uint32_t);
+}
+
+inline uint64_t signatureDbEdgesOffset(const SignatureDbHeader& header) {
+    return (signatureDbNodesOffset(header) + uint64_t(header.resolverNodeCount) * sizeof(ResolverNode) + 7) / 8 * 8;
+}
+
+// FNV-1a, 32 bit. Cheap and good enough to catch truncated or corrupted files.
+inline uint32_t signatureDbChecksum(const unsigned char* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Does the file at path start with the compiled database magic?
+inline bool isCompiledSignatureDatabase(const string& path) {
+    ifstream file(path, ios::binary);
+    char magic[sizeof(SIGNATURE_DB_MAGIC)] = {};
+    return file.read(magic, sizeof(magic)) && memcmp(magic, SIGNATURE_DB_MAGIC, sizeof(magic)) == 0;
+}
+
+// Compile FileSignature.txt (CSV) into the binary format. The output is written to a
+// temporary file and renamed into place, so readers never see a half-written database.
+inline bool compileSignatureDatabase(const string& csvPath, const string& dbPath, string& error) {
+    ifstream csv(csvPath);
+    if (!csv) {
+        error = "Error opening file: " + csvPath;
+        return false;
+    }
+
+    map<string, vector<ByteSignature>> grouped; // Sorted by extension, as the reader expects
+    string line;
+    string extension;
+    ByteSignature signature;
+    size_t lineNumber = 0;
+    while (getline(csv, line)) {
+        lineNumber++;
+        if (trim(line).empty())
+            continue;
+        if (!parseSignatureLine(line, extension, signature)) {
+            error = csvPath + ":" + to_string(lineNumber) + ": invalid line format: " + line;
+            return false;
+        }
+        if (extension.size() > SIGNATURE_DB_MAX_EXTENSION) {
+            error = csvPath + ":" + to_string(lineNumber) + ": extension longer than "
+                + to_string(SIGNATURE_DB_MAX_EXTENSION) + " characters: " + extension;
+            return false;
+        }
+        vector<ByteSignature>& signatures = grouped[extension];
+        if (find(signatures.begin(), signatures.end(), signature) == signatures.end())
+            signatures.push_back(signature);
+    }
+
+    vector<SignatureDbExtension> extensions;
+    vector<ByteSignature> signatures;
+    for (const auto& entry : grouped) {
+        SignatureDbExtension record;
+        memset(&record, 0, sizeof(record));
+        memcpy(record.name, entry.first.data(), entry.first.size());
+        record.firstSignature = static_cast<uint32_t>(signatures.size());
+        record.signatureCount = static_cast<uint32_t>(entry.second.size());
+        for (const ByteSignature& sig : entry.second) {
+            if (sig.offset == 0)
+                record.maxLength = max(record.maxLength, sig.length);
+            signatures.push_back(sig);
+        }
+        extensions.push_back(record);
+    }
+
+    ExtensionResolver resolver;
+    for (const auto& entry : grouped)
+        resolver.add(entry.first);
+    uint32_t resolverRoot[256];
+    vector<ResolverNode> resolverNodes;
+    vector<ResolverEdge> resolverEdges;
+    resolver.flatten([&](const string& name) { return static_cast<uint32_t>(distance(grouped.begin(), grouped.find(name))); },
+                     resolverRoot, resolverNodes, resolverEdges);
+
+    SignatureDbHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SIGNATURE_DB_MAGIC, sizeof(header.magic));
+    header.version = SIGNATURE_DB_VERSION;
+    header.extensionCount = static_cast<uint32_t>(extensions.size());
+    header.signatureCount = static_cast<uint32_t>(signatures.size());
+    header.signatureRecordSize = sizeof(ByteSignature);
+    header.extensionsOffset = sizeof(SignatureDbHeader);
+    header.signaturesOffset = header.extensionsOffset + extensions.size() * sizeof(SignatureDbExtension);
+    header.resolverOffset = (header.signaturesOffset + signatures.size() * sizeof(ByteSignature) + 7) / 8 * 8;
+    header.resolverNodeCount = static_cast<uint32_t>(resolverNodes.size());
+    header.resolverEdgeCount = static_cast<uint32_t>(resolverEdges.size());
+    uint64_t nodesOffset = signatureDbNodesOffset(header);
+    uint64_t edgesOffset = signatureDbEdgesOffset(header);
+    header.fileSize = edgesOffset + resolverEdges.size() * sizeof(ResolverEdge);
+
+    vector<unsigned char> image(header.fileSize, 0);
+    memcpy(image.data() + header.extensionsOffset, extensions.data(), extensions.size() * sizeof(SignatureDbExtension));
+    memcpy(image.data() + header.signaturesOffset, signatures.data(), signatures.size() * sizeof(ByteSignature));
+    memcpy(image.data() + header.resolverOffset, resolverRoot, sizeof(resolverRoot));
+    memcpy(image.data() + nodesOffset, resolverNodes.data(), resolverNodes.size() * sizeof(ResolverNode));
+    memcpy(image.data() + edgesOffset, resolverEdges.data(), resolverEdges.size() * sizeof(ResolverEdge));
+    header.checksum = signatureDbChecksum(image.data() + sizeof(header), image.size() - sizeof(header));
+    memcpy(image.data(), &header, sizeof(header));
+
+    string tempPath = dbPath + ".tmp";
+    {
+        ofstream out(tempPath, ios::binary | ios::trunc);
+        if (!out || !out.write(reinterpret_cast<const char*>(image.data()), image.size())) {
+            error = "Error writing file: " + tempPath;
+            return false;
+        }
+    }
+    if (rename(tempPath.c_str(), dbPath.c_str()) != 0) {
+        error = "Error renaming " + tempPath + " to " + dbPath;
+        return false;
+    }
+    return true;
+}
+
+// Names for the mapped resolver: a name number is an index into the extension table
+struct SignatureDbNames {
+    const SignatureDbExtension* extensions;
+
+    string_view operator()(uint32_t name) const
+    {
+        return string_view(extensions[name].name, strnlen(extensions[name].name, sizeof(extensions[name].name)));
+    }
+};
+
+// Read-only view of a compiled database, mapped straight from disk. Lookups are a
+// binary search over the inline extension names and hand out spans into the mapping;
+// paths are resolved on the trie stored in the file.
+class SignatureDatabase {
+private:
+    void* mapping;
+    size_t mappingSize;
+    const SignatureDbHeader* header;
+    const SignatureDbExtension* extensions;
+    const ByteSignature* signatures;
+    const uint32_t* resolverRoot;
+    const ResolverNode* resolverNodes;
+    const ResolverEdge* resolverEdges;
+
+    // Utility function: Is the stored trie safe to walk? Every index must stay inside the file.
+    bool resolverValid() const
+    {
+        if (header->resolverNodeCount == 0)
+            return false;
+        for (size_t i = 0; i < 256; i++) {
+            if (resolverRoot[i] != RESOLVER_NONE && resolverRoot[i] >= header->resolverNodeCount)
+                return false;
+        }
+        for (uint32_t i = 0; i < header->resolverNodeCount; i++) {
+            const ResolverNode& node = resolverNodes[i];
+            if (uint64_t(node.firstEdge) + node.edgeCount > header->resolverEdgeCount
+                || (node.name != RESOLVER_NONE && node.name >= header->extensionCount))
+                return false;
+        }
+        for (uint32_t i = 0; i < header->resolverEdgeCount; i++) {
+            if (resolverEdges[i].next >= header->resolverNodeCount)
+                return false;
+        }
+        return true;
+    }
+
+    // Utility function: Release the mapping, if any
+    void unmap()
+    {
+        if (mapping != nullptr)
+            munmap(mapping, mappingSize);
+        mapping = nullptr;
+        mappingSize = 0;
+        header = nullptr;
+        extensions = nullptr;
+        signatures = nullptr;
+        resolverRoot = nullptr;
+        resolverNodes = nullptr;
+        resolverEdges = nullptr;
+    }
+
+public:
+    SignatureDatabase()
+        : mapping(nullptr), mappingSize(0), header(nullptr), extensions(nullptr), signatures(nullptr),
+          resolverRoot(nullptr), resolverNodes(nullptr), resolverEdges(nullptr)
+    {
+    }
+
+    SignatureDatabase(const SignatureDatabase&) = delete;
+    SignatureDatabase& operator=(const SignatureDatabase&) = delete;
+
+    ~SignatureDatabase() { unmap(); }
+
+    // Public function: Map and validate a compiled database
+    bool open(const string& path, string& error)
+    {
+        unmap();
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            error = "Error opening file: " + path;
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SignatureDbHeader)) {
+            close(fd);
+            error = "Signature database is truncated: " + path;
+            return false;
+        }
+        mappingSize = static_cast<size_t>(st.st_size);
+        mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            mapping = nullptr;
+            error = "Error mapping file: " + path;
+            return false;
+        }
+
+        const unsigned char* base = static_cast<const unsigned char*>(mapping);
+        const SignatureDbHeader* h = reinterpret_cast<const SignatureDbHeader*>(base);
+        if (memcmp(h->magic, SIGNATURE_DB_MAGIC, sizeof(h->magic)) != 0) {
+            error = "Not a compiled signature database: " + path;
+        } else if (h->version != SIGNATURE_DB_VERSION || h->signatureRecordSize != sizeof(ByteSignature)) {
+            error = "Signature database " + path + " has version " + to_string(h->version)
+                + ", expected " + to_string(SIGNATURE_DB_VERSION) + "; recompile it with --compile-db";
+        } else if (h->fileSize != mappingSize
+                   || h->extensionsOffset + uint64_t(h->extensionCount) * sizeof(SignatureDbExtension) > mappingSize
+                   || h->signaturesOffset + uint64_t(h->signatureCount) * sizeof(ByteSignature) > mappingSize
+                   || h->resolverOffset > mappingSize
+                   || signatureDbEdgesOffset(*h) + uint64_t(h->resolverEdgeCount) * sizeof(ResolverEdge) > mappingSize) {
+            error = "Signature database is truncated: " + path;
+        } else if (signatureDbChecksum(base + sizeof(SignatureDbHeader), mappingSize - sizeof(SignatureDbHeader)) != h->checksum) {
+            error = "Signature database checksum mismatch: " + path;
+        } else {
+            header = h;
+            extensions = reinterpret_cast<const SignatureDbExtension*>(base + h->extensionsOffset);
+            signatures = reinterpret_cast<const ByteSignature*>(base + h->signaturesOffset);
+            resolverRoot = reinterpret_cast<const uint32_t*>(base + h->resolverOffset);
+            resolverNodes = reinterpret_cast<const ResolverNode*>(base + signatureDbNodesOffset(*h));
+            resolverEdges = reinterpret_cast<const ResolverEdge*>(base + signatureDbEdgesOffset(*h));
+            for (uint32_t i = 0; i < h->extensionCount; i++) {
+                if (uint64_t(extensions[i].firstSignature) + extensions[i].signatureCount > h->signatureCount) {
+                    error = "Signature database is corrupt: " + path;
+                    header = nullptr;
+                    break;
+                }
+            }
+            if (header != nullptr && !resolverValid()) {
+                error = "Signature database is corrupt: " + path;
+                header = nullptr;
+            }
+            if (header != nullptr)
+                return true;
+        }
+        unmap();
+        return false;
+    }
+
+    // Public function: Find the signatures for an extension without copying them
+    bool lookup(const string& extension, SignatureSpan& span) const
+    {
+        size_t low = 0;
+        size_t high = header == nullptr ? 0 : header->extensionCount;
+        while (low < high) {
+            size_t mid = (low + high) / 2;
+            int cmp = strncmp(extension.c_str(), extensions[mid].name, sizeof(extensions[mid].name));
+            if (cmp == 0) {
+                span.data = signatures + extensions[mid].firstSignature;
+                span.size = extensions[mid].signatureCount;
+                span.maxLength = extensions[mid].maxLength;
+                return true;
+            }
+            if (cmp < 0)
+                high = mid;
+            else
+                low = mid + 1;
+        }
+        span = SignatureSpan();
+        return false;
+    }
+
+    // Public function: Fill a reverse index from the decoded signatures (no text parsing)
+    void buildReverseIndex(SignatureTrie& reverse) const
+    {
+        if (header == nullptr)
+            return;
+        for (uint32_t i = 0; i < header->extensionCount; i++) {
+            const SignatureDbExtension& ext = extensions[i];
+            string name(ext.name, strnlen(ext.name, sizeof(ext.name)));
+            for (uint32_t j = 0; j < ext.signatureCount; j++) {
+                const ByteSignature& sig = signatures[ext.firstSignature + j];
+                reverse.insert(sig.bytes, sig.length, sig.offset, name);
+            }
+        }
+    }
+
+    // Public function: Resolves a path to the longest extension in the database it ends with
+    FlatExtensionResolver<SignatureDbNames> extensionResolver() const
+    {
+        if (header == nullptr) {
+            const EmptyResolverTrie& empty = emptyResolverTrie();
+            return FlatExtensionResolver<SignatureDbNames>(empty.root, &empty.node, nullptr, 1, SignatureDbNames{ nullptr });
+        }
+        return FlatExtensionResolver<SignatureDbNames>(resolverRoot, resolverNodes, resolverEdges, header->resolverNodeCount,
+                                                       SignatureDbNames{ extensions });
+    }
+
+    // Public function: Number of extensions and signatures
+    size_t extensionCount() const { return header == nullptr ? 0 : header->extensionCount; }
+    size_t signatureCount() const { return header == nullptr ? 0 : header->signatureCount; }
+};
+
+// Index lookup for the mapped database, see lookupSignatures for the tree
+inline bool lookupSignatures(const SignatureDatabase& database, const string& extension, SignatureSpan& span) {
+    return database.lookup(extension, span);
+}
+
+#endif
@@ -0,0 +1,143 @@
+// Versioned, hot-reloadable signature database for long-running checkers
+#ifndef SIGNATURE_STORE_H
+#define SIGNATURE_STORE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "EmbeddedIndex.h"
+#include "FileUtils.h"
+#include "FlatIndex.h"
+#include "SignatureDatabase.h"
+
+using namespace std;
+
+// One loaded database: the index, its reverse trie and a version number. Never modified
+// once published, so any number of checks may read it while a newer one is being built.
+template <typename Index>
+struct SignatureSnapshot {
+    Index index;
+    SignatureTrie reverse;
+    uint64_t version = 0;
+    string source; // Path it was loaded from
+};
+
+// Loaders for each index type, used to build a snapshot off to the side.
+// They return false with error filled in, leaving the caller's current snapshot alone.
+inline bool loadSignatureIndex(RedBlackTree<ByteSignature>& tree, SignatureTrie& reverse, const string& path, string& error) {
+    if (isCompiledSignatureDatabase(path)) {
+        error = path + " is a compiled database; restart to switch formats";
+        return false;
+    }
+    if (!LoadFileSignatures(tree, &reverse, path)) {
+        error = "Could not load " + path;
+        return false;
+    }
+    return true;
+}
+
+inline bool loadSignatureIndex(FlatSignatureIndex& index, SignatureTrie& reverse, const string& path, string& error) {
+    if (isCompiledSignatureDatabase(path)) {
+        error = path + " is a compiled database; restart to switch formats";
+        return false;
+    }
+    if (!LoadFileSignatures(index, &reverse, path)) {
+        error = "Could not load " + path;
+        return false;
+    }
+    return true;
+}
+
+inline bool loadSignatureIndex(SignatureDatabase& database, SignatureTrie& reverse, const string& path, string& error) {
+    if (!database.open(path, error))
+        return false;
+    database.buildReverseIndex(reverse);
+    return true;
+}
+
+// The embedded table is part of the program, so there is nothing to read; a reload only
+// rebuilds the reverse trie
+template <const EmbeddedSignatureTable& Table>
+bool loadSignatureIndex(EmbeddedSignatureIndex<Table>& index, SignatureTrie& reverse, const string&, string&) {
+    index.buildReverseIndex(reverse);
+    return true;
+}
+
+// Holds the current snapshot. reload() builds a complete new snapshot without touching the
+// current one, then publishes it with a single atomic pointer store. Readers that still hold
+// the old snapshot keep using it; it is freed when the last of them moves on.
+template <typename Index>
+class SignatureStore {
+private:
+    shared_ptr<const SignatureSnapshot<Index>> current; // Only accessed through atomic_load/atomic_store
+    atomic<uint64_t> publishedVersion;                  // Lets readers skip the pointer load when nothing changed
+    mutex reloadMutex;                                  // Serialises writers; readers never take it
+    uint64_t nextVersion;
+
+public:
+    SignatureStore()
+        : publishedVersion(0), nextVersion(1)
+    {
+    }
+
+    SignatureStore(const SignatureStore&) = delete;
+    SignatureStore& operator=(const SignatureStore&) = delete;
+
+    // Public function: Load path into a new snapshot and swap it in. On failure the current
+    // snapshot stays in place and error says why.
+    bool reload(const string& path, string& error)
+    {
+        lock_guard<mutex> lock(reloadMutex);
+        auto snapshot = make_shared<SignatureSnapshot<Index>>();
+        if (!loadSignatureIndex(snapshot->index, snapshot->reverse, path, error))
+            return false;
+        snapshot->version = nextVersion++;
+        snapshot->source = path;
+        shared_ptr<const SignatureSnapshot<Index>> published = move(snapshot);
+        atomic_store_explicit(&current, published, memory_order_release);
+        publishedVersion.store(published->version, memory_order_release);
+        return true;
+    }
+
+    // Public function: The current snapshot, kept alive for as long as the caller holds it.
+    // nullptr until the first successful reload.
+    shared_ptr<const SignatureSnapshot<Index>> acquire() const
+    {
+        return atomic_load_explicit(&current, memory_order_acquire);
+    }
+
+    // Public function: Version of the current snapshot (0 before the first load)
+    uint64_t version() const { return publishedVersion.load(memory_order_acquire); }
+};
+
+// Per-thread handle on a store. pin() costs one atomic load while the database is unchanged;
+// only after a reload does it fetch the new snapshot. The pinned snapshot stays valid until
+// the next pin(), so results that point into it (CheckResult::expected) can be used until then.
+template <typename Index>
+class SnapshotReader {
+private:
+    const SignatureStore<Index>& store;
+    shared_ptr<const SignatureSnapshot<Index>> pinned;
+    uint64_t pinnedVersion;
+
+public:
+    explicit SnapshotReader(const SignatureStore<Index>& signatureStore)
+        : store(signatureStore), pinnedVersion(0)
+    {
+    }
+
+    // Public function: The newest snapshot. The store must have been loaded.
+    const SignatureSnapshot<Index>& pin()
+    {
+        uint64_t latest = store.version();
+        if (latest != pinnedVersion || pinned == nullptr) {
+            pinned = store.acquire();
+            pinnedVersion = pinned->version;
+        }
+        return *pinned;
+    }
+};
+
+#endif
@@ -0,0 +1,226 @@
+// Reverse index: identifies a file's real type from its header bytes
+#ifndef SIGNATURE_TRIE_H
+#define SIGNATURE_TRIE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Signature.h"
+
+using namespace std;
+
+// Byte-prefix trie over every signature in the database, with one root per signature
+// offset. A single walk down the bytes at each offset visits each prefix once, so lookup
+// cost depends on the longest signature rather than on the number of rows in FileSignature.txt.
+class SignatureTrie {
+private:
+    // Structure for an outgoing edge, kept sorted by byte for binary search
+    struct Edge {
+        uint8_t byte;
+        uint32_t target;
+    };
+
+    // Structure for a node in the trie
+    struct Node {
+        vector<Edge> edges;          // Children, sorted by byte
+        vector<uint32_t> extensions; // Extensions whose signature ends at this node
+    };
+
+    // Structure for the root of the signatures at one file offset
+    struct Root {
+        uint32_t offset; // File offset the signatures sit at
+        uint32_t node;   // Root node
+        uint32_t depth;  // Length of the longest signature at this offset
+    };
+
+    // Structure for a terminal node met while matching
+    struct Hit {
+        uint32_t length;
+        uint32_t node;
+    };
+
+    vector<Node> nodes;        // nodes[0] is the root for offset 0
+    vector<Root> roots;        // Sorted by offset; roots[0] is offset 0
+    vector<string> extensions; // Extension names, indexed by id
+
+    // Utility function: Find the id for an extension, adding it if it is new
+    uint32_t extensionId(const string& extension)
+    {
+        for (uint32_t i = 0; i < extensions.size(); i++) {
+            if (extensions[i] == extension)
+                return i;
+        }
+        extensions.push_back(extension);
+        return static_cast<uint32_t>(extensions.size() - 1);
+    }
+
+    // Utility function: Find the child of a node for a byte, or 0 if there is none
+    uint32_t child(const Node& node, uint8_t byte) const
+    {
+        auto it = lower_bound(node.edges.begin(), node.edges.end(), byte,
+                              [](const Edge& edge, uint8_t b) { return edge.byte < b; });
+        if (it == node.edges.end() || it->byte != byte)
+            return 0;
+        return it->target;
+    }
+
+    // Utility function: Find the root for an offset, adding it if it is new
+    Root& rootFor(uint32_t offset)
+    {
+        auto it = lower_bound(roots.begin(), roots.end(), offset,
+                              [](const Root& root, uint32_t o) { return root.offset < o; });
+        if (it != roots.end() && it->offset == offset)
+            return *it;
+        uint32_t node = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+        return *roots.insert(it, Root{offset, node, 0});
+    }
+
+public:
+    // Constructor: Initialize an empty trie with just the offset 0 root
+    SignatureTrie()
+        : nodes(1), roots(1, Root{0, 0, 0})
+    {
+    }
+
+    // Public function: Register raw signature bytes found at a file offset for an extension
+    void insert(const unsigned char* signature, size_t length, uint32_t offset, const string& extension)
+    {
+        if (length == 0)
+            return;
+
+        Root& root = rootFor(offset);
+        root.depth = max(root.depth, static_cast<uint32_t>(length));
+        uint32_t current = root.node;
+        for (size_t i = 0; i < length; i++) {
+            uint8_t byte = signature[i];
+            uint32_t next = child(nodes[current], byte);
+            if (next == 0) {
+                next = static_cast<uint32_t>(nodes.size());
+                nodes.emplace_back();
+                vector<Edge>& edges = nodes[current].edges;
+                auto it = lower_bound(edges.begin(), edges.end(), byte,
+                                      [](const Edge& edge, uint8_t b) { return edge.byte < b; });
+                edges.insert(it, Edge{byte, next});
+            }
+            current = next;
+        }
+
+        uint32_t id = extensionId(extension);
+        vector<uint32_t>& ids = nodes[current].extensions;
+        if (find(ids.begin(), ids.end(), id) == ids.end())
+            ids.push_back(id);
+    }
+
+    // Public function: Register an offset 0 signature
+    void insert(const unsigned char* signature, size_t length, const string& extension)
+    {
+        insert(signature, length, 0, extension);
+    }
+
+    // Public function: Every extension whose signature is present in the header, longest match first
+    size_t match(const FileHeader& header, vector<string>& matches) const
+    {
+        Hit hits[64];
+        size_t hitCount = 0;
+        vector<Hit> overflow;
+
+        for (const Root& root : roots) {
+            size_t size = 0;
+            const unsigned char* data = header.at(root.offset, size);
+            uint32_t current = root.node;
+            for (size_t i = 0; i < size; i++) {
+                current = child(nodes[current], data[i]);
+                if (current == 0)
+                    break;
+                if (!nodes[current].extensions.empty()) {
+                    if (hitCount < 64)
+                        hits[hitCount++] = Hit{static_cast<uint32_t>(i + 1), current};
+                    else
+                        overflow.push_back(Hit{static_cast<uint32_t>(i + 1), current});
+                }
+            }
+        }
+
+        // Longest first; among equal lengths, lower offsets first
+        auto longer = [](const Hit& a, const Hit& b) { return a.length > b.length; };
+        Hit* first = hits;
+        Hit* last = hits + hitCount;
+        if (!overflow.empty()) {
+            overflow.insert(overflow.begin(), hits, hits + hitCount);
+            first = overflow.data();
+            last = overflow.data() + overflow.size();
+        }
+        stable_sort(first, last, longer);
+
+        matches.clear();
+        auto emit = [&](uint32_t node) {
+            for (uint32_t id : nodes[node].extensions) {
+                const string& extension = extensions[id];
+                if (find(matches.begin(), matches.end(), extension) == matches.end())
+                    matches.push_back(extension);
+            }
+        };
+        for (Hit* hit = first; hit != last; ++hit)
+            emit(hit->node);
+        return matches.size();
+    }
+
+    // Public function: Add the ranges needed for signatures at other offsets that the plan does not
+    // cover yet. Returns true if anything was added (and the file must be read again).
+    bool planOffsets(FileHeader& header) const
+    {
+        bool added = false;
+        for (const Root& root : roots) {
+            if (root.offset == 0 || root.depth == 0 || header.covers(root.offset, root.depth))
+                continue;
+            added = header.planRead(root.offset, root.depth) || added;
+        }
+        return added;
+    }
+
+    // Public function: Call visit(bytes, length, offset, extensions) once for every distinct
+    // signature, with every extension that shares it
+    template <typename Visit>
+    void forEachSignature(Visit visit) const
+    {
+        unsigned char path[MAX_SIGNATURE_BYTES];
+        vector<string> names;
+        struct Frame {
+            uint32_t node;
+            uint32_t depth;
+            uint8_t byte; // Edge taken to reach the node
+        };
+        for (const Root& root : roots) {
+            vector<Frame> stack(1, Frame{root.node, 0, 0});
+            while (!stack.empty()) {
+                Frame frame = stack.back();
+                stack.pop_back();
+                if (frame.depth > 0)
+                    path[frame.depth - 1] = frame.byte;
+                const Node& node = nodes[frame.node];
+                if (!node.extensions.empty()) {
+                    names.clear();
+                    for (uint32_t id : node.extensions)
+                        names.push_back(extensions[id]);
+                    visit(static_cast<const unsigned char*>(path), static_cast<size_t>(frame.depth), root.offset,
+                          static_cast<const vector<string>&>(names));
+                }
+                if (frame.depth == MAX_SIGNATURE_BYTES)
+                    continue;
+                // Pushed in reverse so siblings come off the stack in byte order
+                for (auto it = node.edges.rbegin(); it != node.edges.rend(); ++it)
+                    stack.push_back(Frame{it->target, frame.depth + 1, it->byte});
+            }
+        }
+    }
+
+    // Public function: Number of bytes from the start of a file needed to test every offset 0 signature
+    size_t maxSignatureLength() const { return roots[0].depth; }
+
+    // Public function: Number of nodes in the trie
+    size_t size() const { return nodes.size(); }
+};
+
+#endif
@@ -0,0 +1,95 @@
+// Synthetic signature databases and file corpora for benchmarks
+#ifndef SYNTHETIC_DATA_H
+#define SYNTHETIC_DATA_H
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "FileUtils.h"
+
+using namespace std;
+
+// One row of a generated database
+struct SyntheticRow {
+    string extension;
+    string hex; // Signature as written to the CSV
+};
+
+// Generate a database with the given number of distinct extensions. Extensions are short
+// lowercase names like real ones; signatures are 2 to maxBytes random bytes.
+inline vector<SyntheticRow> generateSignatureRows(size_t extensions, size_t signaturesPerExtension,
+                                                  size_t maxBytes, uint32_t seed) {
+    mt19937 rng(seed);
+    uniform_int_distribution<int> letter('a', 'z');
+    uniform_int_distribution<size_t> nameLength(2, 6);
+    uniform_int_distribution<size_t> signatureLength(2, max<size_t>(2, min(maxBytes, MAX_SIGNATURE_BYTES)));
+    uniform_int_distribution<int> byte(0, 255);
+
+    vector<SyntheticRow> rows;
+    for (size_t i = 0; i < extensions; i++) {
+        // A random stem plus the index keeps names unique at any size
+        string name;
+        for (size_t n = nameLength(rng); n > 0; n--)
+            name += static_cast<char>(letter(rng));
+        name += to_string(i);
+        if (name.size() > 15)
+            name = name.substr(name.size() - 15);
+
+        for (size_t s = 0; s < signaturesPerExtension; s++) {
+            unsigned char bytes[MAX_SIGNATURE_BYTES];
+            size_t length = signatureLength(rng);
+            for (size_t b = 0; b < length; b++)
+                bytes[b] = static_cast<unsigned char>(byte(rng));
+            rows.push_back({ name, encodeHex(bytes, length) });
+        }
+    }
+    return rows;
+}
+
+// Write rows in the FileSignature.txt format
+inline bool writeSignatureCsv(const vector<SyntheticRow>& rows, const string& path) {
+    ofstream out(path, ios::trunc);
+    for (const SyntheticRow& row : rows)
+        out << row.extension << "," << row.hex << "," << row.hex.size() << "\n";
+    return static_cast<bool>(out);
+}
+
+// Create files named after database extensions. A mismatchRate share of them get the
+// signature of some other row; every file is padded with random bytes up to fileSize.
+inline vector<string> generateCorpus(const vector<SyntheticRow>& rows, const string& directory, size_t files,
+                                     double mismatchRate, size_t fileSize, uint32_t seed) {
+    namespace fs = std::filesystem;
+    fs::create_directories(directory);
+    mt19937 rng(seed);
+    uniform_int_distribution<size_t> pick(0, rows.empty() ? 0 : rows.size() - 1);
+    uniform_real_distribution<double> chance(0.0, 1.0);
+    uniform_int_distribution<int> byte(0, 255);
+
+    vector<string> paths;
+    string payload;
+    for (size_t i = 0; i < files && !rows.empty(); i++) {
+        const SyntheticRow& claimed = rows[pick(rng)];
+        const SyntheticRow& actual = chance(rng) < mismatchRate ? rows[pick(rng)] : claimed;
+
+        string bytes;
+        decodeHex(actual.hex, bytes);
+        payload.assign(max(fileSize, bytes.size()), '\0');
+        memcpy(&payload[0], bytes.data(), bytes.size());
+        for (size_t b = bytes.size(); b < payload.size(); b++)
+            payload[b] = static_cast<char>(byte(rng));
+
+        // Spread files over subdirectories so no single directory gets huge
+        string path = directory + "/" + to_string(i % 64) + "/f" + to_string(i) + "." + claimed.extension;
+        fs::create_directories(directory + "/" + to_string(i % 64));
+        ofstream out(path, ios::binary | ios::trunc);
+        out.write(payload.data(), payload.size());
+        paths.push_back(path);
+    }
+    return paths;
+}
+
+#endif
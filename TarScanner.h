@@ -0,0 +1,417 @@
+// Tar mode: check the members of a tar stream in place, without extracting anything
+#ifndef TAR_SCANNER_H
+#define TAR_SCANNER_H
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "AsyncLogger.h"
+#include "BatchScanner.h"
+#include "FileUtils.h"
+
+using namespace std;
+
+const size_t TAR_BLOCK = 512;
+const size_t TAR_BUFFER = 256 * 1024;     // Read buffer; also the unit of bulk skips on a pipe
+const size_t TAR_MAX_METADATA = 64 * 1024; // Longest GNU long name or pax header honoured
+
+// Sequential reader over a tar stream with one fixed buffer. Skips seek when the input is a
+// regular file and read through the buffer otherwise, so memory use never depends on the
+// archive or its members.
+class TarReader {
+private:
+    int fd;
+    bool seekable;
+    vector<unsigned char> buffer;
+    size_t begin = 0;       // Unconsumed bytes are buffer[begin, end)
+    size_t end = 0;
+    uint64_t position = 0;  // Stream offset of buffer[begin]
+    uint64_t size = 0;      // Length of a seekable input
+
+    // Utility function: Refill the empty buffer. Returns false at end of input or on an error.
+    bool fill()
+    {
+        begin = end = 0;
+        for (;;) {
+            ssize_t n = ::read(fd, buffer.data(), buffer.size());
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0)
+                error = errno;
+            if (n <= 0)
+                return false;
+            end = static_cast<size_t>(n);
+            return true;
+        }
+    }
+
+public:
+    int error = 0; // errno of the last failed read or seek, 0 for a clean end of input
+
+    explicit TarReader(int descriptor)
+        : fd(descriptor), seekable(false), buffer(TAR_BUFFER)
+    {
+        struct stat info;
+        seekable = fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && lseek(fd, 0, SEEK_CUR) >= 0;
+        if (seekable)
+            size = static_cast<uint64_t>(info.st_size);
+#ifdef POSIX_FADV_SEQUENTIAL
+        if (seekable)
+            posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    }
+
+    // Public function: Read exactly length bytes. Returns false on a short read.
+    bool read(unsigned char* out, size_t length)
+    {
+        while (length > 0) {
+            if (begin == end && !fill())
+                return false;
+            size_t n = min(length, end - begin);
+            memcpy(out, buffer.data() + begin, n);
+            begin += n;
+            position += n;
+            out += n;
+            length -= n;
+        }
+        return true;
+    }
+
+    // Public function: Drop length bytes. Returns false if the input ended first.
+    bool skip(uint64_t length)
+    {
+        size_t buffered = static_cast<size_t>(min<uint64_t>(length, end - begin));
+        begin += buffered;
+        position += buffered;
+        length -= buffered;
+        if (length == 0)
+            return true;
+        if (seekable) {
+            if (position + length > size)
+                return false;
+            if (lseek(fd, static_cast<off_t>(length), SEEK_CUR) < 0) {
+                error = errno;
+                return false;
+            }
+            position += length;
+            return true;
+        }
+        while (length > 0) {
+            if (!fill())
+                return false;
+            size_t n = static_cast<size_t>(min<uint64_t>(length, end));
+            begin = n;
+            position += n;
+            length -= n;
+        }
+        return true;
+    }
+
+    // Public function: Stream offset of the next byte
+    uint64_t offset() const { return position; }
+};
+
+// Value of a numeric header field: octal digits, or base-256 when the top bit is set
+// (GNU and star use that for sizes of 8 GiB and up). Returns false if malformed.
+inline bool parseTarNumber(const unsigned char* field, size_t length, uint64_t& value) {
+    value = 0;
+    if (field[0] & 0x80) {
+        if (field[0] == 0xFF) // Negative
+            return false;
+        value = field[0] & 0x7F;
+        for (size_t i = 1; i < length; i++) {
+            if (value >> 56)
+                return false;
+            value = (value << 8) | field[i];
+        }
+        return true;
+    }
+    size_t i = 0;
+    while (i < length && field[i] == ' ')
+        i++;
+    bool digits = false;
+    for (; i < length && field[i] >= '0' && field[i] <= '7'; i++) {
+        value = (value << 3) | static_cast<uint64_t>(field[i] - '0');
+        digits = true;
+    }
+    for (; i < length; i++) {
+        if (field[i] != ' ' && field[i] != '\0')
+            return false;
+    }
+    return digits;
+}
+
+// Does the header checksum hold? Old tars summed signed chars, so either sum is accepted.
+inline bool tarChecksumValid(const unsigned char* block) {
+    uint64_t stored = 0;
+    if (!parseTarNumber(block + 148, 8, stored))
+        return false;
+    uint64_t unsignedSum = 0;
+    int64_t signedSum = 0;
+    for (size_t i = 0; i < TAR_BLOCK; i++) {
+        unsigned char byte = (i >= 148 && i < 156) ? ' ' : block[i];
+        unsignedSum += byte;
+        signedSum += static_cast<signed char>(byte);
+    }
+    return stored == unsignedSum || static_cast<int64_t>(stored) == signedSum;
+}
+
+// A header field that may fill its whole width without a terminating NUL
+inline string tarField(const unsigned char* field, size_t length) {
+    const void* nul = memchr(field, 0, length);
+    size_t size = nul == nullptr ? length : static_cast<size_t>(static_cast<const unsigned char*>(nul) - field);
+    return string(reinterpret_cast<const char*>(field), size);
+}
+
+// Pull path and size out of pax extended header records ("<length> <key>=<value>\n")
+inline void parsePaxRecords(const string& records, string& path, uint64_t& size, bool& sizeSet) {
+    size_t position = 0;
+    while (position < records.size()) {
+        size_t space = records.find(' ', position);
+        if (space == string::npos)
+            return;
+        size_t length = 0;
+        for (size_t i = position; i < space; i++) {
+            if (records[i] < '0' || records[i] > '9')
+                return;
+            length = length * 10 + static_cast<size_t>(records[i] - '0');
+        }
+        if (length <= space - position || position + length > records.size())
+            return;
+        size_t equals = records.find('=', space + 1);
+        size_t recordEnd = position + length - 1; // The trailing newline
+        if (equals != string::npos && equals < recordEnd) {
+            string key = records.substr(space + 1, equals - space - 1);
+            string value = records.substr(equals + 1, recordEnd - equals - 1);
+            if (key == "path") {
+                path = value;
+            } else if (key == "size") {
+                uint64_t parsed = 0;
+                bool digits = !value.empty();
+                for (char c : value) {
+                    if (c < '0' || c > '9') {
+                        digits = false;
+                        break;
+                    }
+                    parsed = parsed * 10 + static_cast<uint64_t>(c - '0');
+                }
+                if (digits) {
+                    size = parsed;
+                    sizeSet = true;
+                }
+            }
+        }
+        position += length;
+    }
+}
+
+// Checks every regular member of a tar stream (ustar, GNU and pax) with the same lookup and
+// comparison as a file on disk, using the member's name and the bytes at the start of its
+// data. Headers are read in turn; of each member body only the planned ranges are read and
+// the rest is skipped. Mismatches are identified with the reverse index, but as a stream
+// cannot be read twice, its offset signatures are planned before the first read rather than
+// after a mismatch, and ZIP-based members are not looked into.
+template <typename Index>
+class TarScanner {
+private:
+    const Index& index;
+    const SignatureTrie* reverse;
+    static const size_t flushEvery = 64;
+
+    // Utility function: Read the planned ranges of a member of size bytes, skipping the gaps.
+    // consumed receives how far into the member the reader now is.
+    bool readMember(TarReader& reader, FileHeader& header, uint64_t size, uint64_t& consumed)
+    {
+        consumed = 0;
+        header.clearReads();
+        for (size_t i = 0; i < header.segmentCount; i++) {
+            const ReadSegment& segment = header.segments[i];
+            if (segment.offset >= size)
+                break;
+            if (!reader.skip(segment.offset - consumed))
+                return false;
+            size_t length = static_cast<size_t>(min<uint64_t>(segment.length, size - segment.offset));
+            if (!reader.read(header.bytes + segment.start, length))
+                return false;
+            header.setRead(i, length);
+            consumed = segment.offset + length;
+        }
+        return true;
+    }
+
+    // Utility function: Read a GNU long name or pax header body into text, or skip it if it is
+    // too large to honour. Returns false if the stream ends.
+    bool readMetadata(TarReader& reader, uint64_t size, string& text)
+    {
+        uint64_t padded = (size + TAR_BLOCK - 1) / TAR_BLOCK * TAR_BLOCK;
+        text.clear();
+        if (size > TAR_MAX_METADATA) {
+            cerr << "Skipping oversized tar metadata (" << size << " bytes) at offset " << reader.offset() << endl;
+            return reader.skip(padded);
+        }
+        text.resize(static_cast<size_t>(size));
+        if (!reader.read(reinterpret_cast<unsigned char*>(&text[0]), text.size()))
+            return false;
+        return reader.skip(padded - size);
+    }
+
+public:
+    TarScanner(const Index& signatureIndex, const SignatureTrie* reverseIndex)
+        : index(signatureIndex), reverse(reverseIndex)
+    {
+    }
+
+    // Public function: Check every member of the archive on fd, printing one result line per
+    // member to out (paths are prefix + member name) and logging each. Returns false with
+    // error set if the stream is not a readable tar archive; members before that are reported.
+    bool run(int fd, const string& prefix, ostream& out, AsyncLogger& logger, BatchStats& stats, string& error)
+    {
+        auto started = chrono::steady_clock::now();
+        TarReader reader(fd);
+        unsigned char block[TAR_BLOCK];
+        CheckResult result;
+        string console;
+        size_t pending = 0;
+        string longName;           // GNU 'L' name for the next member
+        string paxPath;            // pax 'x' path for the next member
+        uint64_t paxSize = 0;
+        bool paxSizeSet = false;
+        string metadata;
+        bool ok = true;
+
+        for (;;) {
+            uint64_t headerOffset = reader.offset();
+            if (!reader.read(block, TAR_BLOCK)) {
+                // Archives are meant to end with zero blocks, but plenty of writers stop short
+                if (reader.error != 0) {
+                    error = string("Error reading tar stream: ") + strerror(reader.error);
+                    ok = false;
+                } else if (reader.offset() != headerOffset) {
+                    error = "Tar stream ends inside a header at offset " + to_string(headerOffset);
+                    ok = false;
+                }
+                break;
+            }
+            bool zero = true;
+            for (size_t i = 0; i < TAR_BLOCK && zero; i++)
+                zero = block[i] == 0;
+            if (zero)
+                break;
+            uint64_t size = 0;
+            if (!tarChecksumValid(block) || !parseTarNumber(block + 124, 12, size)) {
+                error = "Not a tar header at offset " + to_string(headerOffset);
+                ok = false;
+                break;
+            }
+
+            char type = static_cast<char>(block[156]);
+            if (type == 'L' || type == 'x') {
+                if (!readMetadata(reader, size, metadata)) {
+                    error = "Tar stream ends inside a header at offset " + to_string(headerOffset);
+                    ok = false;
+                    break;
+                }
+                if (type == 'L') {
+                    longName = tarField(reinterpret_cast<const unsigned char*>(metadata.data()), metadata.size());
+                } else {
+                    parsePaxRecords(metadata, paxPath, paxSize, paxSizeSet);
+                }
+                continue;
+            }
+
+            // Settle the member's name and size, then forget the metadata that described it
+            string name;
+            if (!paxPath.empty()) {
+                name = paxPath;
+            } else if (!longName.empty()) {
+                name = longName;
+            } else {
+                string prefixField = memcmp(block + 257, "ustar", 5) == 0 ? tarField(block + 345, 155) : string();
+                name = tarField(block, 100);
+                if (!prefixField.empty())
+                    name = prefixField + "/" + name;
+            }
+            if (paxSizeSet)
+                size = paxSize;
+            longName.clear();
+            paxPath.clear();
+            paxSizeSet = false;
+
+            // Links, directories and devices ('1' to '6') carry no data whatever size says. The
+            // rest (GNU sparse files, long link names, global pax headers, ...) are skipped;
+            // a sparse member stores only its non-hole parts, so its first bytes are not the file's.
+            bool regular = type == '0' || type == '\0' || type == '7';
+            bool hasData = type < '1' || type > '6';
+            uint64_t padded = (size + TAR_BLOCK - 1) / TAR_BLOCK * TAR_BLOCK;
+            if (!regular) {
+                if (hasData && !reader.skip(padded)) {
+                    error = "Tar stream ends inside a member at offset " + to_string(headerOffset);
+                    ok = false;
+                    break;
+                }
+                continue;
+            }
+
+            uint64_t start = monotonicNanos();
+            // The extension comes from the member name alone; the archive prefix is only for display
+            size_t planned = prepareCheck(index, name, reverse, result);
+            result.path = prefix + name;
+            if (planned > 0 && reverse != nullptr)
+                reverse->planOffsets(result.header);
+            uint64_t looked = monotonicNanos();
+            uint64_t consumed = 0;
+            bool readOk = planned == 0 || readMember(reader, result.header, size, consumed);
+            uint64_t read = monotonicNanos();
+            if (!readOk) {
+                result.error = reader.error != 0 ? reader.error : EIO;
+                result.verdict = READ_ERROR;
+            } else if (planned > 0) {
+                compareHeader(result);
+                if (result.verdict == MISMATCH && reverse != nullptr)
+                    reverse->match(result.header, result.detectedTypes);
+            }
+            result.timings.lookupNs = static_cast<uint32_t>(looked - start);
+            result.timings.readNs = static_cast<uint32_t>(read - looked);
+            result.timings.matchNs = static_cast<uint32_t>(monotonicNanos() - read);
+
+            recordCheck(result);
+            stats.files++;
+            switch (result.verdict) {
+                case MATCH: stats.matches++; break;
+                case MISMATCH: stats.mismatches++; break;
+                case UNKNOWN_EXTENSION: stats.unknown++; break;
+                case READ_ERROR: stats.errors++; break;
+            }
+            appendResultLine(console, result);
+            {
+                StageTimer logTimer(STAGE_LOG);
+                logger.log(result);
+            }
+            if (++pending >= flushEvery) {
+                out << console;
+                out.flush();
+                console.clear();
+                pending = 0;
+            }
+
+            if (!readOk || !reader.skip(padded - consumed)) {
+                error = "Tar stream ends inside a member at offset " + to_string(headerOffset);
+                ok = false;
+                break;
+            }
+        }
+
+        out << console;
+        out.flush();
+        stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+        return ok;
+    }
+};
+
+#endif
@@ -0,0 +1,305 @@
+// Tells the ZIP-based formats apart (zip, jar, apk, docx, xlsx, pptx) from the member names
+#ifndef ZIP_INSPECTOR_H
+#define ZIP_INSPECTOR_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "SafeOpen.h"
+
+using namespace std;
+
+// What a ZIP file turned out to hold. CONTAINER_ZIP means it is a valid archive with nothing
+// that marks it as one of the more specific formats.
+enum ContainerType : uint8_t {
+    CONTAINER_NONE, // Not inspected, or no central directory could be found
+    CONTAINER_ZIP,
+    CONTAINER_JAR,
+    CONTAINER_APK,
+    CONTAINER_DOCX,
+    CONTAINER_XLSX,
+    CONTAINER_PPTX
+};
+
+inline const char* containerName(ContainerType type) {
+    switch (type) {
+        case CONTAINER_ZIP: return "zip";
+        case CONTAINER_JAR: return "jar";
+        case CONTAINER_APK: return "apk";
+        case CONTAINER_DOCX: return "docx";
+        case CONTAINER_XLSX: return "xlsx";
+        case CONTAINER_PPTX: return "pptx";
+        case CONTAINER_NONE: break;
+    }
+    return "";
+}
+
+// Is this one of the extensions whose files are ZIP archives?
+inline bool isZipExtension(const string& extension) {
+    static const char* const names[] = { "zip", "jar", "apk", "docx", "xlsx", "pptx" };
+    for (const char* name : names) {
+        if (extension == name)
+            return true;
+    }
+    return false;
+}
+
+const size_t ZIP_END_RECORD = 22;             // End of central directory record without its comment
+const size_t ZIP_MAX_COMMENT = 65535;
+const size_t ZIP_TAIL_READ = 4096;            // First look for the end record in this much of the tail
+const size_t ZIP_MAX_DIRECTORY = 1 << 20;     // Most of the central directory ever read
+const uint32_t ZIP_END_SIGNATURE = 0x06054b50;
+const uint32_t ZIP64_LOCATOR_SIGNATURE = 0x07064b50;
+const uint32_t ZIP64_END_SIGNATURE = 0x06064b50;
+const uint32_t ZIP_ENTRY_SIGNATURE = 0x02014b50;
+
+// Little-endian field readers
+inline uint16_t zipRead16(const unsigned char* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+inline uint32_t zipRead32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16)
+           | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+inline uint64_t zipRead64(const unsigned char* p) {
+    return static_cast<uint64_t>(zipRead32(p)) | (static_cast<uint64_t>(zipRead32(p + 4)) << 32);
+}
+
+// Read exactly length bytes at offset. Returns false on an error or a short read.
+inline bool zipReadAt(int fd, unsigned char* buffer, size_t length, uint64_t offset) {
+    size_t done = 0;
+    while (done < length) {
+        ssize_t n = pread(fd, buffer + done, length - done, static_cast<off_t>(offset + done));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Decide the format from the central directory's member names
+inline ContainerType classifyZipDirectory(const unsigned char* directory, size_t size) {
+    bool contentTypes = false, word = false, excel = false, powerPoint = false;
+    bool androidManifest = false, dalvik = false, javaManifest = false;
+
+    size_t position = 0;
+    while (position + 46 <= size && zipRead32(directory + position) == ZIP_ENTRY_SIGNATURE) {
+        size_t nameLength = zipRead16(directory + position + 28);
+        size_t extraLength = zipRead16(directory + position + 30);
+        size_t commentLength = zipRead16(directory + position + 32);
+        if (position + 46 + nameLength > size)
+            break;
+        const char* name = reinterpret_cast<const char*>(directory + position + 46);
+        auto is = [&](const char* text) { return nameLength == strlen(text) && memcmp(name, text, nameLength) == 0; };
+        auto startsWith = [&](const char* text) {
+            size_t length = strlen(text);
+            return nameLength >= length && memcmp(name, text, length) == 0;
+        };
+
+        if (is("[Content_Types].xml"))
+            contentTypes = true;
+        else if (startsWith("word/"))
+            word = true;
+        else if (startsWith("xl/"))
+            excel = true;
+        else if (startsWith("ppt/"))
+            powerPoint = true;
+        else if (is("AndroidManifest.xml"))
+            androidManifest = true;
+        else if (is("resources.arsc") || (startsWith("classes") && nameLength > 4 && memcmp(name + nameLength - 4, ".dex", 4) == 0))
+            dalvik = true;
+        else if (is("META-INF/MANIFEST.MF"))
+            javaManifest = true;
+
+        position += 46 + nameLength + extraLength + commentLength;
+    }
+
+    if (androidManifest && dalvik)
+        return CONTAINER_APK;
+    if (contentTypes && word)
+        return CONTAINER_DOCX;
+    if (contentTypes && excel)
+        return CONTAINER_XLSX;
+    if (contentTypes && powerPoint)
+        return CONTAINER_PPTX;
+    if (javaManifest)
+        return CONTAINER_JAR;
+    return CONTAINER_ZIP;
+}
+
+// Finding the central directory of a ZIP file and classifying it by member names, one read at
+// a time, so whoever owns the I/O can issue the reads (the batch workers put them through their
+// HeaderReader, under its deadline). Reads the tail of the file (a second, larger tail read only
+// if the archive has a long comment), the ZIP64 end record if there is one, and the directory
+// itself; member data is never read. While next() names a range, read it and hand it to supply().
+class ZipInspection {
+private:
+    enum Step { ZIP_TAIL, ZIP_LONG_TAIL, ZIP64_END, ZIP_DIRECTORY, ZIP_DONE };
+
+    Step step = ZIP_DONE;
+    ContainerType type = CONTAINER_NONE;
+    vector<unsigned char> tail;
+    uint64_t tailStart = 0;
+    size_t endRecord = 0;
+    uint64_t directoryOffset = 0;
+    uint64_t directorySize = 0;
+    uint64_t wantOffset = 0; // Next range to read
+    size_t wantLength = 0;
+
+    void finish(ContainerType found)
+    {
+        type = found;
+        step = ZIP_DONE;
+    }
+
+    // Utility function: Look for the end record in the tail just read. False if it is not there.
+    bool findEndRecord()
+    {
+        size_t length = tail.size();
+        for (size_t i = length - ZIP_END_RECORD + 1; i-- > 0;) {
+            if (zipRead32(tail.data() + i) == ZIP_END_SIGNATURE
+                && i + ZIP_END_RECORD + zipRead16(tail.data() + i + 20) <= length) {
+                endRecord = i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Utility function: With the end record found, read the ZIP64 end record or the directory
+    void afterEndRecord()
+    {
+        const unsigned char* end = tail.data() + endRecord;
+        directorySize = zipRead32(end + 12);
+        directoryOffset = zipRead32(end + 16);
+        if ((directorySize == 0xFFFFFFFF || directoryOffset == 0xFFFFFFFF) && endRecord >= 20
+            && zipRead32(end - 20) == ZIP64_LOCATOR_SIGNATURE) {
+            step = ZIP64_END;
+            wantOffset = zipRead64(end - 20 + 8);
+            wantLength = 56;
+            return;
+        }
+        locateDirectory();
+    }
+
+    // Utility function: Classify the directory if the tail holds it, otherwise ask for it
+    void locateDirectory()
+    {
+        uint64_t endOffset = tailStart + endRecord;
+        if (directoryOffset > endOffset || directorySize > endOffset - directoryOffset) {
+            finish(CONTAINER_NONE);
+            return;
+        }
+        // Small archives: the directory is already in the tail buffer
+        size_t length = static_cast<size_t>(min<uint64_t>(directorySize, ZIP_MAX_DIRECTORY));
+        if (directoryOffset >= tailStart) {
+            finish(classifyZipDirectory(tail.data() + (directoryOffset - tailStart), length));
+            return;
+        }
+        step = ZIP_DIRECTORY;
+        wantOffset = directoryOffset;
+        wantLength = length;
+    }
+
+public:
+    // Public function: Start over for a file of fileSize bytes
+    void start(uint64_t fileSize)
+    {
+        tail.clear();
+        if (fileSize < ZIP_END_RECORD) {
+            finish(CONTAINER_NONE);
+            return;
+        }
+        step = ZIP_TAIL;
+        wantLength = static_cast<size_t>(min<uint64_t>(ZIP_TAIL_READ, fileSize));
+        wantOffset = fileSize - wantLength;
+    }
+
+    // Public function: The range to read next into offset and length; false once the answer is known
+    bool next(uint64_t& offset, size_t& length) const
+    {
+        offset = wantOffset;
+        length = wantLength;
+        return step != ZIP_DONE;
+    }
+
+    // Public function: Take the range next() asked for; bytes is null if reading it failed
+    void supply(const unsigned char* bytes, size_t length)
+    {
+        bool ok = bytes != nullptr && length == wantLength;
+        switch (step) {
+            case ZIP_TAIL:
+            case ZIP_LONG_TAIL: {
+                if (!ok) {
+                    finish(CONTAINER_NONE);
+                    break;
+                }
+                uint64_t fileSize = wantOffset + wantLength;
+                tail.assign(bytes, bytes + length);
+                tailStart = wantOffset;
+                if (findEndRecord()) {
+                    afterEndRecord();
+                    break;
+                }
+                // Perhaps a long comment follows the end record
+                size_t longer = static_cast<size_t>(min<uint64_t>(ZIP_END_RECORD + ZIP_MAX_COMMENT, fileSize));
+                if (step == ZIP_LONG_TAIL || longer <= length) {
+                    finish(CONTAINER_NONE);
+                    break;
+                }
+                step = ZIP_LONG_TAIL;
+                wantOffset = fileSize - longer;
+                wantLength = longer;
+                break;
+            }
+            case ZIP64_END:
+                if (ok && zipRead32(bytes) == ZIP64_END_SIGNATURE) {
+                    directorySize = zipRead64(bytes + 40);
+                    directoryOffset = zipRead64(bytes + 48);
+                }
+                locateDirectory();
+                break;
+            case ZIP_DIRECTORY:
+                finish(ok ? classifyZipDirectory(bytes, length) : CONTAINER_NONE);
+                break;
+            case ZIP_DONE:
+                break;
+        }
+    }
+
+    // Public function: What the file turned out to be, once next() returns false
+    ContainerType container() const { return type; }
+};
+
+// Inspect a ZIP file with blocking reads. Returns CONTAINER_NONE if the file has no readable
+// central directory.
+inline ContainerType inspectZip(const char* path) {
+    int error = 0;
+    uint64_t fileSize = 0;
+    int fd = openRegularFile(path, error, fileSize);
+    if (fd < 0)
+        return CONTAINER_NONE;
+    ZipInspection inspection;
+    inspection.start(fileSize);
+    vector<unsigned char> buffer;
+    uint64_t offset;
+    size_t length;
+    while (inspection.next(offset, length)) {
+        buffer.resize(length);
+        bool ok = zipReadAt(fd, buffer.data(), length, offset);
+        inspection.supply(ok ? buffer.data() : nullptr, length);
+    }
+    ::close(fd);
+    return inspection.container();
+}
+
+#endif